@@ -1,7 +1,11 @@
-QT += quick multimedia
+QT += quick multimedia concurrent network
 
 CONFIG += c++17 qmltypes
 
+# QML is compiled ahead of time by qmlcachegen into the binary, the
+# resources are not parsed and compiled when the application starts
+CONFIG += qtquickcompiler
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
@@ -16,13 +20,33 @@ macx: {
    QMAKE_INFO_PLIST = $$PWD/mac/osx/Info.plist
  }
 
+include(alsa.pri)
+
 INCLUDEPATH += Porcupine/Components $$PWD/src $$PWD/extern/porcupine/include
 qml.path = $$PWD/ui/
 
 SOURCES += \
         main.cpp \
+        src/alsaaudiosource.cpp \
+        src/audiopipeline.cpp \
+        src/audiostages.cpp \
+        src/detectionbus.cpp \
+        src/detectionjournal.cpp \
+        src/jitterbuffer.cpp \
+        src/keywordindex.cpp \
+        src/keywordsmodel.cpp \
         src/porcupine.cpp \
-        src/qmlporcupine.cpp
+        src/porcupineadmission.cpp \
+        src/porcupinefanout.cpp \
+        src/porcupinelog.cpp \
+        src/porcupinememory.cpp \
+        src/porcupineperf.cpp \
+        src/porcupinemetrics.cpp \
+        src/porcupinestartup.cpp \
+        src/porcupinestats.cpp \
+        src/porcupinetrace.cpp \
+        src/qmlporcupine.cpp \
+        src/udpaudiosource.cpp
 
 RESOURCES += qml.qrc
 
@@ -35,9 +59,30 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 INCLUDEPATH += $$PWD/porcupine/include
 
 HEADERS += \
+    src/alsaaudiosource.h \
+    src/audiopipeline.h \
+    src/audiostages.h \
+    src/detectionbus.h \
+    src/detectionjournal.h \
+    src/detectionsink.h \
+    src/jitterbuffer.h \
+    src/keywordindex.h \
+    src/keywordsmodel.h \
+    src/mpscring.h \
     src/porcupine.h \
+    src/porcupineadmission.h \
+    src/porcupineawaitable.h \
     src/porcupine_fn.hpp \
-    src/qmlporcupine.h
+    src/porcupinefanout.h \
+    src/porcupinelog.h \
+    src/porcupinememory.h \
+    src/porcupineperf.h \
+    src/porcupinemetrics.h \
+    src/porcupinestartup.h \
+    src/porcupinestats.h \
+    src/porcupinetrace.h \
+    src/qmlporcupine.h \
+    src/udpaudiosource.h
 
 #############################################
 # Library root locations
@@ -101,5 +146,6 @@ mac {
 
 
 DISTFILES += \
+    alsa.pri \
     data/picovoice/build-mac-lib-universal.sh \
     mac/osx/Info.plist \
@@ -0,0 +1,10 @@
+# Direct ALSA capture (AlsaAudioSource) on Linux when the alsa-lib development
+# files are installed, otherwise AlsaAudioSource::start() reports it missing.
+
+linux:!android {
+    packagesExist(alsa) {
+        CONFIG += link_pkgconfig
+        PKGCONFIG += alsa
+        DEFINES += PV_HAVE_ALSA
+    }
+}
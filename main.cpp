@@ -1,9 +1,15 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 
+#include "porcupinestartup.h"
+#include "porcupinetrace.h"
+
 
 int main(int argc, char *argv[])
 {
+    PorcupineStartup::markMain();
+    PorcupineStartup::setAutoReport(qEnvironmentVariableIsSet("PV_STARTUP_REPORT"));
+    const qint64 appStartNs = PorcupineTrace::now();
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 #endif
@@ -12,6 +18,8 @@ int main(int argc, char *argv[])
     QCoreApplication::setOrganizationDomain("www.dynasphere.de");
     QCoreApplication::setApplicationName("PorcupineCheck");
     QCoreApplication::setApplicationVersion("1.0");
+    const qint64 qmlStartNs = PorcupineTrace::now();
+    PorcupineStartup::record(PorcupineStartup::ApplicationInit, appStartNs, qmlStartNs - appStartNs);
 
     QQmlApplicationEngine engine;
     const QUrl url(QStringLiteral("qrc:/ui/main.qml"));
@@ -21,6 +29,7 @@ int main(int argc, char *argv[])
                 QCoreApplication::exit(-1);
         }, Qt::QueuedConnection);
     engine.load(url);
+    PorcupineStartup::record(PorcupineStartup::QmlLoad, qmlStartNs, PorcupineTrace::now() - qmlStartNs);
 
     return app.exec();
 }
@@ -0,0 +1,459 @@
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QThread>
+#include <cstring>
+
+#ifdef PV_HAVE_ALSA
+#include <alsa/asoundlib.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "porcupinelog.h"
+#include "alsaaudiosource.h"
+
+namespace
+{
+
+// Whole frames buffered for the reading thread, 2 s at 512 samples and 16 kHz
+const int RingFrames = 64;
+
+// Default SCHED_FIFO priority of the capture thread, below the audio server's
+const int DefaultRealtimePriority = 60;
+
+// Wait for a period, the capture thread checks for stop at this interval
+const int WaitTimeoutMs = 100;
+
+}
+
+///
+/// \brief Constructs a closed source.
+/// \param sampleRate Sample rate of the engine.
+/// \param frameLength Samples per engine frame, also the ALSA period size.
+///
+AlsaAudioSource::AlsaAudioSource(qint32 sampleRate, int frameLength, QObject* parent)
+    : QIODevice(parent)
+    , m_sampleRate(sampleRate)
+    , m_frameLength(frameLength)
+    , m_ringFrames(RingFrames)
+    , m_pcm(nullptr)
+    , m_thread(nullptr)
+    , m_realtimePriority(DefaultRealtimePriority)
+    , m_ring(RingFrames * frameLength, 0)
+    , m_scratch(frameLength, 0)
+    , m_slotFill(0)
+    , m_slotDropped(false)
+    , m_readOffset(0)
+    , m_written(0)
+    , m_read(0)
+    , m_stop(false)
+    , m_failed(false)
+    , m_notifyPending(false)
+    , m_frames(0)
+    , m_overruns(0)
+    , m_dropped(0)
+    , m_maxWakeUpNs(0)
+    , m_realtime(false)
+    , m_periodFrames(0)
+    , m_bufferFrames(0)
+{
+}
+
+AlsaAudioSource::~AlsaAudioSource()
+{
+    close();
+}
+
+///
+/// \brief Checks whether the ALSA backend was built in.
+///
+bool AlsaAudioSource::isAvailable()
+{
+#ifdef PV_HAVE_ALSA
+    return true;
+#else
+    return false;
+#endif
+}
+
+///
+/// \brief Opens the PCM, starts the capture thread and opens the device for reading.
+/// \param deviceName ALSA PCM name, e.g. "default", "hw:1,0" or "null".
+/// \param periods Periods of one frame each in the ALSA ring buffer.
+/// \param errMsg Optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool AlsaAudioSource::start(const QString& deviceName, int periods, QString* errMsg)
+{
+    close();
+
+#ifdef PV_HAVE_ALSA
+    snd_pcm_t* pcm = nullptr;
+    int err = snd_pcm_open(&pcm, deviceName.toUtf8().constData(), SND_PCM_STREAM_CAPTURE, 0);
+
+    const auto fail = [&](const char* step)
+    {
+        if (errMsg != nullptr)
+            *errMsg = QString("ALSA device \"%1\": %2 failed: %3").arg(deviceName, step, snd_strerror(err));
+
+        if (pcm != nullptr)
+            snd_pcm_close(pcm);
+
+        return false;
+    };
+
+    if (err < 0)
+        return fail("open");
+
+    snd_pcm_hw_params_t* hw = nullptr;
+    snd_pcm_hw_params_alloca(&hw);
+    unsigned int rate = unsigned(m_sampleRate);
+    snd_pcm_uframes_t period = snd_pcm_uframes_t(m_frameLength);
+    snd_pcm_uframes_t buffer = snd_pcm_uframes_t(qMax(2, periods) * m_frameLength);
+    int dir = 0;
+
+    if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0)
+        return fail("hw_params_any");
+
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0)
+        return fail("mmap access");
+
+    if ((err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16)) < 0)
+        return fail("16 bit format");
+
+    if ((err = snd_pcm_hw_params_set_channels(pcm, hw, 1)) < 0)
+        return fail("mono");
+
+    if ((err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, &dir)) < 0)
+        return fail("sample rate");
+
+    if (rate != unsigned(m_sampleRate))
+    {
+        err = -EINVAL;
+        return fail(QString("sample rate %1 Hz").arg(m_sampleRate).toUtf8().constData());
+    }
+
+    if ((err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, &dir)) < 0)
+        return fail("period size");
+
+    if ((err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer)) < 0)
+        return fail("buffer size");
+
+    if ((err = snd_pcm_hw_params(pcm, hw)) < 0)
+        return fail("hw_params");
+
+    snd_pcm_sw_params_t* sw = nullptr;
+    snd_pcm_sw_params_alloca(&sw);
+
+    if ((err = snd_pcm_sw_params_current(pcm, sw)) < 0
+        || (err = snd_pcm_sw_params_set_avail_min(pcm, sw, snd_pcm_uframes_t(m_frameLength))) < 0
+        || (err = snd_pcm_sw_params(pcm, sw)) < 0)
+        return fail("sw_params");
+
+    if ((err = snd_pcm_prepare(pcm)) < 0)
+        return fail("prepare");
+
+    // The hardware may round the period, the ring keeps whole engine frames anyway
+    if (period != snd_pcm_uframes_t(m_frameLength))
+    {
+        PorcupineLog::instance().post(PorcupineLog::Warning,
+                                      QString("ALSA device \"%1\" uses a period of %2 instead of %3 samples")
+                                      .arg(deviceName).arg(period).arg(m_frameLength));
+    }
+
+    m_pcm = pcm;
+    m_periodFrames = int(period);
+    m_bufferFrames = int(buffer);
+    m_slotFill = 0;
+    m_slotDropped = false;
+    m_readOffset = 0;
+    m_written.store(0);
+    m_read.store(0);
+    m_stop.store(false);
+    m_failed.store(false);
+    m_notifyPending.store(false);
+    m_frames.store(0);
+    m_overruns.store(0);
+    m_dropped.store(0);
+    m_maxWakeUpNs.store(0);
+    m_realtime.store(false);
+    m_captureError.clear();
+
+    m_thread = QThread::create([this]() { capture(); });
+    m_thread->setObjectName("AlsaCapture");
+    m_thread->start();
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+#else
+    Q_UNUSED(periods)
+
+    if (errMsg != nullptr)
+        *errMsg = QString("ALSA device \"%1\": ALSA support is not built in").arg(deviceName);
+
+    return false;
+#endif
+}
+
+void AlsaAudioSource::close()
+{
+    if (m_thread != nullptr)
+    {
+        m_stop.store(true);
+        m_thread->wait();
+        delete m_thread;
+        m_thread = nullptr;
+    }
+
+#ifdef PV_HAVE_ALSA
+    if (m_pcm != nullptr)
+    {
+        snd_pcm_t* pcm = static_cast<snd_pcm_t*>(m_pcm);
+        snd_pcm_drop(pcm);
+        snd_pcm_close(pcm);
+    }
+#endif
+
+    m_pcm = nullptr;
+
+    if (isOpen())
+        QIODevice::close();
+}
+
+///
+/// \brief Sets the SCHED_FIFO priority of the capture thread, 0 for normal
+/// scheduling. Without permission (RLIMIT_RTPRIO, CAP_SYS_NICE) the thread
+/// falls back to normal scheduling. Takes effect with the next start().
+///
+void AlsaAudioSource::setRealtimePriority(int priority)
+{
+    m_realtimePriority = qBound(0, priority, 99);
+}
+
+///
+/// \brief Checks whether capture stopped on an unrecoverable ALSA error,
+/// errorString() has the reason.
+///
+bool AlsaAudioSource::failed() const
+{
+    return m_failed.load(std::memory_order_acquire);
+}
+
+///
+/// \brief Gets the capture counters. Frames are the engine frames captured,
+/// overruns are ALSA xruns, dropped are frames lost because the reader fell
+/// behind the ring.
+///
+AlsaAudioSource::Counters AlsaAudioSource::counters() const
+{
+    Counters counters;
+    counters.frames = m_frames.load(std::memory_order_relaxed);
+    counters.overruns = m_overruns.load(std::memory_order_relaxed);
+    counters.dropped = m_dropped.load(std::memory_order_relaxed);
+    counters.maxWakeUpNs = m_maxWakeUpNs.load(std::memory_order_relaxed);
+    counters.periodFrames = m_periodFrames;
+    counters.bufferFrames = m_bufferFrames;
+    counters.realtime = m_realtime.load(std::memory_order_relaxed);
+    return counters;
+}
+
+bool AlsaAudioSource::isSequential() const
+{
+    return true;
+}
+
+qint64 AlsaAudioSource::bytesAvailable() const
+{
+    const quint64 frames = m_written.load(std::memory_order_acquire) - m_read.load(std::memory_order_relaxed);
+    return qint64(frames) * 2 * m_frameLength - 2 * m_readOffset;
+}
+
+qint64 AlsaAudioSource::readData(char* data, qint64 maxSize)
+{
+    const quint64 written = m_written.load(std::memory_order_acquire);
+    quint64 read = m_read.load(std::memory_order_relaxed);
+    qint64 bytes = 0;
+
+    while (read != written && maxSize - bytes >= 2)
+    {
+        const qint16* frame = m_ring.constData() + (read % m_ringFrames) * m_frameLength;
+        const int samples = int(qMin(qint64(m_frameLength - m_readOffset), (maxSize - bytes) / 2));
+        std::memcpy(data + bytes, frame + m_readOffset, size_t(2 * samples));
+        bytes += 2 * samples;
+        m_readOffset += samples;
+
+        if (m_readOffset == m_frameLength)
+        {
+            m_readOffset = 0;
+            ++read;
+        }
+    }
+
+    m_read.store(read, std::memory_order_release);
+    return bytes;
+}
+
+qint64 AlsaAudioSource::writeData(const char* data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+//
+// Internal emits readyRead on the owning thread, coalesced while pending.
+//
+void AlsaAudioSource::notifyReady()
+{
+    m_notifyPending.store(false, std::memory_order_relaxed);
+
+    const bool failed = m_failed.load(std::memory_order_acquire);
+
+    // The reader learns about a failure from failed() on its next read
+    if (failed && errorString() != m_captureError)
+        setErrorString(m_captureError);
+
+    if (failed || bytesAvailable() > 0)
+        emit readyRead();
+}
+
+//
+// Capture thread: appends samples to the frame being filled and publishes it
+// once complete. A frame started while the ring is full is filled into the
+// scratch frame and dropped, the reader never sees a partial frame.
+//
+bool AlsaAudioSource::publishPeriod(const qint16* samples, int count)
+{
+    bool published = false;
+
+    while (count > 0)
+    {
+        const quint64 written = m_written.load(std::memory_order_relaxed);
+
+        if (m_slotFill == 0)
+            m_slotDropped = written - m_read.load(std::memory_order_acquire) >= quint64(m_ringFrames);
+
+        qint16* slot = m_slotDropped ? m_scratch.data() : m_ring.data() + (written % m_ringFrames) * m_frameLength;
+        const int samplesToCopy = qMin(count, m_frameLength - m_slotFill);
+        std::memcpy(slot + m_slotFill, samples, size_t(2 * samplesToCopy));
+        m_slotFill += samplesToCopy;
+        samples += samplesToCopy;
+        count -= samplesToCopy;
+
+        if (m_slotFill < m_frameLength)
+            break;
+
+        m_slotFill = 0;
+        m_frames.fetch_add(1, std::memory_order_relaxed);
+
+        if (m_slotDropped)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        m_written.store(written + 1, std::memory_order_release);
+        published = true;
+    }
+
+    return published;
+}
+
+//
+// Capture thread body: waits for a period, copies it out of the mmap area,
+// recovers from xruns and wakes the reader.
+//
+void AlsaAudioSource::capture()
+{
+#ifdef PV_HAVE_ALSA
+    snd_pcm_t* pcm = static_cast<snd_pcm_t*>(m_pcm);
+
+    if (m_realtimePriority > 0)
+    {
+        sched_param param;
+        param.sched_priority = m_realtimePriority;
+        m_realtime.store(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+        if (!m_realtime.load())
+            PorcupineLog::instance().post(PorcupineLog::Warning, QString("ALSA capture thread runs without real-time priority"));
+    }
+
+    const auto recover = [&](int err)
+    {
+        if (err == -EPIPE || err == -ESTRPIPE)
+            m_overruns.fetch_add(1, std::memory_order_relaxed);
+
+        if ((err = snd_pcm_recover(pcm, err, 1)) >= 0 && (err = snd_pcm_start(pcm)) >= 0)
+            return true;
+
+        m_captureError = QString("ALSA capture failed: %1").arg(snd_strerror(err));
+        m_failed.store(true, std::memory_order_release);
+        return false;
+    };
+
+    QElapsedTimer wakeUp;
+    int err = snd_pcm_start(pcm);
+
+    if (err < 0)
+        recover(err);
+
+    while (!m_stop.load(std::memory_order_relaxed) && !m_failed.load(std::memory_order_relaxed))
+    {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+
+        if (avail < 0)
+        {
+            recover(int(avail));
+            continue;
+        }
+
+        if (avail < m_frameLength)
+        {
+            if ((err = snd_pcm_wait(pcm, WaitTimeoutMs)) < 0)
+                recover(err);
+
+            continue;
+        }
+
+        wakeUp.start();
+        bool published = false;
+
+        while (avail > 0)
+        {
+            const snd_pcm_channel_area_t* areas = nullptr;
+            snd_pcm_uframes_t offset = 0;
+            snd_pcm_uframes_t frames = snd_pcm_uframes_t(avail);
+
+            if ((err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames)) < 0)
+            {
+                recover(err);
+                break;
+            }
+
+            // Mono 16 bit, the area is contiguous
+            const qint16* samples = reinterpret_cast<const qint16*>(static_cast<const char*>(areas[0].addr)
+                                                                   + (areas[0].first + offset * areas[0].step) / 8);
+            published = publishPeriod(samples, int(frames)) || published;
+            const snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm, offset, frames);
+
+            if (committed < 0 || snd_pcm_uframes_t(committed) != frames)
+            {
+                recover(committed < 0 ? int(committed) : -EPIPE);
+                break;
+            }
+
+            avail -= snd_pcm_sframes_t(frames);
+        }
+
+        const qint64 wakeUpNs = wakeUp.nsecsElapsed();
+
+        if (wakeUpNs > m_maxWakeUpNs.load(std::memory_order_relaxed))
+            m_maxWakeUpNs.store(wakeUpNs, std::memory_order_relaxed);
+
+        if (published && !m_notifyPending.exchange(true, std::memory_order_relaxed))
+            QMetaObject::invokeMethod(this, "notifyReady", Qt::QueuedConnection);
+    }
+
+    // Lets the owner see the failure
+    if (m_failed.load(std::memory_order_relaxed))
+        QMetaObject::invokeMethod(this, "notifyReady", Qt::QueuedConnection);
+#endif
+}
@@ -0,0 +1,94 @@
+#ifndef ALSAAUDIOSOURCE_H
+#define ALSAAUDIOSOURCE_H
+
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+class QThread;
+
+///
+/// \brief Audio capture straight from ALSA, read like a QtMultimedia device.
+/// The PCM is opened with mmap access, 16 bit mono at the engine sample rate
+/// and a period of one engine frame. A capture thread, real-time scheduled if
+/// permitted, copies every period from the mmap area into a lock-free ring
+/// of whole frames; bytesAvailable() and readyRead() only cover whole frames,
+/// so Porcupine::process() consumes reads without buffering a tail.
+/// Any ALSA PCM name works, including the "null" and "file" plugins.
+/// Without ALSA at build time (PV_HAVE_ALSA) start() fails.
+///
+class AlsaAudioSource : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Counters
+    {
+        qint64  frames = 0;
+        qint64  overruns = 0;
+        qint64  dropped = 0;
+        qint64  maxWakeUpNs = 0;
+        int     periodFrames = 0;
+        int     bufferFrames = 0;
+        bool    realtime = false;
+    };
+
+    AlsaAudioSource(qint32 sampleRate, int frameLength, QObject* parent = nullptr);
+    ~AlsaAudioSource();
+
+    static bool isAvailable();
+
+    bool start(const QString& deviceName, int periods = 4, QString* errMsg = nullptr);
+
+    void close() override;
+
+    void setRealtimePriority(int priority);
+
+    bool failed() const;
+
+    Counters counters() const;
+
+    bool isSequential() const override;
+
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private slots:
+    void notifyReady();
+
+private:
+    void capture();
+    bool publishPeriod(const qint16* samples, int count);
+
+    const qint32            m_sampleRate;
+    const int               m_frameLength;
+    const int               m_ringFrames;
+    void*                   m_pcm;
+    QThread*                m_thread;
+    int                     m_realtimePriority;
+    QVector<qint16>         m_ring;
+    QVector<qint16>         m_scratch;
+    QString                 m_captureError;
+    int                     m_slotFill;
+    bool                    m_slotDropped;
+    int                     m_readOffset;
+    std::atomic<quint64>    m_written;
+    std::atomic<quint64>    m_read;
+    std::atomic<bool>       m_stop;
+    std::atomic<bool>       m_failed;
+    std::atomic<bool>       m_notifyPending;
+    std::atomic<qint64>     m_frames;
+    std::atomic<qint64>     m_overruns;
+    std::atomic<qint64>     m_dropped;
+    std::atomic<qint64>     m_maxWakeUpNs;
+    std::atomic<bool>       m_realtime;
+    int                     m_periodFrames;
+    int                     m_bufferFrames;
+};
+
+#endif // ALSAAUDIOSOURCE_H
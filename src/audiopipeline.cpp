@@ -0,0 +1,414 @@
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "audiopipeline.h"
+#include "porcupinetrace.h"
+
+///
+/// \brief Allocates all frames of the pool.
+/// \param frameLength Samples per frame.
+/// \param frames Number of frames.
+///
+FramePool::FramePool(int frameLength, int frames)
+    : m_frameLength(frameLength)
+    , m_samples(frameLength * frames)
+    , m_refs(new std::atomic<int>[size_t(frames)])
+    , m_size(frames)
+    , m_next(0)
+    , m_exhausted(0)
+{
+    for (int i = 0; i < frames; ++i)
+        m_refs[size_t(i)].store(0, std::memory_order_relaxed);
+}
+
+///
+/// \brief Takes a free frame with one reference.
+/// \return The frame, invalid if all frames are in use.
+///
+AudioFrame FramePool::acquire()
+{
+    AudioFrame frame;
+    const int start = m_next.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < m_size; ++i)
+    {
+        const int slot = (start + i) % m_size;
+        int expected = 0;
+
+        if (m_refs[size_t(slot)].compare_exchange_strong(expected, 1, std::memory_order_acquire))
+        {
+            m_next.store((slot + 1) % m_size, std::memory_order_relaxed);
+            frame.pool = this;
+            frame.slot = slot;
+            frame.samples = m_samples.data() + qint64(slot) * m_frameLength;
+            frame.length = m_frameLength;
+            return frame;
+        }
+    }
+
+    m_exhausted.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+///
+/// \brief Adds a reference to frame, e.g. to keep it after AudioStage::process().
+///
+void FramePool::retain(const AudioFrame& frame)
+{
+    m_refs[size_t(frame.slot)].fetch_add(1, std::memory_order_relaxed);
+}
+
+///
+/// \brief Drops a reference, the frame is free again with the last one.
+/// The view is invalidated.
+///
+void FramePool::release(AudioFrame& frame)
+{
+    if (frame.isValid())
+        m_refs[size_t(frame.slot)].fetch_sub(1, std::memory_order_release);
+
+    frame = AudioFrame();
+}
+
+int FramePool::frameLength() const
+{
+    return m_frameLength;
+}
+
+int FramePool::size() const
+{
+    return m_size;
+}
+
+///
+/// \brief Gets the number of failed acquire() calls.
+///
+qint64 FramePool::exhausted() const
+{
+    return m_exhausted.load(std::memory_order_relaxed);
+}
+
+AudioStage::AudioStage(const QString& name)
+    : m_name(name)
+    , m_frames(0)
+    , m_dropped(0)
+    , m_processNs(0)
+    , m_maxNs(0)
+{
+}
+
+AudioStage::~AudioStage()
+{
+}
+
+const QString& AudioStage::name() const
+{
+    return m_name;
+}
+
+AudioSource::~AudioSource()
+{
+}
+
+///
+/// \brief Thread of one stage in a Threaded pipeline.
+///
+class AudioPipeline::StageThread : public QThread
+{
+
+public:
+    StageThread(AudioPipeline* owner, int index, int capacity)
+        : m_owner(owner)
+        , m_index(index)
+        , m_ring(capacity)
+        , m_head(0)
+        , m_count(0)
+        , m_stop(false)
+        , m_backlog(0)
+    {
+        setObjectName(owner->m_stages.at(index)->name());
+    }
+
+    ~StageThread() override
+    {
+        m_mutex.lock();
+        m_stop = true;
+        m_mutex.unlock();
+        m_wake.wakeOne();
+        wait();
+    }
+
+    //
+    // Queues frame, never waits. Returns false if the queue is full.
+    //
+    bool push(const AudioFrame& frame)
+    {
+        m_mutex.lock();
+
+        if (m_count == m_ring.size())
+        {
+            m_mutex.unlock();
+            return false;
+        }
+
+        m_ring[(m_head + m_count) % m_ring.size()] = frame;
+        ++m_count;
+        m_backlog.store(m_count, std::memory_order_relaxed);
+        m_mutex.unlock();
+        m_wake.wakeOne();
+        return true;
+    }
+
+    int backlog() const
+    {
+        return m_backlog.load(std::memory_order_relaxed);
+    }
+
+protected:
+    void run() override
+    {
+        for (;;)
+        {
+            m_mutex.lock();
+
+            while (m_count == 0 && !m_stop)
+                m_wake.wait(&m_mutex);
+
+            // Queued frames are still processed when stopping
+            if (m_count == 0)
+            {
+                m_mutex.unlock();
+                break;
+            }
+
+            AudioFrame frame = m_ring[m_head];
+            m_head = (m_head + 1) % m_ring.size();
+            --m_count;
+            m_backlog.store(m_count, std::memory_order_relaxed);
+            m_mutex.unlock();
+
+            if (!m_owner->runStage(m_index, frame))
+            {
+                m_owner->m_pool.release(frame);
+            }
+            else if (m_index + 1 < m_owner->m_threads.size())
+            {
+                if (!m_owner->m_threads.at(m_index + 1)->push(frame))
+                {
+                    m_owner->m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    m_owner->m_pool.release(frame);
+                }
+            }
+            else
+            {
+                m_owner->m_pool.release(frame);
+            }
+        }
+    }
+
+private:
+    AudioPipeline*          m_owner;
+    const int               m_index;
+    QMutex                  m_mutex;
+    QWaitCondition          m_wake;
+    QVector<AudioFrame>     m_ring;
+    int                     m_head;
+    int                     m_count;
+    bool                    m_stop;
+    std::atomic<int>        m_backlog;
+};
+
+///
+/// \brief Constructs an empty, stopped pipeline.
+/// \param frameLength Samples per frame, e.g. Porcupine::frameLength().
+/// \param poolFrames Frames in the pool, the bound of frames in flight.
+///
+AudioPipeline::AudioPipeline(int frameLength, int poolFrames)
+    : m_pool(frameLength, poolFrames)
+    , m_source(nullptr)
+    , m_mode(Inline)
+    , m_running(false)
+    , m_dropped(0)
+{
+}
+
+AudioPipeline::~AudioPipeline()
+{
+    stop();
+    qDeleteAll(m_stages);
+    delete m_source;
+}
+
+///
+/// \brief Sets the source, the pipeline takes ownership.
+///
+void AudioPipeline::setSource(AudioSource* source)
+{
+    delete m_source;
+    m_source = source;
+}
+
+///
+/// \brief Appends a stage, the pipeline takes ownership. Only while stopped.
+///
+void AudioPipeline::addStage(AudioStage* stage)
+{
+    Q_ASSERT(!m_running);
+    m_stages.append(stage);
+}
+
+///
+/// \brief Starts processing frames, Threaded starts one thread per stage.
+///
+void AudioPipeline::start(Mode mode)
+{
+    stop();
+    m_mode = mode;
+
+    if (mode == Threaded)
+    {
+        for (int i = 0; i < m_stages.size(); ++i)
+            m_threads.append(new StageThread(this, i, m_pool.size()));
+
+        for (auto thread : m_threads)
+            thread->start();
+    }
+
+    m_running = true;
+}
+
+///
+/// \brief Stops processing. Threaded, the frames already queued are processed
+/// before the threads end, so stop() and start() keep the stream intact,
+/// e.g. while an engine stage is replaced.
+///
+void AudioPipeline::stop()
+{
+    // First stage first, so every thread drains into a still running successor
+    for (auto thread : m_threads)
+        delete thread;
+
+    m_threads.clear();
+    m_running = false;
+}
+
+bool AudioPipeline::isRunning() const
+{
+    return m_running;
+}
+
+AudioPipeline::Mode AudioPipeline::mode() const
+{
+    return m_mode;
+}
+
+///
+/// \brief Pulls all complete frames from the source into the stages.
+/// \return Number of frames pulled.
+///
+int AudioPipeline::pump()
+{
+    if (!m_running || m_source == nullptr)
+        return 0;
+
+    PV_TRACE_SCOPE("pipeline.pump");
+    int frames = 0;
+
+    for (;;)
+    {
+        AudioFrame frame = m_source->next(&m_pool);
+
+        if (!frame.isValid())
+            break;
+
+        ++frames;
+
+        if (m_threads.isEmpty())
+        {
+            runStages(0, frame);
+        }
+        else if (!m_threads.first()->push(frame))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            m_pool.release(frame);
+        }
+    }
+
+    return frames;
+}
+
+//
+// Internal passes frame through the stages from first on, then releases it.
+//
+void AudioPipeline::runStages(int first, AudioFrame& frame)
+{
+    for (int i = first; i < m_stages.size(); ++i)
+    {
+        if (!runStage(i, frame))
+            break;
+    }
+
+    m_pool.release(frame);
+}
+
+//
+// Internal runs one stage and accounts its timing.
+//
+bool AudioPipeline::runStage(int index, AudioFrame& frame)
+{
+    AudioStage* stage = m_stages.at(index);
+    QElapsedTimer clock;
+    clock.start();
+    const bool passed = stage->process(frame);
+    const qint64 ns = clock.nsecsElapsed();
+    stage->m_frames.fetch_add(1, std::memory_order_relaxed);
+    stage->m_processNs.fetch_add(ns, std::memory_order_relaxed);
+
+    // Single writer per stage, no compare and swap needed
+    if (ns > stage->m_maxNs.load(std::memory_order_relaxed))
+        stage->m_maxNs.store(ns, std::memory_order_relaxed);
+
+    if (!passed)
+        stage->m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+    return passed;
+}
+
+///
+/// \brief Gets the timing of every stage, on the thread controlling the pipeline.
+///
+QVector<AudioStage::Timing> AudioPipeline::timings() const
+{
+    QVector<AudioStage::Timing> timings;
+
+    for (int i = 0; i < m_stages.size(); ++i)
+    {
+        const AudioStage* stage = m_stages.at(i);
+        AudioStage::Timing timing;
+        timing.name = stage->name();
+        timing.frames = stage->m_frames.load(std::memory_order_relaxed);
+        timing.dropped = stage->m_dropped.load(std::memory_order_relaxed);
+        timing.processNs = stage->m_processNs.load(std::memory_order_relaxed);
+        timing.maxNs = stage->m_maxNs.load(std::memory_order_relaxed);
+        timing.backlog = i < m_threads.size() ? m_threads.at(i)->backlog() : 0;
+        timings.append(timing);
+    }
+
+    return timings;
+}
+
+///
+/// \brief Gets the number of frames dropped on full stage queues.
+/// On an exhausted pool the source is not read, see FramePool::exhausted().
+///
+qint64 AudioPipeline::droppedFrames() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+FramePool* AudioPipeline::pool()
+{
+    return &m_pool;
+}
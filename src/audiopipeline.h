@@ -0,0 +1,184 @@
+#ifndef AUDIOPIPELINE_H
+#define AUDIOPIPELINE_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+class FramePool;
+
+///
+/// \brief Non-owning view of one pooled audio frame.
+/// Views are plain values passed between stages. The pipeline holds a pool
+/// reference while the frame travels; a stage keeping a frame beyond
+/// process() takes its own with FramePool::retain().
+///
+struct AudioFrame
+{
+    FramePool*  pool = nullptr;
+    int         slot = -1;
+    qint16*     samples = nullptr;
+    int         length = 0;
+    // Stream position of the first sample
+    qint64      position = 0;
+    // Set by an engine stage, -1 without detection
+    int         keywordIndex = -1;
+
+    bool isValid() const
+    {
+        return samples != nullptr;
+    }
+
+    const char* data() const
+    {
+        return reinterpret_cast<const char*>(samples);
+    }
+
+    int bytes() const
+    {
+        return 2 * length;
+    }
+};
+
+///
+/// \brief Fixed set of equally sized, reference counted frames.
+/// All frames are allocated up front in one block. acquire() and release()
+/// are lock-free and may be called from any thread.
+///
+class FramePool
+{
+
+public:
+    FramePool(int frameLength, int frames);
+
+    AudioFrame acquire();
+
+    void retain(const AudioFrame& frame);
+
+    void release(AudioFrame& frame);
+
+    int frameLength() const;
+
+    int size() const;
+
+    qint64 exhausted() const;
+
+private:
+    const int                               m_frameLength;
+    QVector<qint16>                         m_samples;
+    std::unique_ptr<std::atomic<int>[]>     m_refs;
+    const int                               m_size;
+    std::atomic<int>                        m_next;
+    std::atomic<qint64>                     m_exhausted;
+};
+
+///
+/// \brief One step between the source and the sinks.
+/// Converters change the samples in place, gates drop frames by returning
+/// false, engines annotate them and sinks consume them. process() is called
+/// on one thread at a time, with Threaded pipelines on the stage's own thread.
+///
+class AudioStage
+{
+
+public:
+    struct Timing
+    {
+        QString name;
+        qint64  frames = 0;
+        qint64  dropped = 0;
+        qint64  processNs = 0;
+        qint64  maxNs = 0;
+        int     backlog = 0;
+    };
+
+    explicit AudioStage(const QString& name);
+    virtual ~AudioStage();
+
+    const QString& name() const;
+
+    virtual bool process(AudioFrame& frame) = 0;
+
+private:
+    friend class AudioPipeline;
+
+    const QString       m_name;
+    std::atomic<qint64> m_frames;
+    std::atomic<qint64> m_dropped;
+    std::atomic<qint64> m_processNs;
+    std::atomic<qint64> m_maxNs;
+};
+
+///
+/// \brief Produces frames from a capture device or another input.
+/// next() fills a frame acquired from the pool and returns it, an invalid
+/// frame if no complete frame is available yet. Called on the pumping thread.
+///
+class AudioSource
+{
+
+public:
+    virtual ~AudioSource();
+
+    virtual AudioFrame next(FramePool* pool) = 0;
+};
+
+///
+/// \brief Source, stages and frame pool wired into a chain.
+/// pump() pulls all complete frames from the source. Inline, every frame then
+/// passes all stages on the pumping thread. Threaded, every stage runs on its
+/// own thread behind a bounded queue; a frame meeting a full queue is dropped
+/// and counted, so the source is never blocked. Per-stage timing is collected
+/// in both modes.
+///
+class AudioPipeline
+{
+
+public:
+    enum Mode
+    {
+        Inline,
+        Threaded
+    };
+
+    AudioPipeline(int frameLength, int poolFrames = 64);
+    ~AudioPipeline();
+
+    void setSource(AudioSource* source);
+
+    void addStage(AudioStage* stage);
+
+    void start(Mode mode);
+
+    void stop();
+
+    bool isRunning() const;
+
+    Mode mode() const;
+
+    int pump();
+
+    QVector<AudioStage::Timing> timings() const;
+
+    qint64 droppedFrames() const;
+
+    FramePool* pool();
+
+private:
+    class StageThread;
+
+    void runStages(int first, AudioFrame& frame);
+
+    bool runStage(int index, AudioFrame& frame);
+
+    FramePool                   m_pool;
+    AudioSource*                m_source;
+    QVector<AudioStage*>        m_stages;
+    QVector<StageThread*>       m_threads;
+    Mode                        m_mode;
+    bool                        m_running;
+    std::atomic<qint64>         m_dropped;
+};
+
+#endif // AUDIOPIPELINE_H
@@ -0,0 +1,194 @@
+#include <QIODevice>
+#include <cmath>
+
+#include "audiostages.h"
+#include "porcupine.h"
+#include "porcupinefanout.h"
+
+DeviceSource::DeviceSource(QIODevice* device)
+    : m_device(device)
+    , m_partialBytes(0)
+    , m_position(0)
+    , m_bytesRead(0)
+{
+}
+
+DeviceSource::~DeviceSource()
+{
+    if (m_partial.isValid())
+        m_partial.pool->release(m_partial);
+}
+
+///
+/// \brief Sets the device, e.g. after capture was reopened. A partial frame
+/// is kept and completed from the new device.
+///
+void DeviceSource::setDevice(QIODevice* device)
+{
+    m_device = device;
+}
+
+///
+/// \brief Reads the next complete frame.
+///
+AudioFrame DeviceSource::next(FramePool* pool)
+{
+    if (m_device == nullptr)
+        return AudioFrame();
+
+    if (!m_partial.isValid())
+    {
+        m_partial = pool->acquire();
+        m_partialBytes = 0;
+
+        if (!m_partial.isValid())
+            return AudioFrame();
+    }
+
+    char* const data = reinterpret_cast<char*>(m_partial.samples);
+    const qint64 bytes = m_device->read(data + m_partialBytes, m_partial.bytes() - m_partialBytes);
+
+    if (bytes <= 0)
+        return AudioFrame();
+
+    m_bytesRead += bytes;
+    m_partialBytes += int(bytes);
+
+    if (m_partialBytes < m_partial.bytes())
+        return AudioFrame();
+
+    AudioFrame frame = m_partial;
+    frame.position = m_position;
+    m_position += frame.length;
+    m_partial = AudioFrame();
+    return frame;
+}
+
+///
+/// \brief Gets the number of bytes read from all devices.
+///
+qint64 DeviceSource::bytesRead() const
+{
+    return m_bytesRead;
+}
+
+///
+/// \param dB Gain in dB.
+///
+GainStage::GainStage(qreal dB)
+    : AudioStage("gain")
+    , m_gainQ12(int(std::lround(4096 * std::pow(10.0, dB / 20))))
+{
+}
+
+bool GainStage::process(AudioFrame& frame)
+{
+    // Computed in 64 bit, above +24 dB the product overflows int before the clamp
+    for (int i = 0; i < frame.length; ++i)
+        frame.samples[i] = qint16(qBound(qint64(-32768), (qint64(frame.samples[i]) * m_gainQ12) >> 12, qint64(32767)));
+
+    return true;
+}
+
+///
+/// \param dBFS Mean frame level in dB relative to full scale, e.g. -40.
+/// \param hangoverFrames Frames passed after the last frame above the level.
+///
+LevelGateStage::LevelGateStage(qreal dBFS, int hangoverFrames)
+    : AudioStage("gate")
+    , m_hangoverFrames(hangoverFrames)
+    , m_hangover(0)
+{
+    const qreal amplitude = 32768 * std::pow(10.0, dBFS / 20);
+    m_thresholdMeanSquare = qint64(amplitude * amplitude);
+}
+
+bool LevelGateStage::process(AudioFrame& frame)
+{
+    qint64 sum = 0;
+
+    for (int i = 0; i < frame.length; ++i)
+        sum += qint64(frame.samples[i]) * frame.samples[i];
+
+    if (frame.length > 0 && sum / frame.length >= m_thresholdMeanSquare)
+        m_hangover = m_hangoverFrames;
+    else if (m_hangover > 0)
+        --m_hangover;
+    else
+        return false;
+
+    return true;
+}
+
+PorcupineStage::PorcupineStage(Porcupine* engine)
+    : AudioStage("porcupine")
+    , m_engine(engine)
+    , m_failed(false)
+{
+}
+
+///
+/// \brief Replaces the engine, only while the pipeline is stopped.
+///
+void PorcupineStage::setEngine(Porcupine* engine)
+{
+    m_engine = engine;
+    m_failed.store(false, std::memory_order_relaxed);
+}
+
+bool PorcupineStage::process(AudioFrame& frame)
+{
+    int keywordIndex = -1;
+
+    if (m_failed.load(std::memory_order_relaxed))
+        return false;
+
+    if (!m_engine->process(keywordIndex, frame.data(), frame.bytes(), &m_errMsg))
+    {
+        m_failed.store(true, std::memory_order_release);
+        return false;
+    }
+
+    frame.keywordIndex = keywordIndex;
+    return true;
+}
+
+///
+/// \brief Gets whether the engine failed, it processes no further frames.
+///
+bool PorcupineStage::failed() const
+{
+    return m_failed.load(std::memory_order_acquire);
+}
+
+///
+/// \brief Gets the message of the failure, only valid once failed() is true.
+///
+const QString& PorcupineStage::errorMessage() const
+{
+    return m_errMsg;
+}
+
+FanoutStage::FanoutStage(PorcupineFanout* fanout)
+    : AudioStage("fanout")
+    , m_fanout(fanout)
+{
+}
+
+bool FanoutStage::process(AudioFrame& frame)
+{
+    m_fanout->dispatch(frame.data(), frame.bytes());
+    return true;
+}
+
+CallbackStage::CallbackStage(const QString& name, std::function<void(const AudioFrame&)> callback)
+    : AudioStage(name)
+    , m_callback(std::move(callback))
+{
+}
+
+bool CallbackStage::process(AudioFrame& frame)
+{
+    m_callback(frame);
+    return true;
+}
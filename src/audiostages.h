@@ -0,0 +1,126 @@
+#ifndef AUDIOSTAGES_H
+#define AUDIOSTAGES_H
+
+#include <atomic>
+#include <functional>
+
+#include "audiopipeline.h"
+
+class QIODevice;
+class Porcupine;
+class PorcupineFanout;
+
+///
+/// \brief Source reading a capture device, e.g. the QAudioSource device.
+/// Audio is read straight into pooled frames, partial frames wait in their
+/// frame for the next read.
+///
+class DeviceSource : public AudioSource
+{
+
+public:
+    explicit DeviceSource(QIODevice* device = nullptr);
+    ~DeviceSource() override;
+
+    void setDevice(QIODevice* device);
+
+    AudioFrame next(FramePool* pool) override;
+
+    qint64 bytesRead() const;
+
+private:
+    QIODevice*  m_device;
+    AudioFrame  m_partial;
+    int         m_partialBytes;
+    qint64      m_position;
+    qint64      m_bytesRead;
+};
+
+///
+/// \brief Converter scaling the samples by a fixed gain, with saturation.
+///
+class GainStage : public AudioStage
+{
+
+public:
+    explicit GainStage(qreal dB);
+
+    bool process(AudioFrame& frame) override;
+
+private:
+    const int m_gainQ12;
+};
+
+///
+/// \brief Gate passing frames at or above a level, and the frames following
+/// them for the hangover, so the tail of a keyword is not cut.
+///
+class LevelGateStage : public AudioStage
+{
+
+public:
+    LevelGateStage(qreal dBFS, int hangoverFrames);
+
+    bool process(AudioFrame& frame) override;
+
+private:
+    qint64      m_thresholdMeanSquare;
+    const int   m_hangoverFrames;
+    int         m_hangover;
+};
+
+///
+/// \brief Engine stage, runs Porcupine on every frame and annotates the detection.
+/// Whole frames take the engine's direct path, the samples are not copied.
+///
+class PorcupineStage : public AudioStage
+{
+
+public:
+    explicit PorcupineStage(Porcupine* engine);
+
+    void setEngine(Porcupine* engine);
+
+    bool process(AudioFrame& frame) override;
+
+    bool failed() const;
+
+    const QString& errorMessage() const;
+
+private:
+    Porcupine*          m_engine;
+    QString             m_errMsg;
+    std::atomic<bool>   m_failed;
+};
+
+///
+/// \brief Sink handing every frame to the additional engines of a fan-out.
+///
+class FanoutStage : public AudioStage
+{
+
+public:
+    explicit FanoutStage(PorcupineFanout* fanout);
+
+    bool process(AudioFrame& frame) override;
+
+private:
+    PorcupineFanout* m_fanout;
+};
+
+///
+/// \brief Sink calling a function for every frame, e.g. to report detections.
+///
+class CallbackStage : public AudioStage
+{
+
+public:
+    CallbackStage(const QString& name, std::function<void(const AudioFrame&)> callback);
+
+    bool process(AudioFrame& frame) override;
+
+private:
+    std::function<void(const AudioFrame&)> m_callback;
+};
+
+#endif // AUDIOSTAGES_H
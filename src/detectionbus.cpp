@@ -0,0 +1,256 @@
+#include <QMutexLocker>
+#include <chrono>
+#include <thread>
+
+#include "detectionbus.h"
+
+namespace
+{
+
+//
+// Slot a thread is delivering to, linked to the deliveries further up its
+// stack, e.g. when a notifier publishes again.
+//
+struct Delivery
+{
+    const void*     bus;
+    int             slot;
+    const Delivery* outer;
+};
+
+thread_local const Delivery* t_delivery = nullptr;
+
+}
+
+DetectionBus::Subscription::Subscription(const QString& name, int limit, Notifier notifier, void* context)
+    : m_name(name)
+    , m_queue(limit)
+    , m_delivered(0)
+    , m_notified(false)
+    , m_notifier(notifier)
+    , m_context(context)
+{
+}
+
+const QString& DetectionBus::Subscription::name() const
+{
+    return m_name;
+}
+
+///
+/// \brief Takes the oldest queued detection. Only one thread may take.
+/// \param event Output of the detection.
+/// \return false if nothing is queued, the notifier is armed again.
+///
+bool DetectionBus::Subscription::take(Event* event)
+{
+    if (!m_queue.pop(event))
+    {
+        m_notified.store(false, std::memory_order_seq_cst);
+
+        // A detection queued while the notifier was still disarmed
+        if (!m_queue.pop(event))
+            return false;
+    }
+
+    // Counted when the subscriber has it, not when it was queued
+    m_delivered.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+///
+/// \brief Gets the number of detections queued and not yet taken.
+///
+qint64 DetectionBus::Subscription::backlog() const
+{
+    return m_queue.size();
+}
+
+///
+/// \brief Gets the number of detections dropped at the backlog limit.
+///
+qint64 DetectionBus::Subscription::dropped() const
+{
+    return m_queue.dropped();
+}
+
+DetectionBus::Counters DetectionBus::Subscription::counters() const
+{
+    Counters counters;
+    counters.name = m_name;
+    counters.delivered = m_delivered.load(std::memory_order_relaxed);
+    counters.dropped = dropped();
+    counters.backlog = backlog();
+    counters.limit = m_queue.limit();
+    return counters;
+}
+
+//
+// Internal queues event, never blocks.
+//
+void DetectionBus::Subscription::push(const Event& event)
+{
+    if (!m_queue.push(event))
+        return;
+
+    // The last access of this subscription, the notifier may unsubscribe it
+    if (m_notifier != nullptr && !m_notified.exchange(true, std::memory_order_seq_cst))
+        m_notifier(m_context);
+}
+
+DetectionBus::DetectionBus()
+    : m_sequence(0)
+    , m_forward(nullptr)
+{
+    for (int i = 0; i < MaxSubscribers; ++i)
+    {
+        m_subscribers[i].store(nullptr, std::memory_order_relaxed);
+        m_users[i].store(0, std::memory_order_relaxed);
+        m_retiring[i] = false;
+    }
+}
+
+DetectionBus::~DetectionBus()
+{
+    for (auto& subscriber : m_subscribers)
+        delete subscriber.exchange(nullptr);
+}
+
+///
+/// \brief Adds a subscriber, it receives the detections published from now on.
+/// \param name Name in counters and metrics.
+/// \param limit Backlog limit, detections beyond it are dropped.
+/// \param notifier Optional wake-up of the subscriber, see Notifier.
+/// \param context Argument of the notifier.
+/// \return The subscription owned by the bus, nullptr if all slots are taken.
+///
+DetectionBus::Subscription* DetectionBus::subscribe(const QString& name, int limit, Notifier notifier, void* context)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < MaxSubscribers; ++i)
+    {
+        if (m_subscribers[i].load(std::memory_order_relaxed) == nullptr && !m_retiring[i])
+        {
+            Subscription* subscription = new Subscription(name, limit, notifier, context);
+            m_subscribers[i].store(subscription, std::memory_order_seq_cst);
+            return subscription;
+        }
+    }
+
+    return nullptr;
+}
+
+///
+/// \brief Removes and deletes a subscription. Only waits for publishers still
+/// delivering to this subscription, the publishers themselves never wait.
+/// May be called from the subscription's notifier.
+///
+void DetectionBus::unsubscribe(Subscription* subscription)
+{
+    if (subscription == nullptr)
+        return;
+
+    int slot = -1;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        for (int i = 0; i < MaxSubscribers && slot < 0; ++i)
+        {
+            if (m_subscribers[i].load(std::memory_order_relaxed) == subscription)
+                slot = i;
+        }
+
+        if (slot < 0)
+            return;
+
+        // Publishers arriving from now on skip the slot, it is not reused yet
+        m_subscribers[slot].store(nullptr, std::memory_order_seq_cst);
+        m_retiring[slot] = true;
+    }
+
+    // Deliveries of this thread further up the stack, i.e. from a notifier,
+    // do not touch the subscription after it returns
+    int own = 0;
+
+    for (const Delivery* delivery = t_delivery; delivery != nullptr; delivery = delivery->outer)
+        own += delivery->bus == this && delivery->slot == slot ? 1 : 0;
+
+    while (m_users[slot].load(std::memory_order_seq_cst) > own)
+        std::this_thread::yield();
+
+    delete subscription;
+    QMutexLocker locker(&m_mutex);
+    m_retiring[slot] = false;
+}
+
+///
+/// \brief Passes every detection on to sink as well, synchronously on the
+/// publishing thread. The sink is not owned, nullptr to stop forwarding.
+///
+void DetectionBus::setForward(DetectionSink* sink)
+{
+    m_forward.store(sink, std::memory_order_release);
+}
+
+///
+/// \brief Gets the counters of all subscribers.
+///
+QVector<DetectionBus::Counters> DetectionBus::counters() const
+{
+    QMutexLocker locker(&m_mutex);
+    QVector<Counters> counters;
+
+    for (const auto& subscriber : m_subscribers)
+    {
+        if (const Subscription* subscription = subscriber.load(std::memory_order_relaxed))
+            counters.append(subscription->counters());
+    }
+
+    return counters;
+}
+
+///
+/// \brief Gets the number of detections published.
+///
+qint64 DetectionBus::published() const
+{
+    return qint64(m_sequence.load(std::memory_order_relaxed));
+}
+
+void DetectionBus::detected(const QString& engine, int keywordIndex, qint64 frame)
+{
+    Event event;
+    event.engine = engine;
+    event.keywordIndex = keywordIndex;
+    event.frame = frame;
+    event.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+    // Gaps in the sequence tell a subscriber what it missed
+    event.sequence = m_sequence.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    for (int i = 0; i < MaxSubscribers; ++i)
+    {
+        // Most slots are empty, only a subscriber is worth the counting
+        if (m_subscribers[i].load(std::memory_order_relaxed) == nullptr)
+            continue;
+
+        // Counted before the subscriber is loaded again, so unsubscribe()
+        // either sees this publisher or this publisher sees the empty slot
+        m_users[i].fetch_add(1, std::memory_order_seq_cst);
+
+        if (Subscription* subscription = m_subscribers[i].load(std::memory_order_seq_cst))
+        {
+            const Delivery delivery = {this, i, t_delivery};
+            t_delivery = &delivery;
+            subscription->push(event);
+            t_delivery = delivery.outer;
+        }
+
+        m_users[i].fetch_sub(1, std::memory_order_release);
+    }
+
+    if (DetectionSink* sink = m_forward.load(std::memory_order_acquire))
+        sink->detected(engine, keywordIndex, frame);
+}
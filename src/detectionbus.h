@@ -0,0 +1,109 @@
+#ifndef DETECTIONBUS_H
+#define DETECTIONBUS_H
+
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+#include "detectionsink.h"
+#include "mpscring.h"
+
+///
+/// \brief Publishes detections to several in-process subscribers.
+/// Registered as DetectionSink of the engines, the bus copies every detection
+/// into one bounded lock-free MpscRing per subscriber, e.g. a recognizer, a
+/// logger, metrics and the UI. Publishing never blocks and never allocates:
+/// a subscriber at its backlog limit loses the new detection and counts it,
+/// the engine and the other subscribers are not affected. Subscribers take
+/// events on their own thread, polling or woken by a notifier. Removing a
+/// subscriber only waits for publishers delivering to that subscriber.
+///
+class DetectionBus : public DetectionSink
+{
+
+public:
+    struct Event
+    {
+        QString engine;
+        int     keywordIndex = -1;
+        qint64  frame = 0;
+        qint64  timeNs = 0;
+        quint64 sequence = 0;
+    };
+
+    struct Counters
+    {
+        QString name;
+        qint64  delivered = 0;
+        qint64  dropped = 0;
+        qint64  backlog = 0;
+        int     limit = 0;
+    };
+
+    ///
+    /// \brief Called on the publishing thread when a subscriber's queue
+    /// becomes non-empty, again only after take() found it empty. Must not
+    /// block, e.g. post to an event loop or notify a condition variable. It
+    /// may unsubscribe its own subscription.
+    ///
+    typedef void (*Notifier)(void* context);
+
+    class Subscription
+    {
+
+    public:
+        const QString& name() const;
+
+        bool take(Event* event);
+
+        qint64 backlog() const;
+
+        qint64 dropped() const;
+
+        Counters counters() const;
+
+    private:
+        friend class DetectionBus;
+
+        Subscription(const QString& name, int limit, Notifier notifier, void* context);
+
+        void push(const Event& event);
+
+        const QString               m_name;
+        MpscRing<Event>             m_queue;
+        std::atomic<qint64>         m_delivered;
+        std::atomic<bool>           m_notified;
+        Notifier                    m_notifier;
+        void*                       m_context;
+    };
+
+    DetectionBus();
+    ~DetectionBus();
+
+    Subscription* subscribe(const QString& name, int limit = 64, Notifier notifier = nullptr, void* context = nullptr);
+
+    void unsubscribe(Subscription* subscription);
+
+    void setForward(DetectionSink* sink);
+
+    QVector<Counters> counters() const;
+
+    qint64 published() const;
+
+    void detected(const QString& engine, int keywordIndex, qint64 frame) override;
+
+private:
+    static const int MaxSubscribers = 16;
+
+    std::atomic<Subscription*>  m_subscribers[MaxSubscribers];
+    // Publishers that may still use the subscriber of a slot
+    std::atomic<int>            m_users[MaxSubscribers];
+    // Slots whose subscriber is being removed, under m_mutex
+    bool                        m_retiring[MaxSubscribers];
+    std::atomic<quint64>        m_sequence;
+    std::atomic<DetectionSink*> m_forward;
+    mutable QMutex              m_mutex;
+};
+
+#endif // DETECTIONBUS_H
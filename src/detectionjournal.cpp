@@ -0,0 +1,384 @@
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "detectionjournal.h"
+
+namespace
+{
+
+const quint32 JournalMagic = 0x4a445650;
+const quint32 JournalVersion = 1;
+const int HeaderSize = 4096;
+const int IndexEntries = (HeaderSize - 6 * sizeof(quint32)) / sizeof(qint64);
+
+struct SegmentHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 recordSize;
+    quint32 capacity;
+    quint32 indexStride;
+    quint32 reserved;
+    // Wall time of the first record of every indexStride records, 0 until
+    // that record is appended; written by appenders while queries read it
+    std::atomic<qint64> index[IndexEntries];
+};
+
+static_assert(sizeof(SegmentHeader) <= HeaderSize, "segment header exceeds its reserved size");
+static_assert(sizeof(std::atomic<qint64>) == sizeof(qint64) && std::atomic<qint64>::is_always_lock_free,
+              "the mapped time index needs plain lock-free 64 bit atomics");
+
+SegmentHeader* header(uchar* data)
+{
+    return reinterpret_cast<SegmentHeader*>(data);
+}
+
+DetectionJournal::Record* records(uchar* data)
+{
+    return reinterpret_cast<DetectionJournal::Record*>(data + HeaderSize);
+}
+
+std::atomic<quint32>* commitFlag(DetectionJournal::Record* record)
+{
+    return reinterpret_cast<std::atomic<quint32>*>(&record->committed);
+}
+
+}
+
+DetectionJournal::DetectionJournal(const QString& directory, int recordsPerSegment, int maxSegments)
+    : m_directory(directory)
+    , m_capacity(quint32(qMax(1, recordsPerSegment)))
+    , m_indexStride((m_capacity + IndexEntries - 1) / IndexEntries)
+    , m_maxSegments(qMax(2, maxSegments))
+    , m_nextSequence(1)
+    , m_current(nullptr)
+    , m_appending(0)
+    , m_dropped(0)
+{
+}
+
+DetectionJournal::~DetectionJournal()
+{
+    close();
+}
+
+///
+/// \brief Opens the journal, appending continues after the last committed record.
+/// Files of another layout are left alone, new segments are numbered after them.
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool DetectionJournal::open(QString* errMsg)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_current.load() != nullptr)
+        return true;
+
+    if (!QDir().mkpath(m_directory))
+    {
+        if (errMsg != nullptr)
+            *errMsg = QString("Cannot create journal directory \"%1\"").arg(m_directory);
+
+        return false;
+    }
+
+    QStringList names = QDir(m_directory).entryList({"journal-*.pvj"}, QDir::Files, QDir::Name);
+
+    for (const auto& name : names)
+    {
+        const quint64 sequence = name.mid(8, name.size() - 12).toULongLong();
+        SegmentPtr segment = openSegment(sequence, false);
+        m_nextSequence = qMax(m_nextSequence, sequence + 1);
+
+        if (!segment.isNull())
+            m_segments.append(segment);
+    }
+
+    if (m_segments.isEmpty())
+    {
+        const SegmentPtr segment = openSegment(m_nextSequence++, true);
+
+        if (!segment.isNull())
+            m_segments.append(segment);
+    }
+
+    if (m_segments.isEmpty())
+    {
+        if (errMsg != nullptr)
+            *errMsg = QString("Cannot create journal segment in \"%1\"").arg(m_directory);
+
+        return false;
+    }
+
+    m_current.store(m_segments.last().data(), std::memory_order_seq_cst);
+    return true;
+}
+
+///
+/// \brief Closes the journal. Waits for appends in progress, segments are
+/// unmapped once running queries are done with them.
+///
+void DetectionJournal::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_current.store(nullptr, std::memory_order_seq_cst);
+    // An append rotating waits for the mutex, let it see the closed journal
+    locker.unlock();
+
+    while (m_appending.load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+
+    locker.relock();
+    m_segments.clear();
+}
+
+bool DetectionJournal::isOpen() const
+{
+    return m_current.load(std::memory_order_acquire) != nullptr;
+}
+
+///
+/// \brief Appends a detection. Lock-free unless the current segment is full.
+/// \param streamId Id of the audio stream.
+/// \param keywordIndex Index of the detected keyword.
+/// \param sampleOffset Position of the detection in the stream in samples.
+/// \param engineVersion Engine version, truncated to 15 characters.
+/// \return false if the record could not be stored.
+///
+bool DetectionJournal::append(quint32 streamId, qint32 keywordIndex, qint64 sampleOffset, const char* engineVersion)
+{
+    // Counted before the segment is loaded, so close() can wait for this append
+    m_appending.fetch_add(1, std::memory_order_seq_cst);
+    const bool appended = appendRecord(streamId, keywordIndex, sampleOffset, engineVersion);
+    m_appending.fetch_sub(1, std::memory_order_release);
+    return appended;
+}
+
+//
+// Internal writes a record into the current segment, see append().
+//
+bool DetectionJournal::appendRecord(quint32 streamId, qint32 keywordIndex, qint64 sampleOffset, const char* engineVersion)
+{
+    Segment* segment = m_current.load(std::memory_order_seq_cst);
+
+    if (segment == nullptr)
+        return false;
+
+    quint32 slot = segment->next.fetch_add(1, std::memory_order_relaxed);
+
+    if (slot >= m_capacity)
+    {
+        segment = rotate(segment);
+
+        if (segment == nullptr)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slot = segment->next.fetch_add(1, std::memory_order_relaxed);
+
+        if (slot >= m_capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    const qint64 wallTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count();
+    Record* record = records(segment->data) + slot;
+    record->wallTimeUs = wallTimeUs;
+    record->sampleOffset = sampleOffset;
+    record->streamId = streamId;
+    record->keywordIndex = keywordIndex;
+    std::strncpy(record->engineVersion, engineVersion, sizeof(record->engineVersion) - 1);
+    record->engineVersion[sizeof(record->engineVersion) - 1] = '\0';
+
+    if (slot % m_indexStride == 0)
+        header(segment->data)->index[slot / m_indexStride].store(wallTimeUs, std::memory_order_relaxed);
+
+    // Readers only look at committed records
+    commitFlag(record)->store(1, std::memory_order_release);
+    return true;
+}
+
+///
+/// \brief Gets all committed detections of a time range.
+/// \param fromUs Begin of the range, microseconds since epoch.
+/// \param toUs End of the range (inclusive), microseconds since epoch.
+/// \param streamId Only records of this stream, all streams if negative.
+/// \return The matching records in journal order.
+///
+QVector<DetectionJournal::Record> DetectionJournal::query(qint64 fromUs, qint64 toUs, int streamId) const
+{
+    QVector<Record> result;
+    QVector<SegmentPtr> segments;
+
+    // The references keep the segments mapped, appends and rotation go on meanwhile
+    {
+        QMutexLocker locker(&m_mutex);
+        segments = m_segments;
+    }
+
+    for (int s = 0; s < segments.size(); ++s)
+    {
+        const Segment* segment = segments.at(s).data();
+        const SegmentHeader* head = header(segment->data);
+
+        // Segments are chronological, skip those ending before the range. The
+        // next segment's first time is 0 right after a rotation, unknown yet
+        if (s + 1 < segments.size())
+        {
+            const qint64 nextUs = header(segments.at(s + 1)->data)->index[0].load(std::memory_order_relaxed);
+
+            if (nextUs != 0 && nextUs < fromUs)
+                continue;
+        }
+
+        if (head->index[0].load(std::memory_order_relaxed) > toUs)
+            break;
+
+        const quint32 count = qMin(segment->next.load(std::memory_order_acquire), m_capacity);
+        const quint32 strides = (count + m_indexStride - 1) / m_indexStride;
+        quint32 stride = 0;
+
+        // Last stride starting before the range, concurrent appends may be slightly out of order
+        for (; stride + 1 < strides; ++stride)
+        {
+            const qint64 nextUs = head->index[stride + 1].load(std::memory_order_relaxed);
+
+            if (nextUs == 0 || nextUs >= fromUs)
+                break;
+        }
+
+        const Record* rec = records(segment->data);
+
+        for (quint32 i = stride * m_indexStride; i < count; ++i)
+        {
+            if (commitFlag(const_cast<Record*>(rec + i))->load(std::memory_order_acquire) == 0)
+                continue;
+
+            if (rec[i].wallTimeUs > toUs && (i % m_indexStride) == 0)
+                break;
+
+            if (rec[i].wallTimeUs >= fromUs && rec[i].wallTimeUs <= toUs
+                && (streamId < 0 || rec[i].streamId == quint32(streamId)))
+                result.append(rec[i]);
+        }
+    }
+
+    return result;
+}
+
+///
+/// \brief Gets the number of detections that could not be stored.
+///
+qint64 DetectionJournal::droppedRecords() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+//
+// Internal maps a segment file. An existing segment continues after its last
+// committed record, a new one is only created if no file of that name exists.
+//
+DetectionJournal::SegmentPtr DetectionJournal::openSegment(quint64 sequence, bool create)
+{
+    const qint64 size = HeaderSize + qint64(m_capacity) * sizeof(Record);
+    QFile* file = new QFile(segmentPath(sequence));
+    const QIODevice::OpenMode mode = create ? QIODevice::ReadWrite | QIODevice::NewOnly : QIODevice::ReadWrite;
+
+    if (!file->open(mode) || (create && !file->resize(size)) || file->size() < HeaderSize)
+    {
+        delete file;
+        return SegmentPtr();
+    }
+
+    uchar* data = file->map(0, file->size());
+    SegmentHeader* head = data != nullptr ? header(data) : nullptr;
+
+    if (head != nullptr && create)
+    {
+        head->magic = JournalMagic;
+        head->version = JournalVersion;
+        head->recordSize = sizeof(Record);
+        head->capacity = m_capacity;
+        head->indexStride = m_indexStride;
+    }
+
+    if (head == nullptr || head->magic != JournalMagic || head->version != JournalVersion
+        || head->recordSize != sizeof(Record) || head->capacity != m_capacity || file->size() != size)
+    {
+        // Written with another layout, leave it alone
+        delete file;
+        return SegmentPtr();
+    }
+
+    Segment* segment = new Segment;
+    segment->sequence = sequence;
+    segment->file = file;
+    segment->data = data;
+    quint32 next = m_capacity;
+
+    while (next > 0 && records(data)[next - 1].committed == 0)
+        --next;
+
+    segment->next.store(next, std::memory_order_relaxed);
+    return SegmentPtr(segment, &DetectionJournal::closeSegment);
+}
+
+//
+// Internal deleter of the last reference to a segment.
+//
+void DetectionJournal::closeSegment(Segment* segment)
+{
+    const QString path = segment->file->fileName();
+    segment->file->unmap(segment->data);
+    delete segment->file;
+
+    if (segment->remove)
+        QFile::remove(path);
+
+    delete segment;
+}
+
+//
+// Internal slow path of append(): the first writer to lock creates the next
+// segment, all others pick it up. Beyond maxSegments the oldest file is deleted.
+//
+DetectionJournal::Segment* DetectionJournal::rotate(Segment* full)
+{
+    QMutexLocker locker(&m_mutex);
+    Segment* current = m_current.load(std::memory_order_acquire);
+
+    // Another writer rotated already, or the journal was closed
+    if (current != full)
+        return current;
+
+    const SegmentPtr segment = openSegment(m_nextSequence++, true);
+
+    if (segment.isNull())
+        return nullptr;
+
+    m_segments.append(segment);
+    m_current.store(segment.data(), std::memory_order_seq_cst);
+
+    // Deleted when the last query using it is done
+    while (m_segments.size() > m_maxSegments)
+        m_segments.takeFirst()->remove = true;
+
+    return segment.data();
+}
+
+QString DetectionJournal::segmentPath(quint64 sequence) const
+{
+    return QDir(m_directory).filePath(QString("journal-%1.pvj").arg(sequence, 12, 10, QChar('0')));
+}
@@ -0,0 +1,82 @@
+#ifndef DETECTIONJOURNAL_H
+#define DETECTIONJOURNAL_H
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+class QFile;
+
+///
+/// \brief Append-only, memory-mapped journal of keyword detections.
+/// The journal is a directory of fixed-size segment files. Appending reserves
+/// a slot with one atomic add and writes the record directly into the mapped
+/// segment, only rotating to a new segment takes a lock. Every segment carries
+/// a sparse time index, so range queries only scan the matching part of the
+/// matching segments. Queries scan outside the lock, segments stay mapped
+/// until the last query using them is done. The oldest segments are deleted
+/// beyond maxSegments. Existing files are never overwritten.
+///
+class DetectionJournal
+{
+
+public:
+    struct Record
+    {
+        qint64  wallTimeUs;
+        qint64  sampleOffset;
+        quint32 streamId;
+        qint32  keywordIndex;
+        char    engineVersion[16];
+        quint32 committed;
+        quint32 reserved;
+    };
+
+    explicit DetectionJournal(const QString& directory, int recordsPerSegment = 65536, int maxSegments = 64);
+    ~DetectionJournal();
+
+    bool open(QString* errMsg = nullptr);
+
+    void close();
+
+    bool isOpen() const;
+
+    bool append(quint32 streamId, qint32 keywordIndex, qint64 sampleOffset, const char* engineVersion);
+
+    QVector<Record> query(qint64 fromUs, qint64 toUs, int streamId = -1) const;
+
+    qint64 droppedRecords() const;
+
+private:
+    struct Segment
+    {
+        quint64                 sequence = 0;
+        QFile*                  file = nullptr;
+        uchar*                  data = nullptr;
+        std::atomic<quint32>    next;
+        bool                    remove = false;
+    };
+
+    typedef QSharedPointer<Segment> SegmentPtr;
+
+    SegmentPtr openSegment(quint64 sequence, bool create);
+    static void closeSegment(Segment* segment);
+    Segment* rotate(Segment* full);
+    bool appendRecord(quint32 streamId, qint32 keywordIndex, qint64 sampleOffset, const char* engineVersion);
+    QString segmentPath(quint64 sequence) const;
+
+    const QString           m_directory;
+    const quint32           m_capacity;
+    const quint32           m_indexStride;
+    const int               m_maxSegments;
+    QVector<SegmentPtr>     m_segments;
+    quint64                 m_nextSequence;
+    std::atomic<Segment*>   m_current;
+    std::atomic<int>        m_appending;
+    mutable QMutex          m_mutex;
+    std::atomic<qint64>     m_dropped;
+};
+
+#endif // DETECTIONJOURNAL_H
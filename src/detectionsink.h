@@ -0,0 +1,26 @@
+#ifndef DETECTIONSINK_H
+#define DETECTIONSINK_H
+
+#include <QString>
+
+///
+/// \brief Receiver of keyword detections, called on the thread of the detecting engine.
+/// Implementations must be thread-safe and must not block, e.g. queue the
+/// detection and wake a consumer. See AwaitableDetector.
+///
+class DetectionSink
+{
+
+public:
+    virtual ~DetectionSink() = default;
+
+    ///
+    /// \brief Reports one detection.
+    /// \param engine Tag of the engine, empty for the primary engine.
+    /// \param keywordIndex Index of the detected keyword.
+    /// \param frame Position of the detection in the stream in engine frames.
+    ///
+    virtual void detected(const QString& engine, int keywordIndex, qint64 frame) = 0;
+};
+
+#endif // DETECTIONSINK_H
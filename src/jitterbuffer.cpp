@@ -0,0 +1,245 @@
+#include <cstdlib>
+
+#include "jitterbuffer.h"
+
+///
+/// \brief Constructs an empty jitter buffer.
+/// \param sampleRate Sample rate of the RTP timestamps.
+/// \param minDelayMs Shortest time a gap is waited for.
+/// \param maxDelayMs Longest time a gap is waited for, a larger timestamp
+/// jump is taken as a restarted sender and not concealed.
+///
+JitterBuffer::JitterBuffer(qint32 sampleRate, int minDelayMs, int maxDelayMs)
+    : m_sampleRate(sampleRate)
+    , m_minDelayMs(minDelayMs)
+    , m_maxDelayMs(qMax(minDelayMs, maxDelayMs))
+    , m_concealment(Silence)
+    , m_frameLength(512)
+{
+    reset();
+}
+
+void JitterBuffer::setConcealment(Concealment concealment)
+{
+    m_concealment = concealment;
+}
+
+///
+/// \brief Sets the number of samples repeated by RepeatLast concealment.
+///
+void JitterBuffer::setFrameLength(int samples)
+{
+    m_frameLength = qMax(1, samples);
+}
+
+///
+/// \brief Drops all packets and counters.
+///
+void JitterBuffer::reset()
+{
+    restart();
+    m_counters = Counters();
+    m_counters.delayMs = m_minDelayMs;
+}
+
+///
+/// \brief Drops all packets and starts a new timeline, e.g. for a new sender.
+/// The counters are kept.
+///
+void JitterBuffer::restart()
+{
+    m_packets.clear();
+    m_started = false;
+    m_hasPacket = false;
+    m_lastTimestamp = 0;
+    m_lastSequence = 0;
+    m_highestSequence = 0;
+    m_releasedSequence = 0;
+    m_playout = 0;
+    m_lastArrivalMs = 0;
+    m_lastFrame.clear();
+}
+
+//
+// Internal extends a wrapping counter of bits width to 64 bit, relative to the last value.
+//
+qint64 JitterBuffer::unwrap(qint64 last, quint32 value, int bits)
+{
+    const qint64 range = qint64(1) << bits;
+    qint64 delta = (qint64(value) - last) % range;
+
+    if (delta < 0)
+        delta += range;
+
+    if (delta >= range / 2)
+        delta -= range;
+
+    return last + delta;
+}
+
+///
+/// \brief Adds a received packet.
+/// \param sequence RTP sequence number.
+/// \param timestamp RTP timestamp of the first sample.
+/// \param samples Decoded samples of the packet.
+/// \param count Number of samples.
+/// \param arrivalMs Arrival time on a monotonic clock.
+///
+void JitterBuffer::push(quint16 sequence, quint32 timestamp, const qint16* samples, int count, qint64 arrivalMs)
+{
+    if (count <= 0)
+        return;
+
+    ++m_counters.received;
+    const qint64 extTimestamp = m_hasPacket ? unwrap(m_lastTimestamp, timestamp, 32) : timestamp;
+    const qint64 extSequence = m_hasPacket ? unwrap(m_lastSequence, sequence, 16) : sequence;
+
+    if (m_hasPacket)
+    {
+        // RFC 3550 interarrival jitter, in ms
+        const qreal transit = (arrivalMs - m_lastArrivalMs) - (extTimestamp - m_lastTimestamp) * 1000.0 / m_sampleRate;
+        m_counters.jitterMs += (std::abs(transit) - m_counters.jitterMs) / 16;
+        m_counters.delayMs = qBound(m_minDelayMs, int(3 * m_counters.jitterMs + 0.5), m_maxDelayMs);
+
+        if (extSequence < m_highestSequence)
+            ++m_counters.reordered;
+    }
+
+    if (!m_hasPacket || extSequence > m_highestSequence)
+        m_highestSequence = extSequence;
+
+    m_hasPacket = true;
+    m_lastTimestamp = extTimestamp;
+    m_lastSequence = extSequence;
+    m_lastArrivalMs = arrivalMs;
+
+    if (m_started && (m_playout - extTimestamp) * 1000 > qint64(m_maxDelayMs) * m_sampleRate)
+    {
+        // Far behind the playout position, the sender restarted its timeline
+        ++m_counters.resyncs;
+        m_packets.clear();
+        m_started = false;
+    }
+
+    if (m_started && extTimestamp + count <= m_playout)
+    {
+        ++m_counters.late;
+        return;
+    }
+
+    if (m_packets.contains(extTimestamp))
+    {
+        ++m_counters.duplicates;
+        return;
+    }
+
+    Packet packet;
+    packet.sequence = extSequence;
+    packet.arrivalMs = arrivalMs;
+
+    // Samples already concealed are dropped, the rest is kept
+    const int skip = m_started && extTimestamp < m_playout ? int(m_playout - extTimestamp) : 0;
+    packet.samples = QVector<qint16>(samples + skip, samples + count);
+    m_packets.insert(extTimestamp + skip, packet);
+}
+
+///
+/// \brief Appends the samples due at nowMs to out.
+/// \return Number of samples appended.
+///
+int JitterBuffer::pull(qint64 nowMs, QVector<qint16>* out)
+{
+    const int before = out->size();
+
+    if (!m_started)
+    {
+        // Wait for packets reordered at the start of the stream
+        if (m_packets.isEmpty() || nowMs - m_packets.first().arrivalMs < m_counters.delayMs)
+            return 0;
+
+        m_started = true;
+        m_playout = m_packets.firstKey();
+        m_releasedSequence = m_packets.first().sequence - 1;
+    }
+
+    while (!m_packets.isEmpty())
+    {
+        auto first = m_packets.begin();
+        // Packets overlapping released samples only contribute the rest
+        const qint64 overlap = m_playout - first.key();
+
+        if (overlap >= first->samples.size())
+        {
+            m_packets.erase(first);
+            continue;
+        }
+
+        if (overlap > 0)
+        {
+            first->samples.remove(0, int(overlap));
+        }
+        else if (overlap < 0)
+        {
+            // A gap, wait for the missing packets up to the delay
+            if (nowMs - first->arrivalMs < m_counters.delayMs)
+                break;
+
+            const qint64 gap = first.key() - m_playout;
+
+            if (gap * 1000 > qint64(m_maxDelayMs) * m_sampleRate)
+                ++m_counters.resyncs;
+            else
+                conceal(gap, out);
+
+            m_counters.lost += qMax(qint64(0), first->sequence - m_releasedSequence - 1);
+            m_playout = first.key();
+        }
+
+        release(*first, out);
+        m_packets.erase(first);
+    }
+
+    return out->size() - before;
+}
+
+//
+// Internal fills a gap of samples with silence or the last frame.
+//
+void JitterBuffer::conceal(qint64 samples, QVector<qint16>* out)
+{
+    m_counters.concealedSamples += samples;
+
+    if (m_concealment == RepeatLast && !m_lastFrame.isEmpty())
+    {
+        for (qint64 i = 0; i < samples; ++i)
+            out->append(m_lastFrame.at(int(i % m_lastFrame.size())));
+    }
+    else
+    {
+        out->insert(out->size(), int(samples), 0);
+    }
+}
+
+//
+// Internal appends a packet at the playout position.
+//
+void JitterBuffer::release(const Packet& packet, QVector<qint16>* out)
+{
+    *out += packet.samples;
+    m_playout += packet.samples.size();
+    m_releasedSequence = qMax(m_releasedSequence, packet.sequence);
+
+    if (m_concealment == RepeatLast)
+    {
+        const int frame = qMin(m_frameLength, out->size());
+        m_lastFrame = out->mid(out->size() - frame);
+    }
+}
+
+///
+/// \brief Gets the packet counters and the current delay.
+///
+JitterBuffer::Counters JitterBuffer::counters() const
+{
+    return m_counters;
+}
@@ -0,0 +1,90 @@
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include <QMap>
+#include <QVector>
+
+///
+/// \brief Reorders timestamped audio packets and conceals lost ones.
+/// Packets are keyed on their RTP timestamp in samples, the sequence number
+/// detects reordering, duplicates and the number of lost packets. Packets in
+/// order are released immediately. A gap is waited for up to the current
+/// delay, then the missing samples are concealed with silence or by repeating
+/// the last released frame and the packets behind the gap are released.
+/// Packets arriving after their samples were released count as late.
+/// The delay adapts to the interarrival jitter estimate of RFC 3550, bounded
+/// by the minimum and maximum delay. Not thread-safe, push() and pull() are
+/// called on one thread.
+///
+class JitterBuffer
+{
+
+public:
+    enum Concealment
+    {
+        Silence,
+        RepeatLast
+    };
+
+    struct Counters
+    {
+        qint64  received = 0;
+        qint64  late = 0;
+        qint64  lost = 0;
+        qint64  reordered = 0;
+        qint64  duplicates = 0;
+        qint64  concealedSamples = 0;
+        qint64  resyncs = 0;
+        int     delayMs = 0;
+        qreal   jitterMs = 0;
+    };
+
+    explicit JitterBuffer(qint32 sampleRate, int minDelayMs = 20, int maxDelayMs = 200);
+
+    void setConcealment(Concealment concealment);
+
+    void setFrameLength(int samples);
+
+    void push(quint16 sequence, quint32 timestamp, const qint16* samples, int count, qint64 arrivalMs);
+
+    int pull(qint64 nowMs, QVector<qint16>* out);
+
+    Counters counters() const;
+
+    void restart();
+
+    void reset();
+
+private:
+    struct Packet
+    {
+        qint64          sequence;
+        qint64          arrivalMs;
+        QVector<qint16> samples;
+    };
+
+    static qint64 unwrap(qint64 last, quint32 value, int bits);
+
+    void conceal(qint64 samples, QVector<qint16>* out);
+
+    void release(const Packet& packet, QVector<qint16>* out);
+
+    qint32                  m_sampleRate;
+    int                     m_minDelayMs;
+    int                     m_maxDelayMs;
+    Concealment             m_concealment;
+    int                     m_frameLength;
+    QMap<qint64, Packet>    m_packets;
+    bool                    m_started;
+    bool                    m_hasPacket;
+    qint64                  m_lastTimestamp;
+    qint64                  m_lastSequence;
+    qint64                  m_highestSequence;
+    qint64                  m_releasedSequence;
+    qint64                  m_playout;
+    qint64                  m_lastArrivalMs;
+    QVector<qint16>         m_lastFrame;
+    Counters                m_counters;
+};
+
+#endif // JITTERBUFFER_H
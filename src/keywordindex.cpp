@@ -0,0 +1,325 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "keywordindex.h"
+
+static const quint32 IndexMagic = 0x4b57494e;
+static const qint32 IndexVersion = 2;
+static const QDataStream::Version StreamVersion = QDataStream::Qt_5_12;
+
+// Plausible size range of a keyword file, anything outside is rejected before
+// it can fail deep inside pv_porcupine_init
+static const qint64 MinKeywordFileSize = 256;
+static const qint64 MaxKeywordFileSize = 4 * 1024 * 1024;
+
+// Files per prefetch task, the tasks run in parallel on the global thread pool
+static const int PrefetchChunk = 8;
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+namespace
+{
+
+//
+// Issues the read-ahead hints of some files, open() may block on slow storage.
+//
+class PrefetchTask : public QRunnable
+{
+
+public:
+    explicit PrefetchTask(const QVector<QString>& files)
+        : m_files(files)
+    {
+    }
+
+    void run() override
+    {
+        for (const auto& path : m_files)
+        {
+            const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+
+            if (fd < 0)
+                continue;
+
+#if defined(Q_OS_LINUX)
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#else
+            struct radvisory advice;
+            advice.ra_offset = 0;
+            advice.ra_count = int(QFileInfo(path).size());
+            ::fcntl(fd, F_RDADVISE, &advice);
+#endif
+            ::close(fd);
+        }
+    }
+
+private:
+    const QVector<QString> m_files;
+};
+
+}
+#endif
+
+KeywordIndex::KeywordIndex(const QString& indexFile)
+    : m_indexFile(indexFile)
+    , m_dirty(false)
+    , m_hits(0)
+    , m_misses(0)
+{
+    load();
+}
+
+///
+/// \brief Gets the default location of the index in the cache directory.
+/// \return Absolute path of the index file.
+///
+QString KeywordIndex::defaultIndexFile()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/keywords.idx";
+}
+
+///
+/// \brief Lists the valid keyword files of a directory.
+/// The directory is listed every time, the listing is cheap compared to
+/// reading the files: a coarse directory mtime (FAT, some network mounts)
+/// does not change for an add or remove within the same tick. Files are only
+/// read and checked if their size or modification time changed.
+/// \param keywordsDir Directory containing *.ppn keyword files.
+/// \param rejected If not null, outputs the files failing the sanity check.
+/// \return Native paths of all valid keyword files.
+///
+QVector<QString> KeywordIndex::scan(const QString& keywordsDir, QVector<QString>* rejected)
+{
+    QVector<QString> files;
+    const QFileInfo dirInfo(keywordsDir);
+
+    if (keywordsDir.isEmpty() || !dirInfo.isDir())
+        return files;
+
+    const qint64 dirMtime = dirInfo.lastModified().toMSecsSinceEpoch();
+    const QDir directory(keywordsDir);
+    QVector<QString> listed;
+
+    for (const auto& name : directory.entryList({"*.ppn"}, QDir::Files, QDir::Name))
+        listed.append(QDir::toNativeSeparators(directory.filePath(name)));
+
+    Directory& dir = m_directories[keywordsDir];
+
+    if (dir.mtime != dirMtime || dir.files != listed)
+    {
+        dir.files = listed;
+        dir.mtime = dirMtime;
+        m_dirty = true;
+        pruneEntries();
+    }
+
+    for (const auto& file : dir.files)
+    {
+        const QFileInfo fi(file);
+        const qint64 size = fi.size();
+        const qint64 mtime = fi.lastModified().toMSecsSinceEpoch();
+        auto it = m_entries.find(file);
+
+        if (it != m_entries.end() && it->size == size && it->mtime == mtime)
+        {
+            ++m_hits;
+        }
+        else
+        {
+            ++m_misses;
+            it = m_entries.insert(file, inspect(file, size, mtime));
+            m_dirty = true;
+        }
+
+        if (it->valid)
+            files.append(file);
+        else if (rejected != nullptr)
+            rejected->append(file);
+    }
+
+    return files;
+}
+
+///
+/// \brief Gets the indexed information of a keyword file.
+/// \param path Native path of the keyword file.
+/// \return The entry, an invalid default entry if the file is not indexed.
+///
+KeywordIndex::Entry KeywordIndex::entry(const QString& path) const
+{
+    return m_entries.value(path);
+}
+
+///
+/// \brief Writes the index to disk if it changed.
+/// \return true on success or if there was nothing to write.
+///
+bool KeywordIndex::save()
+{
+    if (!m_dirty)
+        return true;
+
+    QDir().mkpath(QFileInfo(m_indexFile).absolutePath());
+    QSaveFile file(m_indexFile);
+
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out << IndexMagic << IndexVersion;
+    out.setVersion(StreamVersion);
+    out << qint32(m_directories.size());
+
+    for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it)
+        out << it.key() << it->mtime << it->files;
+
+    out << qint32(m_entries.size());
+
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        out << it.key() << it->size << it->mtime << it->hash << it->valid;
+
+    m_dirty = !file.commit();
+    return !m_dirty;
+}
+
+///
+/// \brief Gets the number of files answered from the index since construction.
+///
+int KeywordIndex::hits() const
+{
+    return m_hits;
+}
+
+///
+/// \brief Gets the number of files that had to be read and checked since construction.
+///
+int KeywordIndex::misses() const
+{
+    return m_misses;
+}
+
+///
+/// \brief Asks the operating system to read files into the page cache.
+/// Returns at once, the hints are issued in parallel on the global thread
+/// pool, a task per few files, because open() may block on a slow file
+/// system. The reads themselves run in the background and overlap with
+/// library loading and model initialization.
+/// \param files Paths of the files to prefetch.
+///
+void KeywordIndex::prefetch(const QVector<QString>& files)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+    for (int i = 0; i < files.size(); i += PrefetchChunk)
+        QThreadPool::globalInstance()->start(new PrefetchTask(files.mid(i, PrefetchChunk)));
+#else
+    Q_UNUSED(files)
+#endif
+}
+
+void KeywordIndex::load()
+{
+    QFile file(m_indexFile);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 version = 0;
+    qint32 count = 0;
+    in >> magic >> version;
+
+    if (magic != IndexMagic || version != IndexVersion)
+        return;
+
+    in.setVersion(StreamVersion);
+
+    in >> count;
+
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Directory dir;
+        in >> path >> dir.mtime >> dir.files;
+        m_directories.insert(path, dir);
+    }
+
+    in >> count;
+
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString path;
+        Entry entry;
+        in >> path >> entry.size >> entry.mtime >> entry.hash >> entry.valid;
+        m_entries.insert(path, entry);
+    }
+
+    if (in.status() != QDataStream::Ok)
+    {
+        // Corrupt index, start over
+        m_directories.clear();
+        m_entries.clear();
+    }
+}
+
+//
+// Internal removes the entries of files no longer listed in any directory.
+//
+void KeywordIndex::pruneEntries()
+{
+    QSet<QString> listed;
+
+    for (auto it = m_directories.cbegin(); it != m_directories.cend(); ++it)
+    {
+        for (const auto& file : it->files)
+            listed.insert(file);
+    }
+
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (listed.contains(it.key()))
+            ++it;
+        else
+            it = m_entries.erase(it);
+    }
+}
+
+//
+// Internal reads a keyword file once, hashes it and checks its plausibility.
+//
+KeywordIndex::Entry KeywordIndex::inspect(const QString& path, qint64 size, qint64 mtime)
+{
+    Entry entry;
+    entry.size = size;
+    entry.mtime = mtime;
+
+    if (size < MinKeywordFileSize || size > MaxKeywordFileSize)
+        return entry;
+
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return entry;
+
+    const QByteArray content = file.readAll();
+
+    if (content.size() != size || content.count('\0') == content.size())
+        return entry;
+
+    entry.hash = QCryptographicHash::hash(content, QCryptographicHash::Sha1);
+    entry.valid = true;
+    return entry;
+}
@@ -0,0 +1,63 @@
+#ifndef KEYWORDINDEX_H
+#define KEYWORDINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+///
+/// \brief Persistent index of keyword files.
+/// Keeps path, size, modification time, content hash and the result of a
+/// sanity check for every keyword file. Entries are reused across runs as
+/// long as size and modification time are unchanged, entries of files
+/// removed from their directory are dropped.
+///
+class KeywordIndex
+{
+
+public:
+    struct Entry
+    {
+        qint64      size = -1;
+        qint64      mtime = -1;
+        QByteArray  hash;
+        bool        valid = false;
+    };
+
+    explicit KeywordIndex(const QString& indexFile = defaultIndexFile());
+
+    static QString defaultIndexFile();
+
+    QVector<QString> scan(const QString& keywordsDir, QVector<QString>* rejected = nullptr);
+
+    Entry entry(const QString& path) const;
+
+    bool save();
+
+    int hits() const;
+
+    int misses() const;
+
+    static void prefetch(const QVector<QString>& files);
+
+private:
+    struct Directory
+    {
+        qint64              mtime = -1;
+        QVector<QString>    files;
+    };
+
+    void load();
+    void pruneEntries();
+    static Entry inspect(const QString& path, qint64 size, qint64 mtime);
+
+    QString                     m_indexFile;
+    QHash<QString, Entry>       m_entries;
+    QHash<QString, Directory>   m_directories;
+    bool                        m_dirty;
+    int                         m_hits;
+    int                         m_misses;
+};
+
+#endif // KEYWORDINDEX_H
@@ -0,0 +1,146 @@
+#include <QHash>
+
+#include "keywordsmodel.h"
+
+KeywordsModel::KeywordsModel(QObject* parent)
+    : QStringListModel(parent)
+{
+    // New rows start active, the flags follow every structural change of the list
+    QObject::connect(this, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex&, int first, int last)
+    {
+        m_active.insert(first, last - first + 1, true);
+
+        for (int row = first; row <= last; ++row)
+            m_keys.insert(row, QString());
+    });
+    QObject::connect(this, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex&, int first, int last)
+    {
+        m_active.remove(first, last - first + 1);
+        m_keys.erase(m_keys.begin() + first, m_keys.begin() + last + 1);
+    });
+    QObject::connect(this, &QAbstractItemModel::modelReset, this, [this]()
+    {
+        m_active = QVector<bool>(rowCount(), true);
+        m_keys = QStringList();
+
+        for (int row = 0; row < rowCount(); ++row)
+            m_keys.append(QString());
+    });
+}
+
+QVariant KeywordsModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_active.size())
+        return QVariant();
+
+    if (role == ActiveRole)
+        return m_active.at(index.row());
+
+    if (role == Qt::CheckStateRole)
+        return m_active.at(index.row()) ? Qt::Checked : Qt::Unchecked;
+
+    return QStringListModel::data(index, role);
+}
+
+bool KeywordsModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+    if (!index.isValid() || index.row() >= m_active.size())
+        return false;
+
+    if (role == ActiveRole || role == Qt::CheckStateRole)
+    {
+        const bool active = role == ActiveRole ? value.toBool() : value.toInt() == Qt::Checked;
+        setActive(index.row(), active);
+        return true;
+    }
+
+    return QStringListModel::setData(index, value, role);
+}
+
+Qt::ItemFlags KeywordsModel::flags(const QModelIndex& index) const
+{
+    return QStringListModel::flags(index) | Qt::ItemIsUserCheckable;
+}
+
+QHash<int, QByteArray> KeywordsModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QStringListModel::roleNames();
+    roles.insert(ActiveRole, "active");
+    return roles;
+}
+
+///
+/// \brief Replaces the keyword list, keywords already present keep their activation.
+/// \param keywords The new keyword names.
+/// \param keys Keys of the keywords, e.g. their files. Without keys the
+/// names are the keys.
+///
+void KeywordsModel::setKeywords(const QStringList& keywords, const QStringList& keys)
+{
+    QHash<QString, bool> previous;
+
+    for (int row = 0; row < m_keys.size(); ++row)
+        previous.insert(m_keys.at(row), m_active.at(row));
+
+    const QStringList newKeys = keys.size() == keywords.size() ? keys : keywords;
+    setStringList(keywords);
+    m_keys = newKeys;
+
+    for (int row = 0; row < keywords.size(); ++row)
+        m_active[row] = previous.value(m_keys.at(row), true);
+
+    if (!keywords.isEmpty())
+        emit dataChanged(index(0), index(keywords.size() - 1), {ActiveRole, Qt::CheckStateRole});
+}
+
+///
+/// \brief Sets the key of a row inserted without one.
+/// \param row Row of the keyword.
+/// \param key Key identifying the keyword, e.g. its file.
+///
+void KeywordsModel::setKey(int row, const QString& key)
+{
+    if (row >= 0 && row < m_keys.size())
+        m_keys[row] = key;
+}
+
+///
+/// \brief Gets the activation of a keyword.
+/// \param row Row of the keyword.
+/// \return True if the keyword is active.
+///
+bool KeywordsModel::isActive(int row) const
+{
+    return m_active.value(row, false);
+}
+
+///
+/// \brief Activates or deactivates a keyword.
+/// \param row Row of the keyword.
+/// \param active True to activate.
+///
+void KeywordsModel::setActive(int row, bool active)
+{
+    if (row < 0 || row >= m_active.size() || m_active.at(row) == active)
+        return;
+
+    m_active[row] = active;
+    emit dataChanged(index(row), index(row), {ActiveRole, Qt::CheckStateRole});
+    emit activeChanged();
+}
+
+///
+/// \brief Gets the rows of all active keywords in ascending order.
+///
+QVector<int> KeywordsModel::activeRows() const
+{
+    QVector<int> rows;
+
+    for (int row = 0; row < m_active.size(); ++row)
+    {
+        if (m_active.at(row))
+            rows.append(row);
+    }
+
+    return rows;
+}
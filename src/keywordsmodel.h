@@ -0,0 +1,47 @@
+#ifndef KEYWORDSMODEL_H
+#define KEYWORDSMODEL_H
+
+#include <QStringListModel>
+#include <QVector>
+
+///
+/// \brief List of keyword names with a per-keyword activation flag.
+/// The flag is exposed as role "active" and as Qt::CheckStateRole. Each row
+/// has a key, e.g. the keyword file, that identifies it when the list is
+/// replaced; names need not be unique.
+///
+class KeywordsModel : public QStringListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles
+    {
+        ActiveRole = Qt::UserRole + 1
+    };
+
+    explicit KeywordsModel(QObject* parent = nullptr);
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    void setKeywords(const QStringList& keywords, const QStringList& keys = QStringList());
+
+    void setKey(int row, const QString& key);
+
+    bool isActive(int row) const;
+    void setActive(int row, bool active);
+
+    QVector<int> activeRows() const;
+
+signals:
+    void activeChanged();
+
+private:
+    QVector<bool>   m_active;
+    QStringList     m_keys;
+};
+
+#endif // KEYWORDSMODEL_H
@@ -0,0 +1,157 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+///
+/// \brief Bounded lock-free queue of many producers and one consumer.
+/// The cells are allocated once at construction and carry sequence numbers,
+/// so push() and pop() never block and never allocate. A push() at the limit
+/// fails and is counted as dropped. The store publishing a value and the
+/// consumer's check for one are sequentially consistent: a producer that
+/// raises a wake-up flag after push() and a consumer that clears it before
+/// checking pending() again cannot both miss the value.
+///
+template <typename T>
+class MpscRing
+{
+
+public:
+    ///
+    /// \param limit Maximum number of queued values, the ring is sized to
+    /// the next power of two.
+    ///
+    explicit MpscRing(int limit)
+        : m_limit(quint64(qMax(1, limit)))
+        , m_mask(ringSize(m_limit) - 1)
+        , m_cells(new Cell[m_mask + 1])
+        , m_tail(0)
+        , m_head(0)
+        , m_dropped(0)
+    {
+        for (quint64 i = 0; i <= m_mask; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    ///
+    /// \brief Queues a copy of value, from any thread.
+    /// \return false if the queue is at its limit, the value is dropped.
+    ///
+    bool push(const T& value)
+    {
+        quint64 pos = m_tail.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        for (;;)
+        {
+            // The limit may be below the ring size
+            const quint64 head = m_head.load(std::memory_order_acquire);
+
+            if (pos >= head && pos - head >= m_limit)
+                return drop();
+
+            cell = &m_cells[pos & m_mask];
+            const qint64 diff = qint64(cell->sequence.load(std::memory_order_acquire)) - qint64(pos);
+
+            if (diff == 0 && m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+
+            if (diff < 0)
+                return drop();
+
+            if (diff > 0)
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    ///
+    /// \brief Takes the oldest value, only on the consumer thread.
+    /// \return false if nothing is queued.
+    ///
+    bool pop(T* value)
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        Cell& cell = m_cells[head & m_mask];
+
+        if (cell.sequence.load(std::memory_order_seq_cst) != head + 1)
+            return false;
+
+        *value = std::move(cell.value);
+        cell.sequence.store(head + m_mask + 1, std::memory_order_release);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    ///
+    /// \brief Gets whether pop() would succeed, only on the consumer thread.
+    ///
+    bool pending() const
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        return m_cells[head & m_mask].sequence.load(std::memory_order_seq_cst) == head + 1;
+    }
+
+    ///
+    /// \brief Gets the number of values queued and not yet taken, from any thread.
+    ///
+    qint64 size() const
+    {
+        const quint64 head = m_head.load(std::memory_order_relaxed);
+        const quint64 tail = m_tail.load(std::memory_order_relaxed);
+        return tail > head ? qint64(tail - head) : 0;
+    }
+
+    int limit() const
+    {
+        return int(m_limit);
+    }
+
+    ///
+    /// \brief Gets the number of values dropped at the limit.
+    ///
+    qint64 dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<quint64>    sequence;
+        T                       value;
+    };
+
+    static quint64 ringSize(quint64 limit)
+    {
+        quint64 size = 2;
+
+        while (size < limit)
+            size <<= 1;
+
+        return size;
+    }
+
+    bool drop()
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const quint64               m_limit;
+    const quint64               m_mask;
+    std::unique_ptr<Cell[]>     m_cells;
+    std::atomic<quint64>        m_tail;
+    std::atomic<quint64>        m_head;
+    std::atomic<qint64>         m_dropped;
+};
+
+#endif // MPSCRING_H
@@ -1,33 +1,46 @@
 #include <QLibrary>
 #include <QFileInfo>
 #include <QIODevice>
+#include <cstring>
 
 #include "porcupine_fn.hpp"
+#include "porcupinelog.h"
+#include "porcupinestartup.h"
+#include "porcupinetrace.h"
 #include "porcupine.h"
 
 ///
 /// \brief Porcupine Wake Word Qt API
 ///
-Porcupine::Porcupine(void* pvInstance, QLibrary* pvLib)
+Porcupine::Porcupine(void* pvInstance, QLibrary* pvLib, PV::Api* pvApi)
     : m_pvInstance(pvInstance)
     , m_pvLib(pvLib)
+    , m_pvApi(pvApi)
+    , m_bufferedBytes(0)
     , m_pvEnabled(false)
+    , m_framesProcessed(0)
     , m_pvBytesFrameSize(bytesFrameLength())
+    , m_bufferCapacity(0)
 {
+    // Preallocate, so the steady state of process() never touches the heap
+    reserveBuffer(16 * m_pvBytesFrameSize);
+    // Starts the log writer thread here rather than at the first detection
+    PorcupineLog::instance();
 }
 
 Porcupine::~Porcupine()
 {
     if (m_pvInstance != nullptr)
-        PV::pv_porcupine_delete_func(static_cast<pv_porcupine_t*>(m_pvInstance));
+        m_pvApi->pv_porcupine_delete_func(static_cast<pv_porcupine_t*>(m_pvInstance));
 
+    delete m_pvApi;
     delete m_pvLib;
 }
 
 static Porcupine* errPorcupino(const QString& message,
                                QString* errMsg = nullptr)
 {
-    qCritical("%s", qPrintable(message));
+    PorcupineLog::instance().post(PorcupineLog::Critical, message);
 
     if (errMsg != nullptr)
         *errMsg = message;
@@ -54,29 +67,45 @@ static Porcupine* errPorcupino(const QString& message,
 /// A higher sensitivity value lowers miss rate at the cost of increased
 /// false alarm rate. A sensitivity value should be within [0, 1].
 /// \param errMsg optional output of error messages.
+/// \param libraryPath optional path of the runtime library, by default the
+/// library next to the application. Instances may use different libraries.
 /// \return A Porcupine instance pointer on success or a nullptr on error.
 ///
 Porcupine* Porcupine::create(const QString& accessKey,
                              const QVector<QString>& keywordPaths,
                              const QString& modelPath,
                              const QVector<qreal>& sensitivities,
-                             QString* errMsg)
+                             QString* errMsg,
+                             const QString& libraryPath)
 {
+    PV_TRACE_SCOPE("Porcupine::create");
+    const PorcupineMemory::Usage memoryBefore = PorcupineMemory::enabled() ? PorcupineMemory::sample()
+                                                                           : PorcupineMemory::Usage();
     QString message;
+    PV::Api pvApi;
     //
     // 1. Initialize porcubine library
     //
-    QString pvLibPath = PV::pvGetLibpath();
+    QString pvLibPath = libraryPath.isEmpty() ? PV::pvGetLibpath() : libraryPath;
     QFileInfo fi(pvLibPath);
 
     if (!QLibrary::isLibrary(pvLibPath) || !fi.exists())
         return errPorcupino("Failed running Porcubine, no accessible runtime library.", errMsg);
 
     QLibrary* pvLib = new QLibrary(pvLibPath);
+    // Loaded ahead of porcupine_fn_init() to time loading and resolving apart
+    const qint64 loadStartNs = PorcupineTrace::now();
+    const bool loaded = pvLib->load();
+    const qint64 resolveStartNs = PorcupineTrace::now();
 
-    if (!PV::porcupine_fn_init(pvLib, &message))
+    if (!PV::porcupine_fn_init(pvLib, &pvApi, &message))
         return errPorcupino(message, pvLib, errMsg);
 
+    if (loaded)
+        PorcupineStartup::record(PorcupineStartup::LibraryLoad, loadStartNs, resolveStartNs - loadStartNs);
+
+    PorcupineStartup::record(PorcupineStartup::SymbolResolve, resolveStartNs, PorcupineTrace::now() - resolveStartNs);
+
     //
     // 2. Initialize wake word detection
     //
@@ -117,28 +146,46 @@ Porcupine* Porcupine::create(const QString& accessKey,
             pv_sensitivities.push_back(static_cast<float>(sensitive));
 
     pv_porcupine_t* porcupine = NULL;
-    pv_status_t porcupine_status = PV::pv_porcupine_init_func(
+    const qint64 initStartNs = PorcupineTrace::now();
+    pv_status_t porcupine_status = pvApi.pv_porcupine_init_func(
                                        accessKey.toUtf8().constData(),
                                        modelPath.toUtf8().constData(),
                                        (int32_t) pvKeywordPaths.size(),
                                        pvKeywordPaths.data(),
                                        pv_sensitivities.data(),
                                        &porcupine);
+
+    const qint64 initNs = PorcupineTrace::now() - initStartNs;
+
+    if (PorcupineTrace::enabled())
+        PorcupineTrace::instance().complete("pv_porcupine_init", initStartNs, initNs, keywordPaths.size());
+
     bool success = porcupine_status == PV_STATUS_SUCCESS;
+
+    if (success)
+        PorcupineStartup::record(PorcupineStartup::EngineInit, initStartNs, initNs);
+
     void* pvInstance = nullptr;
 
     if (success)
     {
         pvInstance = (void*) porcupine;
-        qInfo("Wake word engine Porcubine V%s successfull initialized.", PV::pv_porcupine_version_func());
+        PorcupineLog::instance().post(PorcupineLog::Info,
+                                      QString("Wake word engine Porcubine V%1 successfull initialized.")
+                                      .arg(pvApi.pv_porcupine_version_func()));
     }
     else
-        return errPorcupino(PV::getMessageDetail("porcupine_init", porcupine_status), pvLib, errMsg);
+        return errPorcupino(PV::getMessageDetail(pvApi, "porcupine_init", porcupine_status), pvLib, errMsg);
 
     //
     // 3. Initialize Porcubine class
     //
-    return new Porcupine(pvInstance, pvLib);
+    Porcupine* instance = new Porcupine(pvInstance, pvLib, new PV::Api(pvApi));
+
+    if (memoryBefore.isValid())
+        instance->m_memory = PorcupineMemory::sample() - memoryBefore;
+
+    return instance;
 }
 
 
@@ -148,7 +195,7 @@ Porcupine* Porcupine::create(const QString& accessKey,
 ///
 QString Porcupine::version() const
 {
-    return QString(PV::pv_porcupine_version_func());
+    return QString(m_pvApi->pv_porcupine_version_func());
 }
 
 ///
@@ -157,7 +204,7 @@ QString Porcupine::version() const
 ///
 qint32 Porcupine::frameLength() const
 {
-    return PV::pv_porcupine_frame_length_func();
+    return m_pvApi->pv_porcupine_frame_length_func();
 }
 
 ///
@@ -166,7 +213,7 @@ qint32 Porcupine::frameLength() const
 ///
 qint32 Porcupine::bytesFrameLength() const
 {
-    return 2 * PV::pv_porcupine_frame_length_func();
+    return 2 * m_pvApi->pv_porcupine_frame_length_func();
 }
 
 ///
@@ -175,7 +222,7 @@ qint32 Porcupine::bytesFrameLength() const
 ///
 qint32 Porcupine::sampleRate() const
 {
-    return PV::pv_sample_rate_func();
+    return m_pvApi->pv_sample_rate_func();
 }
 
 //
@@ -183,21 +230,28 @@ qint32 Porcupine::sampleRate() const
 //
 bool Porcupine::processFrame(const int16_t* pcm, qint32* keywordIndex, QString* errMsg)
 {
-    pv_status_t porcupine_status = PV::pv_porcupine_process_func(
+    PV_TRACE_SCOPE("pv_porcupine_process");
+    PorcupinePerf::Sample perfSample;
+    const bool profiled = PorcupinePerf::enabled() && PorcupinePerf::begin(&perfSample);
+    pv_status_t porcupine_status = m_pvApi->pv_porcupine_process_func(
                                        static_cast<pv_porcupine_t*>(m_pvInstance),
                                        pcm,
                                        keywordIndex);
+
+    if (profiled)
+        PorcupinePerf::end(perfSample, &m_perf);
     bool success = porcupine_status == PV_STATUS_SUCCESS;
 
     if (success)
     {
+        // Only a fixed-size record is queued, formatting happens on the log thread
         if (*keywordIndex >= 0)
-            qInfo("Porcupine detected keyword, index = %d.", *keywordIndex);
+            PorcupineLog::instance().post(PorcupineLog::Info, PorcupineLog::KeywordDetected, *keywordIndex);
     }
     else
     {
-        QString message = PV::getMessageDetail("Processing porcubine audiodata", porcupine_status);
-        qCritical("%s", qPrintable(message));
+        QString message = PV::getMessageDetail(*m_pvApi, "Processing porcubine audiodata", porcupine_status);
+        PorcupineLog::instance().post(PorcupineLog::Critical, message);
 
         if (errMsg != nullptr)
             *errMsg = message;
@@ -217,42 +271,178 @@ bool Porcupine::processFrame(const int16_t* pcm, qint32* keywordIndex, QString*
 ///
 bool Porcupine::process(int& keywordIndex, const char* audioData, const int len, QString* errMsg)
 {
+    PV_TRACE_SCOPE("Porcupine::process", len);
     bool success = true;
     keywordIndex = -1;
+    m_framesProcessed = 0;
+
+    if (!m_pvEnabled)
+        return success;
+
+    const char* data = audioData;
+    int size = len;
+    int bytesProcessed = 0;
 
-    if (m_pvEnabled)
+    // A pending partial frame, e.g. taken over from a replaced engine, is
+    // completed from audioData first, so the rest takes the direct path again
+    if (m_bufferedBytes > 0)
     {
-        m_audioBuffer.append(audioData, len);
+        const int missing = (m_pvBytesFrameSize - m_bufferedBytes % m_pvBytesFrameSize) % m_pvBytesFrameSize;
+        const int fill = qMin(size, missing);
+        appendBuffer(data, fill);
+        data += fill;
+        size -= fill;
+        const int processed = processFrames(m_audioBuffer.constData(), m_bufferedBytes, keywordIndex, success, errMsg);
+        compactBuffer(processed);
+        bytesProcessed += processed;
+    }
 
-        if (m_audioBuffer.size() >= m_pvBytesFrameSize)
+    if (size > 0)
+    {
+        if (!success || keywordIndex >= 0)
         {
-            int bytesProcessed = 0;
-            const char* ptr = m_audioBuffer.constData();
-            const char* const end = ptr + m_audioBuffer.size() - m_pvBytesFrameSize + 1;
+            // Stopped early, the rest waits behind the unprocessed audio
+            appendBuffer(data, size);
+        }
+        else if (reinterpret_cast<quintptr>(data) % alignof(int16_t) == 0)
+        {
+            // Whole frames are read straight from audioData, only the
+            // unprocessed tail is copied into the audio buffer
+            const int processed = processFrames(data, size, keywordIndex, success, errMsg);
+            appendBuffer(data + processed, size - processed);
+            bytesProcessed += processed;
+        }
+        else
+        {
+            appendBuffer(data, size);
+            const int processed = processFrames(m_audioBuffer.constData(), m_bufferedBytes, keywordIndex, success, errMsg);
+            compactBuffer(processed);
+            bytesProcessed += processed;
+        }
+    }
 
-            while (ptr < end)
-            {
-                const int16_t* pcm = reinterpret_cast<const int16_t*>(ptr);
-                int32_t keyword_index = -1;
+    m_framesProcessed = bytesProcessed / m_pvBytesFrameSize;
+    return success;
+}
 
-                if ((success = processFrame(pcm, &keyword_index, errMsg)) && keyword_index >= 0)
-                    keywordIndex = keyword_index;
+//
+// Internal runs the whole frames of data through the engine until a keyword
+// is found or on error. Returns the number of bytes handed to the engine.
+//
+int Porcupine::processFrames(const char* data, int size, int& keywordIndex, bool& success, QString* errMsg)
+{
+    int bytesProcessed = 0;
 
-                bytesProcessed += m_pvBytesFrameSize;
+    while (size - bytesProcessed >= m_pvBytesFrameSize)
+    {
+        const int16_t* pcm = reinterpret_cast<const int16_t*>(data + bytesProcessed);
+        int32_t keyword_index = -1;
 
-                // Break loop if a keyword is found or on error
-                if (keyword_index >= 0 || !success)
-                    break;
+        if ((success = processFrame(pcm, &keyword_index, errMsg)) && keyword_index >= 0)
+            keywordIndex = keyword_index;
 
-                ptr += m_pvBytesFrameSize;
-            }
+        bytesProcessed += m_pvBytesFrameSize;
 
-            // Remove processed audio data
-            m_audioBuffer.remove(0, bytesProcessed);
-        }
+        // Break loop if a keyword is found or on error
+        if (keyword_index >= 0 || !success)
+            break;
     }
 
-    return success;
+    return bytesProcessed;
+}
+
+//
+// Internal appends bytes of data behind the unprocessed audio.
+//
+void Porcupine::appendBuffer(const char* data, int bytes)
+{
+    if (bytes <= 0)
+        return;
+
+    PV_TRACE_SCOPE("buffer.append", bytes);
+    reserveBuffer(m_bufferedBytes + bytes);
+    std::memcpy(m_audioBuffer.data() + m_bufferedBytes, data, bytes);
+    m_bufferedBytes += bytes;
+}
+
+//
+// Internal moves unprocessed audio data to the front, the capacity is kept.
+//
+void Porcupine::compactBuffer(int bytesProcessed)
+{
+    if (bytesProcessed <= 0)
+        return;
+
+    PV_TRACE_SCOPE("buffer.compact", m_bufferedBytes - bytesProcessed);
+    char* const buffer = m_audioBuffer.data();
+    m_bufferedBytes -= bytesProcessed;
+    std::memmove(buffer, buffer + bytesProcessed, m_bufferedBytes);
+}
+
+//
+// Internal grows the audio buffer to at least bytes. Called with the final size
+// during warm-up, it only allocates again for packets larger than seen before.
+//
+void Porcupine::reserveBuffer(int bytes)
+{
+    if (m_audioBuffer.size() < bytes)
+    {
+        m_audioBuffer.resize(qMax(bytes, 2 * m_audioBuffer.size()));
+        m_bufferCapacity.store(m_audioBuffer.size(), std::memory_order_relaxed);
+    }
+}
+
+///
+/// \brief Gets the number of frames handed to the engine by the last call of process().
+/// \return Number of processed frames.
+///
+int Porcupine::framesProcessed() const
+{
+    return m_framesProcessed;
+}
+
+///
+/// \brief Gets the hardware counters of this engine accumulated while profiling.
+/// \return Counters over all profiled frames, see PorcupinePerf.
+///
+PorcupinePerf::Counters Porcupine::perfCounters() const
+{
+    return m_perf.snapshot();
+}
+
+///
+/// \brief Gets the memory the process grew by while this instance was created.
+/// The delta covers the runtime library, the model and keyword data and the
+/// audio buffer. It is only meaningful if no other engine was created at the
+/// same time. Pages of a library already loaded by another instance are not
+/// counted again.
+/// \return The usage delta, invalid unless PorcupineMemory was enabled when
+/// the instance was created.
+///
+PorcupineMemory::Usage Porcupine::memoryFootprint() const
+{
+    return m_memory;
+}
+
+///
+/// \brief Gets the allocated size of the audio buffer of this stream.
+/// May be called from any thread.
+///
+int Porcupine::bufferBytes() const
+{
+    return m_bufferCapacity.load(std::memory_order_relaxed);
+}
+
+///
+/// \brief Takes over the not yet processed audio data of another instance.
+/// Used when an engine is replaced at a frame boundary, so no samples are lost.
+/// \param other The instance to be replaced.
+///
+void Porcupine::takeOverAudio(const Porcupine& other)
+{
+    reserveBuffer(m_bufferedBytes + other.m_bufferedBytes);
+    std::memcpy(m_audioBuffer.data() + m_bufferedBytes, other.m_audioBuffer.constData(), other.m_bufferedBytes);
+    m_bufferedBytes += other.m_bufferedBytes;
 }
 
 ///
@@ -263,7 +453,7 @@ void  Porcupine::enable(bool enable)
 {
     if (m_pvEnabled != enable)
     {
-        m_audioBuffer.clear();
+        m_bufferedBytes = 0;
         m_pvEnabled = enable;
     }
 }
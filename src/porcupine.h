@@ -4,10 +4,19 @@
 #include <QByteArray>
 #include <QString>
 #include <QVector>
+#include <atomic>
+
+#include "porcupinememory.h"
+#include "porcupineperf.h"
 
 class QLibrary;
 class QIODevice;
 
+namespace PV
+{
+struct Api;
+}
+
 class Porcupine
 {
 
@@ -16,7 +25,8 @@ public:
                              const QVector<QString>& keywordPaths,
                              const QString& modelPath,
                              const QVector<qreal>& sensitivities,
-                             QString* errMsg = nullptr);
+                             QString* errMsg = nullptr,
+                             const QString& libraryPath = QString());
 
     ~Porcupine();
 
@@ -32,16 +42,40 @@ public:
 
     void enable(bool enable);
 
+    int framesProcessed() const;
+
+    void takeOverAudio(const Porcupine& other);
+
+    PorcupinePerf::Counters perfCounters() const;
+
+    PorcupineMemory::Usage memoryFootprint() const;
+
+    int bufferBytes() const;
+
 private:
-    explicit Porcupine(void* pvInstance, QLibrary* pvLib);
+    explicit Porcupine(void* pvInstance, QLibrary* pvLib, PV::Api* pvApi);
 
     bool processFrame(const int16_t* pcm, qint32* keywordIndex, QString* errMsg = nullptr);
 
+    int processFrames(const char* data, int size, int& keywordIndex, bool& success, QString* errMsg);
+
+    void appendBuffer(const char* data, int bytes);
+
+    void compactBuffer(int bytesProcessed);
+
+    void reserveBuffer(int bytes);
+
     void*               m_pvInstance;
     QLibrary*           m_pvLib;
+    PV::Api*            m_pvApi;
     QByteArray          m_audioBuffer;
+    int                 m_bufferedBytes;
     bool                m_pvEnabled;
+    int                 m_framesProcessed;
     const int           m_pvBytesFrameSize;
+    PorcupinePerf::Accumulator m_perf;
+    PorcupineMemory::Usage m_memory;
+    std::atomic<int>    m_bufferCapacity;
 };
 
 #endif // PORCUPINE_H
@@ -22,6 +22,10 @@ QString pvLibName = QStringLiteral("libpv_porcupine.dll");
 QString pvLibName = QStringLiteral("libpv_porcupine.dylib");
 #endif
 
+#if defined(__linux__)
+QString pvLibName = QStringLiteral("libpv_porcupine.so");
+#endif
+
 typedef const char* (*pv_status_to_string_t)(pv_status_t);
 typedef int32_t (*pv_sample_rate_t)();
 typedef pv_status_t (*pv_porcupine_init_t)(const char*, const char*, int32_t, const char* const*, const float*, pv_porcupine_t**);
@@ -32,15 +36,23 @@ typedef const char* (*pv_porcupine_version_t)();
 typedef pv_status_t (*pv_get_error_stack_t)(char***, int32_t*);
 typedef void (*pv_free_error_stack_t)(char**);
 
-pv_status_to_string_t pv_status_to_string_func;
-pv_sample_rate_t pv_sample_rate_func;
-pv_porcupine_init_t pv_porcupine_init_func;
-pv_porcupine_delete_t pv_porcupine_delete_func;
-pv_porcupine_process_t  pv_porcupine_process_func;
-pv_porcupine_frame_length_t pv_porcupine_frame_length_func;
-pv_porcupine_version_t pv_porcupine_version_func;
-pv_get_error_stack_t  pv_get_error_stack_func;
-pv_free_error_stack_t pv_free_error_stack_func;
+///
+/// \brief Entry points of one loaded Porcupine runtime library.
+/// Every Porcupine instance owns its table, so engines of different library
+/// versions can run side by side.
+///
+struct Api
+{
+    pv_status_to_string_t pv_status_to_string_func = nullptr;
+    pv_sample_rate_t pv_sample_rate_func = nullptr;
+    pv_porcupine_init_t pv_porcupine_init_func = nullptr;
+    pv_porcupine_delete_t pv_porcupine_delete_func = nullptr;
+    pv_porcupine_process_t  pv_porcupine_process_func = nullptr;
+    pv_porcupine_frame_length_t pv_porcupine_frame_length_func = nullptr;
+    pv_porcupine_version_t pv_porcupine_version_func = nullptr;
+    pv_get_error_stack_t  pv_get_error_stack_func = nullptr;
+    pv_free_error_stack_t pv_free_error_stack_func = nullptr;
+};
 
 QString pvGetLibpath()
 {
@@ -58,72 +70,72 @@ bool errLoadingPorcupino(const QString& fn, QString* errMsg = nullptr)
     return false;
 }
 
-bool  porcupine_fn_init(QLibrary* lib, QString* errMsg = nullptr)
+bool  porcupine_fn_init(QLibrary* lib, Api* api, QString* errMsg = nullptr)
 {
     if (!lib->load())
         return errLoadingPorcupino(QStringLiteral("library"), errMsg);
 
-    pv_status_to_string_func = (pv_status_to_string_t) lib->resolve("pv_status_to_string");
+    api->pv_status_to_string_func = (pv_status_to_string_t) lib->resolve("pv_status_to_string");
 
-    if (!pv_status_to_string_func)
+    if (!api->pv_status_to_string_func)
         return errLoadingPorcupino(QStringLiteral("pv_status_to_string"), errMsg);
 
-    pv_sample_rate_func = (pv_sample_rate_t) lib->resolve("pv_sample_rate");
+    api->pv_sample_rate_func = (pv_sample_rate_t) lib->resolve("pv_sample_rate");
 
-    if (!pv_sample_rate_func)
+    if (!api->pv_sample_rate_func)
         return errLoadingPorcupino(QStringLiteral("pv_sample_rate"), errMsg);
 
-    pv_porcupine_init_func = (pv_porcupine_init_t) lib->resolve("pv_porcupine_init");
+    api->pv_porcupine_init_func = (pv_porcupine_init_t) lib->resolve("pv_porcupine_init");
 
-    if (!pv_porcupine_init_func)
+    if (!api->pv_porcupine_init_func)
         return errLoadingPorcupino(QStringLiteral("pv_porcupine_init"), errMsg);
 
-    pv_porcupine_delete_func = (pv_porcupine_delete_t) lib->resolve("pv_porcupine_delete");
+    api->pv_porcupine_delete_func = (pv_porcupine_delete_t) lib->resolve("pv_porcupine_delete");
 
-    if (!pv_porcupine_delete_func)
+    if (!api->pv_porcupine_delete_func)
         return errLoadingPorcupino(QStringLiteral("pv_porcupine_delete"), errMsg);
 
-    pv_porcupine_process_func = (pv_porcupine_process_t) lib->resolve("pv_porcupine_process");
+    api->pv_porcupine_process_func = (pv_porcupine_process_t) lib->resolve("pv_porcupine_process");
 
-    if (!pv_porcupine_process_func)
+    if (!api->pv_porcupine_process_func)
         return errLoadingPorcupino(QStringLiteral("pv_porcupine_process"), errMsg);
 
-    pv_porcupine_frame_length_func = (pv_porcupine_frame_length_t) lib->resolve("pv_porcupine_frame_length");
+    api->pv_porcupine_frame_length_func = (pv_porcupine_frame_length_t) lib->resolve("pv_porcupine_frame_length");
 
-    if (!pv_porcupine_frame_length_func)
+    if (!api->pv_porcupine_frame_length_func)
         return errLoadingPorcupino(QStringLiteral("pv_porcupine_frame_length"), errMsg);
 
-    pv_porcupine_version_func = (pv_porcupine_version_t) lib->resolve("pv_porcupine_version");
+    api->pv_porcupine_version_func = (pv_porcupine_version_t) lib->resolve("pv_porcupine_version");
 
-    if (!pv_porcupine_version_func)
+    if (!api->pv_porcupine_version_func)
         return errLoadingPorcupino(QStringLiteral("pv_porcupine_version"), errMsg);
 
-    pv_get_error_stack_func = (pv_get_error_stack_t) lib->resolve("pv_get_error_stack");
+    api->pv_get_error_stack_func = (pv_get_error_stack_t) lib->resolve("pv_get_error_stack");
 
-    if (!pv_get_error_stack_func)
+    if (!api->pv_get_error_stack_func)
         return errLoadingPorcupino(QStringLiteral("pv_get_error_stack"), errMsg);
 
-    pv_free_error_stack_func = (pv_free_error_stack_t) lib->resolve("pv_free_error_stack");
+    api->pv_free_error_stack_func = (pv_free_error_stack_t) lib->resolve("pv_free_error_stack");
 
-    if (!pv_free_error_stack_func)
+    if (!api->pv_free_error_stack_func)
         return errLoadingPorcupino(QStringLiteral("pv_free_error_stack"), errMsg);
 
     return true;
 }
 
-QString getMessageDetail(const QString& pvFunc, pv_status_t porcupine_status)
+QString getMessageDetail(const Api& api, const QString& pvFunc, pv_status_t porcupine_status)
 {
     QString msg;
     QTextStream inpErr(&msg);
     char** message_stack = NULL;
     int32_t message_stack_depth = 0;
     pv_status_t error_status = PV_STATUS_RUNTIME_ERROR;
-    inpErr <<  QString("'%0' failed with '%1'").arg(pvFunc, pv_status_to_string_func(porcupine_status));
-    error_status = pv_get_error_stack_func(&message_stack, &message_stack_depth);
+    inpErr <<  QString("'%0' failed with '%1'").arg(pvFunc, api.pv_status_to_string_func(porcupine_status));
+    error_status = api.pv_get_error_stack_func(&message_stack, &message_stack_depth);
 
     if (error_status != PV_STATUS_SUCCESS)
     {
-        inpErr << QString(".\nUnable to get Porcupine error state with '%1'.\n").arg(pv_status_to_string_func(error_status));
+        inpErr << QString(".\nUnable to get Porcupine error state with '%1'.\n").arg(api.pv_status_to_string_func(error_status));
     }
     else if (message_stack_depth > 0)
     {
@@ -134,7 +146,7 @@ QString getMessageDetail(const QString& pvFunc, pv_status_t porcupine_status)
             inpErr << QString("  [%1] %2\n").arg(QString::number(i), message_stack[i]);
         }
 
-        pv_free_error_stack_func(message_stack);
+        api.pv_free_error_stack_func(message_stack);
     }
     else
     {
@@ -0,0 +1,281 @@
+#include <QThread>
+#include <QTimer>
+
+#include "porcupinelog.h"
+#include "porcupineadmission.h"
+
+namespace
+{
+
+//
+// Shed order: shadow engines before production engines, then the lower
+// priority, then the lower shedding level, so engines are gated before
+// one of them is paused. Restored in reverse order.
+//
+bool shedsBefore(const PorcupineFanout::Counters& engine, const PorcupineFanout::Counters& other)
+{
+    const bool shadow = engine.role == PorcupineFanout::Shadow;
+    const bool otherShadow = other.role == PorcupineFanout::Shadow;
+
+    if (shadow != otherShadow)
+        return shadow;
+
+    if (engine.priority != other.priority)
+        return engine.priority < other.priority;
+
+    return engine.shedding < other.shedding;
+}
+
+//
+// Restore order: production engines before shadow engines, then the higher
+// priority, then the lower shedding level.
+//
+bool restoresBefore(const PorcupineFanout::Counters& engine, const PorcupineFanout::Counters& other)
+{
+    const bool shadow = engine.role == PorcupineFanout::Shadow;
+    const bool otherShadow = other.role == PorcupineFanout::Shadow;
+
+    if (shadow != otherShadow)
+        return otherShadow;
+
+    if (engine.priority != other.priority)
+        return engine.priority > other.priority;
+
+    return engine.shedding < other.shedding;
+}
+
+}
+
+PorcupineAdmission::PorcupineAdmission(PorcupineFanout* fanout, QObject* parent)
+    : QObject{parent}
+    , m_fanout(fanout)
+    , m_timer(new QTimer(this))
+    , m_loadLimit(0.85 * QThread::idealThreadCount())
+    , m_recoverLimit(0.6 * QThread::idealThreadCount())
+    , m_sustainWindows(4)
+    , m_protectedPriority(100)
+    , m_overWindows(0)
+    , m_idleWindows(0)
+    , m_overloaded(false)
+    , m_load(0)
+    , m_rejected(0)
+    , m_decisions(0)
+{
+    m_timer->setInterval(500);
+    QObject::connect(m_timer, &QTimer::timeout, this, &PorcupineAdmission::evaluate);
+}
+
+///
+/// \brief Starts watching the engines, an evaluation window is 500 ms.
+///
+void PorcupineAdmission::start()
+{
+    m_lastProcessNs.clear();
+    m_lastDropped.clear();
+    m_overWindows = 0;
+    m_idleWindows = 0;
+    m_clock.start();
+    m_timer->start();
+}
+
+///
+/// \brief Stops watching, the overload state is cleared.
+///
+void PorcupineAdmission::stop()
+{
+    m_timer->stop();
+    m_load = 0;
+    setOverloaded(false);
+}
+
+///
+/// \brief Decides whether another engine may be started.
+/// \param tag Name of the engine, reported with engineRejected().
+/// \return false while overloaded.
+///
+bool PorcupineAdmission::admit(const QString& tag)
+{
+    if (!m_overloaded)
+        return true;
+
+    ++m_rejected;
+    PorcupineLog::instance().post(PorcupineLog::Warning, QString("Engine \"%1\" rejected: overload").arg(tag));
+    emit engineRejected(tag);
+    return false;
+}
+
+bool PorcupineAdmission::overloaded() const
+{
+    return m_overloaded;
+}
+
+///
+/// \brief Gets the processing load of the engines in busy cores of the last window.
+///
+qreal PorcupineAdmission::load() const
+{
+    return m_load;
+}
+
+qint64 PorcupineAdmission::rejectedEngines() const
+{
+    return m_rejected;
+}
+
+///
+/// \brief Gets the number of shed and restore steps taken.
+///
+qint64 PorcupineAdmission::sheddingDecisions() const
+{
+    return m_decisions;
+}
+
+///
+/// \brief Sets the load in busy cores above which the engines are overloaded.
+///
+void PorcupineAdmission::setLoadLimit(qreal cores)
+{
+    m_loadLimit = cores;
+}
+
+///
+/// \brief Sets the load in busy cores below which shed engines are restored.
+///
+void PorcupineAdmission::setRecoverLimit(qreal cores)
+{
+    m_recoverLimit = cores;
+}
+
+///
+/// \brief Sets the number of consecutive windows a state must last before acting on it.
+///
+void PorcupineAdmission::setSustainWindows(int windows)
+{
+    m_sustainWindows = qMax(1, windows);
+}
+
+///
+/// \brief Sets the priority from which engines are never shed.
+///
+void PorcupineAdmission::setProtectedPriority(int priority)
+{
+    m_protectedPriority = priority;
+}
+
+//
+// Internal evaluates one window. Growing backlogs or drops of non-shed engines
+// count as overload even below the load limit, they mean the cores are shared
+// with something else.
+//
+void PorcupineAdmission::evaluate()
+{
+    const qint64 windowNs = m_clock.nsecsElapsed();
+    m_clock.restart();
+
+    if (windowNs <= 0)
+        return;
+
+    const QVector<PorcupineFanout::Counters> counters = m_fanout->counters();
+    qint64 busyNs = 0;
+    bool pressure = false;
+
+    for (const auto& engine : counters)
+    {
+        busyNs += engine.processNs - m_lastProcessNs.value(engine.tag, engine.processNs);
+        const qint64 dropped = engine.dropped - m_lastDropped.value(engine.tag, engine.dropped);
+        m_lastProcessNs.insert(engine.tag, engine.processNs);
+        m_lastDropped.insert(engine.tag, engine.dropped);
+
+        if (engine.shedding == PorcupineFanout::Normal && (dropped > 0 || engine.backlog * 2 > engine.capacity))
+            pressure = true;
+    }
+
+    m_load = qreal(busyNs) / windowNs;
+    m_overWindows = m_load > m_loadLimit || pressure ? m_overWindows + 1 : 0;
+    m_idleWindows = m_load < m_recoverLimit && !pressure ? m_idleWindows + 1 : 0;
+
+    if (m_overWindows >= m_sustainWindows)
+    {
+        // One step per sustain period, the effect shows in the next windows
+        m_overWindows = 0;
+        setOverloaded(true);
+        shedOne(counters);
+    }
+    else if (m_idleWindows >= m_sustainWindows)
+    {
+        m_idleWindows = 0;
+
+        if (!restoreOne(counters))
+            setOverloaded(false);
+    }
+}
+
+//
+// Internal raises the shedding level of the first engine in shed order which
+// is not protected: shadow engines first, then the lowest priority, engines of
+// the same priority are gated before one is paused.
+//
+bool PorcupineAdmission::shedOne(const QVector<PorcupineFanout::Counters>& counters)
+{
+    const PorcupineFanout::Counters* victim = nullptr;
+
+    for (const auto& engine : counters)
+    {
+        if (engine.priority >= m_protectedPriority || engine.shedding == PorcupineFanout::Paused)
+            continue;
+
+        if (victim == nullptr || shedsBefore(engine, *victim))
+            victim = &engine;
+    }
+
+    if (victim == nullptr)
+        return false;
+
+    const auto shedding = PorcupineFanout::Shedding(victim->shedding + 1);
+    m_fanout->setShedding(victim->tag, shedding);
+    ++m_decisions;
+    PorcupineLog::instance().post(PorcupineLog::Warning, QString("Engine \"%1\" %2 at load %3")
+                                  .arg(victim->tag, shedding == PorcupineFanout::Gated ? "gated" : "paused")
+                                  .arg(m_load, 0, 'f', 2));
+    emit engineShed(victim->tag, shedding);
+    return true;
+}
+
+//
+// Internal lowers the shedding level of the first shed engine in restore
+// order: production engines before shadow engines, then the highest priority.
+//
+bool PorcupineAdmission::restoreOne(const QVector<PorcupineFanout::Counters>& counters)
+{
+    const PorcupineFanout::Counters* engine = nullptr;
+
+    for (const auto& candidate : counters)
+    {
+        if (candidate.shedding == PorcupineFanout::Normal)
+            continue;
+
+        if (engine == nullptr || restoresBefore(candidate, *engine))
+            engine = &candidate;
+    }
+
+    if (engine == nullptr)
+        return false;
+
+    const auto shedding = PorcupineFanout::Shedding(engine->shedding - 1);
+    m_fanout->setShedding(engine->tag, shedding);
+    ++m_decisions;
+    PorcupineLog::instance().post(PorcupineLog::Info, QString("Engine \"%1\" %2 at load %3")
+                                  .arg(engine->tag, shedding == PorcupineFanout::Gated ? "gated" : "restored")
+                                  .arg(m_load, 0, 'f', 2));
+    emit engineShed(engine->tag, shedding);
+    return true;
+}
+
+void PorcupineAdmission::setOverloaded(bool overloaded)
+{
+    if (m_overloaded != overloaded)
+    {
+        m_overloaded = overloaded;
+        emit overloadChanged(overloaded);
+    }
+}
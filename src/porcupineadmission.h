@@ -0,0 +1,74 @@
+#ifndef PORCUPINEADMISSION_H
+#define PORCUPINEADMISSION_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+
+#include "porcupinefanout.h"
+
+class QTimer;
+
+///
+/// \brief Admission control and priority based load shedding of fanned out engines.
+/// Watches the processing load (busy cores) and the queue backlog of the engines
+/// of a PorcupineFanout. Under sustained overload new engines are rejected and
+/// engines are shed step by step: first gated by a strict energy threshold, then
+/// paused. Shadow engines are shed before production engines, within each the
+/// lowest priority first. Engines at or above the protected priority are
+/// never shed. Once the load has dropped for the same time, shed engines are
+/// restored in reverse order. The primary engine is not part of the fan-out.
+///
+class PorcupineAdmission : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PorcupineAdmission(PorcupineFanout* fanout, QObject* parent = nullptr);
+
+    void start();
+    void stop();
+
+    bool admit(const QString& tag);
+
+    bool overloaded() const;
+    qreal load() const;
+    qint64 rejectedEngines() const;
+    qint64 sheddingDecisions() const;
+
+    void setLoadLimit(qreal cores);
+    void setRecoverLimit(qreal cores);
+    void setSustainWindows(int windows);
+    void setProtectedPriority(int priority);
+
+signals:
+    void overloadChanged(bool overloaded);
+    void engineRejected(const QString& tag);
+    void engineShed(const QString& tag, PorcupineFanout::Shedding shedding);
+
+private slots:
+    void evaluate();
+
+private:
+    bool shedOne(const QVector<PorcupineFanout::Counters>& counters);
+    bool restoreOne(const QVector<PorcupineFanout::Counters>& counters);
+    void setOverloaded(bool overloaded);
+
+    PorcupineFanout*        m_fanout;
+    QTimer*                 m_timer;
+    QElapsedTimer           m_clock;
+    QHash<QString, qint64>  m_lastProcessNs;
+    QHash<QString, qint64>  m_lastDropped;
+    qreal                   m_loadLimit;
+    qreal                   m_recoverLimit;
+    int                     m_sustainWindows;
+    int                     m_protectedPriority;
+    int                     m_overWindows;
+    int                     m_idleWindows;
+    bool                    m_overloaded;
+    qreal                   m_load;
+    qint64                  m_rejected;
+    qint64                  m_decisions;
+};
+
+#endif // PORCUPINEADMISSION_H
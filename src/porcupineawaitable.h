@@ -0,0 +1,206 @@
+#ifndef PORCUPINEAWAITABLE_H
+#define PORCUPINEAWAITABLE_H
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <QString>
+#include <atomic>
+#include <coroutine>
+#include <optional>
+
+#include "detectionsink.h"
+#include "mpscring.h"
+
+///
+/// \brief Awaitable detection events for coroutine based services (C++20).
+/// Registered as DetectionSink, e.g. with QmlPorcupine::setDetectionSink(), the
+/// detector queues detections in a bounded lock-free MpscRing allocated once
+/// at construction. A single consumer coroutine awaits them:
+///
+///     while (auto detection = co_await detector.nextDetection())
+///         handle(detection->engine, detection->keywordIndex);
+///
+/// The loop ends with std::nullopt after close(). No thread is created. By
+/// default the waiting coroutine is resumed inline on the thread of the
+/// detecting engine: the capture thread of the primary engine, a pipeline
+/// stage or fan-out worker. The consumer code then runs on that thread up to
+/// its next co_await and delays the engine meanwhile, so it must be short and
+/// must not block. A service with more work sets a scheduler with
+/// setScheduler() that hands the handle to its own executor, see
+/// tools/pvawait. Awaiting does not allocate, a full ring drops new
+/// detections.
+///
+class AwaitableDetector : public DetectionSink
+{
+
+public:
+    struct Detection
+    {
+        QString engine;
+        int     keywordIndex = -1;
+        qint64  frame = 0;
+    };
+
+    typedef void (*Scheduler)(std::coroutine_handle<> handle, void* context);
+
+    class NextAwaiter
+    {
+
+    public:
+        explicit NextAwaiter(AwaitableDetector* detector)
+            : m_detector(detector)
+        {
+        }
+
+        bool await_ready()
+        {
+            return m_detector->take(&m_result) || m_detector->closed();
+        }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            // Once the handle is visible a producer may resume and finish the
+            // coroutine, this awaiter lives in its frame: only locals from here
+            AwaitableDetector* detector = m_detector;
+            detector->m_waiter.store(handle.address(), std::memory_order_seq_cst);
+
+            // A detection queued before the handle was visible would be lost
+            detector->wake();
+        }
+
+        std::optional<Detection> await_resume()
+        {
+            if (!m_result)
+                m_detector->take(&m_result);
+
+            return std::move(m_result);
+        }
+
+    private:
+        AwaitableDetector*          m_detector;
+        std::optional<Detection>    m_result;
+    };
+
+    explicit AwaitableDetector(int capacity = 64)
+        : m_ring(capacity)
+        , m_waiter(nullptr)
+        , m_closed(false)
+        , m_scheduler(nullptr)
+        , m_schedulerContext(nullptr)
+    {
+    }
+
+    ///
+    /// \brief Awaits the next detection, std::nullopt once closed and drained.
+    /// Only one coroutine may await at a time.
+    ///
+    NextAwaiter nextDetection()
+    {
+        return NextAwaiter(this);
+    }
+
+    ///
+    /// \brief Hands resumption to a service executor instead of the engine thread.
+    ///
+    void setScheduler(Scheduler scheduler, void* context)
+    {
+        m_scheduler = scheduler;
+        m_schedulerContext = context;
+    }
+
+    ///
+    /// \brief Ends the event stream, a waiting coroutine receives std::nullopt.
+    ///
+    void close()
+    {
+        m_closed.store(true, std::memory_order_seq_cst);
+        wake();
+    }
+
+    bool closed() const
+    {
+        return m_closed.load(std::memory_order_seq_cst);
+    }
+
+    ///
+    /// \brief Gets the number of detections dropped on a full ring.
+    ///
+    qint64 dropped() const
+    {
+        return m_ring.dropped();
+    }
+
+    void detected(const QString& engine, int keywordIndex, qint64 frame) override
+    {
+        Detection detection;
+        detection.engine = engine;
+        detection.keywordIndex = keywordIndex;
+        detection.frame = frame;
+
+        if (m_ring.push(detection))
+            wake();
+    }
+
+private:
+    // Consumer only
+    bool take(std::optional<Detection>* result)
+    {
+        Detection detection;
+
+        if (!m_ring.pop(&detection))
+            return false;
+
+        *result = std::move(detection);
+        return true;
+    }
+
+    bool pending() const
+    {
+        return m_ring.pending();
+    }
+
+    //
+    // Resumes the waiting coroutine if there is a detection or the stream is
+    // closed, it never wakes up to an empty ring. Whoever takes the handle owns
+    // the resumption; without work it is put back and the ring checked again
+    // for a detection queued meanwhile by a producer that found no handle.
+    //
+    void wake()
+    {
+        for (;;)
+        {
+            void* waiter = m_waiter.exchange(nullptr, std::memory_order_seq_cst);
+
+            if (waiter == nullptr)
+                return;
+
+            if (pending() || closed())
+            {
+                const auto handle = std::coroutine_handle<>::from_address(waiter);
+
+                // Nothing of this is touched after the resumption
+                if (m_scheduler != nullptr)
+                    m_scheduler(handle, m_schedulerContext);
+                else
+                    handle.resume();
+
+                return;
+            }
+
+            m_waiter.store(waiter, std::memory_order_seq_cst);
+
+            if (!pending() && !closed())
+                return;
+        }
+    }
+
+    MpscRing<Detection>         m_ring;
+    std::atomic<void*>          m_waiter;
+    std::atomic<bool>           m_closed;
+    Scheduler                   m_scheduler;
+    void*                       m_schedulerContext;
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // PORCUPINEAWAITABLE_H
@@ -0,0 +1,402 @@
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "detectionsink.h"
+#include "porcupine.h"
+#include "porcupinefanout.h"
+#include "porcupinetrace.h"
+
+///
+/// \brief Worker thread running one additional engine.
+///
+class PorcupineFanout::Worker : public QThread
+{
+
+public:
+    Worker(PorcupineFanout* owner, const QString& tag, Porcupine* engine, Role role, int priority)
+        : m_owner(owner)
+        , m_tag(tag)
+        , m_engine(engine)
+        , m_role(role)
+        , m_priority(priority)
+        , m_ring(role == Shadow ? 8 : 64)
+        , m_head(0)
+        , m_count(0)
+        , m_stop(false)
+        , m_failed(false)
+        , m_backlog(0)
+        , m_packets(0)
+        , m_frames(0)
+        , m_dropped(0)
+        , m_detections(0)
+        , m_shedding(Normal)
+        , m_shed(0)
+        , m_processNs(0)
+    {
+        m_engine->enable(true);
+    }
+
+    ~Worker() override
+    {
+        m_mutex.lock();
+        m_stop = true;
+        m_mutex.unlock();
+        m_wake.wakeOne();
+        wait();
+        delete m_engine;
+    }
+
+    //
+    // Queues a reference to block. Shadow engines never make the caller wait:
+    // if the queue is busy or full the packet is dropped for this engine only.
+    // A shed engine skips the packet, a gated one unless it exceeds the gate.
+    //
+    void push(const QByteArray& block, int size, bool aboveGate)
+    {
+        const Shedding shedding = Shedding(m_shedding.load(std::memory_order_relaxed));
+
+        if (shedding == Paused || (shedding == Gated && !aboveGate))
+        {
+            m_shed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (m_role == Shadow)
+        {
+            if (!m_mutex.tryLock())
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        else
+        {
+            m_mutex.lock();
+        }
+
+        if (m_failed || m_count == m_ring.size())
+        {
+            m_mutex.unlock();
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Packet& packet = m_ring[(m_head + m_count) % m_ring.size()];
+        packet.block = block;
+        packet.size = size;
+        ++m_count;
+        m_backlog.store(m_count, std::memory_order_relaxed);
+        m_mutex.unlock();
+        m_wake.wakeOne();
+    }
+
+    Counters counters() const
+    {
+        Counters counters;
+        counters.tag = m_tag;
+        counters.role = m_role;
+        counters.packets = m_packets.load(std::memory_order_relaxed);
+        counters.frames = m_frames.load(std::memory_order_relaxed);
+        counters.dropped = m_dropped.load(std::memory_order_relaxed);
+        counters.detections = m_detections.load(std::memory_order_relaxed);
+        counters.backlog = m_backlog.load(std::memory_order_relaxed);
+        counters.capacity = m_ring.size();
+        counters.priority = m_priority;
+        counters.shedding = Shedding(m_shedding.load(std::memory_order_relaxed));
+        counters.shed = m_shed.load(std::memory_order_relaxed);
+        counters.processNs = m_processNs.load(std::memory_order_relaxed);
+        counters.perf = m_engine->perfCounters();
+        counters.memory = m_engine->memoryFootprint();
+        counters.bufferBytes = m_engine->bufferBytes();
+        return counters;
+    }
+
+    const QString& tag() const
+    {
+        return m_tag;
+    }
+
+    Shedding shedding() const
+    {
+        return Shedding(m_shedding.load(std::memory_order_relaxed));
+    }
+
+    void setShedding(Shedding shedding)
+    {
+        m_shedding.store(shedding, std::memory_order_relaxed);
+    }
+
+protected:
+    void run() override
+    {
+        Packet packet;
+
+        for (;;)
+        {
+            m_mutex.lock();
+
+            while (m_count == 0 && !m_stop)
+                m_wake.wait(&m_mutex);
+
+            if (m_stop)
+            {
+                m_mutex.unlock();
+                break;
+            }
+
+            std::swap(packet, m_ring[m_head]);
+            m_head = (m_head + 1) % m_ring.size();
+            --m_count;
+            m_backlog.store(m_count, std::memory_order_relaxed);
+            m_mutex.unlock();
+
+            int keywordIndex = -1;
+            QString errMsg;
+            QElapsedTimer processClock;
+            processClock.start();
+            const bool success = m_engine->process(keywordIndex, packet.block.constData(), packet.size, &errMsg);
+            m_processNs.fetch_add(processClock.nsecsElapsed(), std::memory_order_relaxed);
+            // Hand the block back to the pool before anything else
+            packet.block = QByteArray();
+            m_packets.fetch_add(1, std::memory_order_relaxed);
+            m_frames.fetch_add(m_engine->framesProcessed(), std::memory_order_relaxed);
+
+            if (!success)
+            {
+                m_mutex.lock();
+                m_failed = true;
+                m_mutex.unlock();
+                emit m_owner->engineFailed(m_tag, errMsg);
+            }
+            else if (keywordIndex >= 0)
+            {
+                m_detections.fetch_add(1, std::memory_order_relaxed);
+                DetectionSink* sink = m_owner->m_sink.load(std::memory_order_acquire);
+
+                if (sink != nullptr)
+                    sink->detected(m_tag, keywordIndex, m_frames.load(std::memory_order_relaxed));
+
+                PV_TRACE_INSTANT("keywordDetected", keywordIndex);
+                emit m_owner->keywordDetected(m_tag, keywordIndex);
+            }
+        }
+    }
+
+private:
+    struct Packet
+    {
+        QByteArray  block;
+        int         size = 0;
+    };
+
+    PorcupineFanout*    m_owner;
+    const QString       m_tag;
+    Porcupine*          m_engine;
+    const Role          m_role;
+    const int           m_priority;
+    QMutex              m_mutex;
+    QWaitCondition      m_wake;
+    QVector<Packet>     m_ring;
+    int                 m_head;
+    int                 m_count;
+    bool                m_stop;
+    bool                m_failed;
+    std::atomic<int>    m_backlog;
+    std::atomic<qint64> m_packets;
+    std::atomic<qint64> m_frames;
+    std::atomic<qint64> m_dropped;
+    std::atomic<qint64> m_detections;
+    std::atomic<int>    m_shedding;
+    std::atomic<qint64> m_shed;
+    std::atomic<qint64> m_processNs;
+};
+
+PorcupineFanout::PorcupineFanout(QObject* parent)
+    : QObject(parent)
+    , m_pool(PoolSize)
+    , m_poolPos(0)
+    , m_poolExhausted(0)
+    , m_gateMeanSquare(0)
+    , m_sink(nullptr)
+{
+    // Blocks are allocated up front, dispatch() only grows them for larger packets
+    for (auto& block : m_pool)
+        block.resize(4096);
+
+    setGateLevel(-40);
+}
+
+PorcupineFanout::~PorcupineFanout()
+{
+    clear();
+}
+
+///
+/// \brief Adds an engine and starts its worker thread.
+/// \param tag Name reported with every detection of this engine.
+/// \param engine The engine, ownership is taken over.
+/// \param role Secondary or shadow engine.
+/// \param priority Engines with lower priority are shed first under overload.
+///
+void PorcupineFanout::addEngine(const QString& tag, Porcupine* engine, Role role, int priority)
+{
+    Worker* worker = new Worker(this, tag, engine, role, priority);
+    worker->setObjectName(tag);
+    m_workers.append(worker);
+    worker->start(role == Shadow ? QThread::LowestPriority : QThread::InheritPriority);
+}
+
+///
+/// \brief Stops all worker threads and deletes their engines.
+///
+void PorcupineFanout::clear()
+{
+    qDeleteAll(m_workers);
+    m_workers.clear();
+}
+
+///
+/// \brief Sets the load shedding level of an engine.
+/// \param tag Name of the engine.
+/// \param shedding New level, takes effect with the next dispatched packet.
+///
+void PorcupineFanout::setShedding(const QString& tag, Shedding shedding)
+{
+    for (auto worker : m_workers)
+    {
+        if (worker->tag() == tag)
+            worker->setShedding(shedding);
+    }
+}
+
+///
+/// \brief Sets the energy threshold of gated engines.
+/// \param dBFS Mean packet level in dB relative to full scale, e.g. -40.
+///
+void PorcupineFanout::setGateLevel(qreal dBFS)
+{
+    const qreal amplitude = 32768 * std::pow(10.0, dBFS / 20);
+    m_gateMeanSquare = qint64(amplitude * amplitude);
+}
+
+///
+/// \brief Reports detections to sink, called on the worker threads.
+/// \param sink The sink, not owned, nullptr to stop reporting.
+///
+void PorcupineFanout::setDetectionSink(DetectionSink* sink)
+{
+    m_sink.store(sink, std::memory_order_release);
+}
+
+bool PorcupineFanout::isEmpty() const
+{
+    return m_workers.isEmpty();
+}
+
+///
+/// \brief Hands a packet of the capture stream to all engines.
+/// The data is copied once into a pooled block shared by all workers.
+/// \param audioData Raw audio data stream.
+/// \param len Length in bytes of the data stream.
+///
+void PorcupineFanout::dispatch(const char* audioData, int len)
+{
+    if (m_workers.isEmpty() || len <= 0)
+        return;
+
+    PV_TRACE_SCOPE("fanout.dispatch", len);
+
+    QByteArray* block = acquireBlock(len);
+
+    if (block == nullptr)
+    {
+        // All blocks still referenced: engines are far behind, skip the packet
+        ++m_poolExhausted;
+        return;
+    }
+
+    std::memcpy(block->data(), audioData, len);
+    // The energy is only needed while an engine is gated
+    bool gated = false;
+
+    for (auto worker : m_workers)
+        gated |= worker->shedding() == Gated;
+
+    const bool aboveGate = gated && meanSquare(audioData, len) >= m_gateMeanSquare;
+
+    for (auto worker : m_workers)
+        worker->push(*block, len, aboveGate);
+}
+
+///
+/// \brief Gets the counters of all engines.
+///
+QVector<PorcupineFanout::Counters> PorcupineFanout::counters() const
+{
+    QVector<Counters> counters;
+
+    for (auto worker : m_workers)
+        counters.append(worker->counters());
+
+    return counters;
+}
+
+///
+/// \brief Gets the number of packets skipped for all engines because no pooled block was free.
+///
+qint64 PorcupineFanout::skippedPackets() const
+{
+    return m_poolExhausted;
+}
+
+//
+// Internal finds a block no worker references any more.
+//
+QByteArray* PorcupineFanout::acquireBlock(int len)
+{
+    for (int i = 0; i < PoolSize; ++i)
+    {
+        QByteArray& block = m_pool[(m_poolPos + i) % PoolSize];
+
+        if (block.isDetached())
+        {
+            // Pairs with the release of the last worker reference
+            std::atomic_thread_fence(std::memory_order_acquire);
+            m_poolPos = (m_poolPos + i + 1) % PoolSize;
+
+            if (block.size() < len)
+                block.resize(len);
+
+            return &block;
+        }
+    }
+
+    return nullptr;
+}
+
+//
+// Internal mean square of 16 bit samples.
+//
+qint64 PorcupineFanout::meanSquare(const char* audioData, int len)
+{
+    const int count = len / int(sizeof(qint16));
+
+    if (count == 0)
+        return 0;
+
+    qint64 sum = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        qint16 sample;
+        std::memcpy(&sample, audioData + i * sizeof(qint16), sizeof(sample));
+        sum += qint64(sample) * sample;
+    }
+
+    return sum / count;
+}
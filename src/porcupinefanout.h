@@ -0,0 +1,115 @@
+#ifndef PORCUPINEFANOUT_H
+#define PORCUPINEFANOUT_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+#include "porcupinememory.h"
+#include "porcupineperf.h"
+
+class Porcupine;
+class DetectionSink;
+
+///
+/// \brief Fans one capture stream out to additional Porcupine engines.
+/// Each engine runs on its own worker thread. Packets are copied once into a
+/// pooled, implicitly shared block which all workers reference, so the stream
+/// is not copied per engine. The primary engine is not part of the fan-out and
+/// keeps processing inline; dispatching never blocks on a shadow engine.
+///
+class PorcupineFanout : public QObject
+{
+    Q_OBJECT
+
+public:
+    ///
+    /// \brief Role of an additional engine.
+    /// Secondary: e.g. another language, packets are only dropped on a full queue.
+    /// Shadow: evaluation engine on a low priority thread with a short queue,
+    /// dropped first under CPU pressure.
+    ///
+    enum Role
+    {
+        Secondary,
+        Shadow
+    };
+    Q_ENUM(Role)
+
+    ///
+    /// \brief Load shedding level of an engine, set by PorcupineAdmission.
+    /// Normal: every packet is processed.
+    /// Gated: only packets above a strict energy threshold are processed.
+    /// Paused: no packet is processed.
+    ///
+    enum Shedding
+    {
+        Normal,
+        Gated,
+        Paused
+    };
+    Q_ENUM(Shedding)
+
+    struct Counters
+    {
+        QString tag;
+        Role    role = Secondary;
+        qint64  packets = 0;
+        qint64  frames = 0;
+        qint64  dropped = 0;
+        qint64  detections = 0;
+        int     backlog = 0;
+        int     capacity = 0;
+        int     priority = 0;
+        Shedding shedding = Normal;
+        qint64  shed = 0;
+        qint64  processNs = 0;
+        PorcupinePerf::Counters perf;
+        PorcupineMemory::Usage memory;
+        int     bufferBytes = 0;
+    };
+
+    explicit PorcupineFanout(QObject* parent = nullptr);
+    ~PorcupineFanout();
+
+    void addEngine(const QString& tag, Porcupine* engine, Role role, int priority = 0);
+
+    void setShedding(const QString& tag, Shedding shedding);
+
+    void setGateLevel(qreal dBFS);
+
+    void setDetectionSink(DetectionSink* sink);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    void dispatch(const char* audioData, int len);
+
+    QVector<Counters> counters() const;
+
+    qint64 skippedPackets() const;
+
+signals:
+    void keywordDetected(const QString& tag, int keywordIndex);
+    void engineFailed(const QString& tag, const QString& errMsg);
+
+private:
+    class Worker;
+
+    QByteArray* acquireBlock(int len);
+    static qint64 meanSquare(const char* audioData, int len);
+
+    static const int PoolSize = 64;
+
+    QVector<Worker*>    m_workers;
+    QVector<QByteArray> m_pool;
+    int                 m_poolPos;
+    qint64              m_poolExhausted;
+    qint64              m_gateMeanSquare;
+    std::atomic<DetectionSink*> m_sink;
+};
+
+#endif // PORCUPINEFANOUT_H
@@ -0,0 +1,204 @@
+#include <QString>
+#include <chrono>
+#include <cstring>
+
+#include "porcupinelog.h"
+
+namespace
+{
+
+qint64 steadyNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+///
+/// \brief Gets the process wide logging sink. The writer thread starts with the
+/// first call, Porcupine and QmlPorcupine make it on construction so that it
+/// never starts on the detection path.
+/// \return The logging sink.
+///
+PorcupineLog& PorcupineLog::instance()
+{
+    static PorcupineLog log;
+    return log;
+}
+
+PorcupineLog::PorcupineLog()
+    : m_queue(QueueSize)
+    , m_posted(0)
+    , m_written(0)
+    , m_running(true)
+    , m_originNs(steadyNs())
+{
+    m_writer = std::thread(&PorcupineLog::run, this);
+}
+
+PorcupineLog::~PorcupineLog()
+{
+    m_running.store(false, std::memory_order_release);
+    m_wake.notify_one();
+
+    if (m_writer.joinable())
+        m_writer.join();
+}
+
+///
+/// \brief Posts a structured record, formatting is deferred to the writer thread.
+/// \param level Severity of the record.
+/// \param event Kind of the record, selects the message format.
+/// \param arg0 First event argument, e.g. the keyword index.
+/// \param arg1 Second event argument.
+/// \return false if the queue was full and the record has been dropped.
+///
+bool PorcupineLog::post(Level level, Event event, qint32 arg0, qint32 arg1)
+{
+    Record record;
+    record.timestampNs = steadyNs();
+    record.level = level;
+    record.event = event;
+    record.args[0] = arg0;
+    record.args[1] = arg1;
+    record.text[0] = '\0';
+    return enqueue(record);
+}
+
+///
+/// \brief Posts a text record, the text is truncated to the fixed record size.
+/// \param level Severity of the record.
+/// \param text Zero terminated message text.
+/// \return false if the queue was full and the record has been dropped.
+///
+bool PorcupineLog::post(Level level, const char* text)
+{
+    Record record;
+    record.timestampNs = steadyNs();
+    record.level = level;
+    record.event = Text;
+    record.args[0] = 0;
+    record.args[1] = 0;
+    std::strncpy(record.text, text, TextSize - 1);
+    record.text[TextSize - 1] = '\0';
+    return enqueue(record);
+}
+
+///
+/// \brief Posts a text record, convenience overload for already formatted messages.
+///
+bool PorcupineLog::post(Level level, const QString& text)
+{
+    return post(level, text.toUtf8().constData());
+}
+
+///
+/// \brief Gets the number of records accepted by the queue.
+///
+qint64 PorcupineLog::postedRecords() const
+{
+    return m_posted.load(std::memory_order_relaxed);
+}
+
+///
+/// \brief Gets the number of records dropped because the queue was full.
+///
+qint64 PorcupineLog::droppedRecords() const
+{
+    return m_queue.dropped();
+}
+
+///
+/// \brief Blocks until all records posted so far have been written.
+///
+void PorcupineLog::flush()
+{
+    const qint64 posted = m_posted.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_wake.notify_one();
+    m_flushed.wait(lock, [this, posted]()
+    {
+        return m_written.load(std::memory_order_acquire) >= posted;
+    });
+}
+
+//
+// Internal queues a record, never blocks.
+//
+bool PorcupineLog::enqueue(const Record& record)
+{
+    if (!m_queue.push(record))
+        return false;
+
+    m_posted.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+//
+// Internal writer thread. Producers never take the mutex, so the writer polls
+// with a short timeout instead of relying on notifications only.
+//
+void PorcupineLog::run()
+{
+    Record record;
+
+    for (;;)
+    {
+        bool written = false;
+
+        while (m_queue.pop(&record))
+        {
+            write(record);
+            m_written.fetch_add(1, std::memory_order_release);
+            written = true;
+        }
+
+        if (written)
+        {
+            // Under the mutex a flush() between its check and its wait is not missed
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_flushed.notify_all();
+        }
+
+        if (!m_running.load(std::memory_order_acquire))
+            break;
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait_for(lock, std::chrono::milliseconds(20));
+    }
+}
+
+void PorcupineLog::write(const Record& record) const
+{
+    QString message;
+
+    switch (record.event)
+    {
+    case KeywordDetected:
+        message = QString("Porcupine detected keyword, index = %1.").arg(record.args[0]);
+        break;
+
+    default:
+        message = QString::fromUtf8(record.text);
+        break;
+    }
+
+    // Time of posting in seconds since the sink started, not of writing
+    message = QString("[%1] %2").arg((record.timestampNs - m_originNs) / 1e9, 0, 'f', 6).arg(message);
+
+    switch (record.level)
+    {
+    case Warning:
+        qWarning("%s", qPrintable(message));
+        break;
+
+    case Critical:
+        qCritical("%s", qPrintable(message));
+        break;
+
+    default:
+        qInfo("%s", qPrintable(message));
+        break;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef PORCUPINELOG_H
+#define PORCUPINELOG_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "mpscring.h"
+
+///
+/// \brief Asynchronous logging sink for engine and capture messages.
+/// Callers only copy a fixed-size record into a bounded lock-free MpscRing,
+/// a background thread formats the records and hands them to the Qt message
+/// handler. Records that do not fit into the queue are counted and dropped.
+///
+class PorcupineLog
+{
+
+public:
+    enum Level
+    {
+        Info,
+        Warning,
+        Critical
+    };
+
+    enum Event
+    {
+        Text,
+        KeywordDetected
+    };
+
+    static PorcupineLog& instance();
+
+    ~PorcupineLog();
+
+    bool post(Level level, Event event, qint32 arg0 = 0, qint32 arg1 = 0);
+
+    bool post(Level level, const char* text);
+
+    bool post(Level level, const QString& text);
+
+    qint64 postedRecords() const;
+
+    qint64 droppedRecords() const;
+
+    void flush();
+
+private:
+    static const int TextSize = 232;
+    static const int QueueSize = 1024;
+
+    struct Record
+    {
+        qint64  timestampNs;
+        qint32  level;
+        qint32  event;
+        qint32  args[2];
+        char    text[TextSize];
+    };
+
+    PorcupineLog();
+
+    bool enqueue(const Record& record);
+    void run();
+    void write(const Record& record) const;
+
+    MpscRing<Record>            m_queue;
+    std::atomic<qint64>         m_posted;
+    std::atomic<qint64>         m_written;
+    std::atomic<bool>           m_running;
+    const qint64                m_originNs;
+    std::mutex                  m_wakeMutex;
+    std::condition_variable     m_wake;
+    std::condition_variable     m_flushed;
+    std::thread                 m_writer;
+};
+
+#endif // PORCUPINELOG_H
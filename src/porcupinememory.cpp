@@ -0,0 +1,108 @@
+#include <QFile>
+
+#include "porcupinememory.h"
+
+std::atomic<bool> PorcupineMemory::s_enabled(false);
+
+bool PorcupineMemory::Usage::isValid() const
+{
+    return rss >= 0;
+}
+
+PorcupineMemory::Usage PorcupineMemory::Usage::operator-(const Usage& other) const
+{
+    Usage delta;
+
+    if (isValid() && other.isValid())
+    {
+        delta.rss = rss - other.rss;
+        delta.pss = pss - other.pss;
+        delta.sharedClean = sharedClean - other.sharedClean;
+        delta.privateDirty = privateDirty - other.privateDirty;
+    }
+
+    return delta;
+}
+
+///
+/// \brief Formats the usage as one line, e.g. for a report.
+///
+QString PorcupineMemory::Usage::format() const
+{
+    if (!isValid())
+        return QString("no memory accounting");
+
+    return QString("rss %1, pss %2, shared clean %3, private dirty %4")
+           .arg(formatBytes(rss), formatBytes(pss), formatBytes(sharedClean), formatBytes(privateDirty));
+}
+
+///
+/// \brief Switches the accounting of engine creation on or off.
+/// Engines created while it is off report an invalid memoryFootprint().
+///
+void PorcupineMemory::enable(bool enable)
+{
+    s_enabled.store(enable, std::memory_order_relaxed);
+}
+
+///
+/// \brief Samples the memory usage of a process.
+/// \param pid The process, 0 for the calling process.
+/// \return The usage in bytes, invalid if not available.
+///
+PorcupineMemory::Usage PorcupineMemory::sample(qint64 pid)
+{
+    Usage usage;
+#ifdef __linux__
+    const QString proc = pid == 0 ? QString("/proc/self") : QString("/proc/%1").arg(pid);
+    // smaps_rollup exists since Linux 4.14, smaps is summed up per mapping
+    QFile file(proc + "/smaps_rollup");
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        file.setFileName(proc + "/smaps");
+
+        if (!file.open(QIODevice::ReadOnly))
+            return usage;
+    }
+
+    usage.rss = 0;
+    usage.pss = 0;
+
+    // Lines like "Pss:                1234 kB"
+    while (!file.atEnd())
+    {
+        const QByteArray line = file.readLine();
+        const int colon = line.indexOf(':');
+
+        if (colon <= 0 || !line.endsWith("kB\n"))
+            continue;
+
+        const QByteArray key = line.left(colon);
+        const qint64 bytes = 1024 * line.mid(colon + 1, line.size() - colon - 4).trimmed().toLongLong();
+
+        if (key == "Rss")
+            usage.rss += bytes;
+        else if (key == "Pss")
+            usage.pss += bytes;
+        else if (key == "Shared_Clean")
+            usage.sharedClean += bytes;
+        else if (key == "Private_Dirty")
+            usage.privateDirty += bytes;
+    }
+#else
+    Q_UNUSED(pid)
+#endif
+    return usage;
+}
+
+///
+/// \brief Formats a byte count in KiB or MiB.
+///
+QString PorcupineMemory::formatBytes(qint64 bytes)
+{
+    if (qAbs(bytes) >= 10 * 1024 * 1024)
+        return QString("%1 MiB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+
+    return QString("%1 KiB").arg(bytes / 1024.0, 0, 'f', 1);
+}
@@ -0,0 +1,47 @@
+#ifndef PORCUPINEMEMORY_H
+#define PORCUPINEMEMORY_H
+
+#include <QString>
+#include <atomic>
+
+///
+/// \brief Memory accounting of the process from /proc/<pid>/smaps_rollup (Linux).
+/// RSS counts every resident page in full. PSS divides each shared page by the
+/// number of processes mapping it, so the PSS of forked workers sharing model
+/// pages copy-on-write sums up to the memory they really occupy. Usage deltas
+/// taken around engine creation give the cost of an engine instance, they are
+/// only taken with accounting enabled since each one reads procfs twice.
+/// On other platforms, or without procfs, sample() returns an invalid Usage.
+///
+class PorcupineMemory
+{
+
+public:
+    struct Usage
+    {
+        qint64 rss = -1;
+        qint64 pss = -1;
+        qint64 sharedClean = 0;
+        qint64 privateDirty = 0;
+
+        bool isValid() const;
+        Usage operator-(const Usage& other) const;
+        QString format() const;
+    };
+
+    static void enable(bool enable);
+
+    static bool enabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static Usage sample(qint64 pid = 0);
+
+    static QString formatBytes(qint64 bytes);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // PORCUPINEMEMORY_H
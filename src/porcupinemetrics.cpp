@@ -0,0 +1,394 @@
+#include <QHostAddress>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+
+#include "porcupinelog.h"
+#include "porcupinememory.h"
+#include "porcupinemetrics.h"
+
+const qint64 PorcupineMetrics::LatencyBoundsNs[LatencyBuckets] =
+{
+    50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 32000000
+};
+
+namespace
+{
+
+QString escapeLabel(QString value)
+{
+    return value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+}
+
+}
+
+PorcupineMetrics::PorcupineMetrics(QObject* parent)
+    : QObject{parent}
+    , m_server(nullptr)
+    , m_port(0)
+    , m_frames(0)
+    , m_processNs(0)
+    , m_backlog(0)
+    , m_deviceErrors(0)
+    , m_recoveries(0)
+    , m_lastRecoveryMs(0)
+    , m_initTimeMs(0)
+    , m_skippedPackets(0)
+    , m_hasJitter(false)
+{
+    for (auto& bucket : m_latency)
+        bucket.store(0, std::memory_order_relaxed);
+
+    for (auto& detections : m_detections)
+        detections.store(0, std::memory_order_relaxed);
+
+    m_thread.setObjectName("PorcupineMetrics");
+}
+
+PorcupineMetrics::~PorcupineMetrics()
+{
+    close();
+}
+
+///
+/// \brief Starts serving GET /metrics on localhost.
+/// \param port TCP port, 0 picks a free port, see port().
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool PorcupineMetrics::listen(quint16 port, QString* errMsg)
+{
+    close();
+    m_thread.start();
+    m_server = new QTcpServer;
+    m_server->moveToThread(&m_thread);
+    bool success = false;
+
+    // Sockets must be created on the thread serving them
+    QMetaObject::invokeMethod(m_server, [this, port, errMsg, &success]()
+    {
+        QObject::connect(m_server, &QTcpServer::newConnection, m_server, [this]()
+        {
+            while (QTcpSocket* socket = m_server->nextPendingConnection())
+            {
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+                QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]()
+                {
+                    if (!socket->canReadLine())
+                        return;
+
+                    const QList<QByteArray> request = socket->readLine().simplified().split(' ');
+                    const bool found = request.size() >= 2 && request.at(0) == "GET"
+                                       && (request.at(1) == "/metrics" || request.at(1) == "/");
+                    const QByteArray body = found ? render() : QByteArray("Not found\n");
+                    socket->write(QByteArray(found ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n")
+                                  + "Content-Type: text/plain; version=0.0.4\r\n"
+                                  + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                                  + "Connection: close\r\n\r\n" + body);
+                    socket->disconnectFromHost();
+                });
+            }
+        });
+
+        success = m_server->listen(QHostAddress::LocalHost, port);
+
+        if (!success && errMsg != nullptr)
+            *errMsg = QString("Cannot serve metrics on port %1: %2").arg(port).arg(m_server->errorString());
+
+        m_port = m_server->serverPort();
+    }, Qt::BlockingQueuedConnection);
+
+    if (!success)
+        close();
+    else
+        PorcupineLog::instance().post(PorcupineLog::Info, QString("Serving metrics on http://127.0.0.1:%1/metrics").arg(m_port));
+
+    return success;
+}
+
+///
+/// \brief Stops serving and joins the listener thread.
+///
+void PorcupineMetrics::close()
+{
+    if (m_server != nullptr)
+    {
+        QMetaObject::invokeMethod(m_server, [this]() { delete m_server; }, Qt::BlockingQueuedConnection);
+        m_server = nullptr;
+    }
+
+    m_thread.quit();
+    m_thread.wait();
+    m_port = 0;
+}
+
+quint16 PorcupineMetrics::port() const
+{
+    return m_port;
+}
+
+///
+/// \brief Accounts processed frames, the packet time is spread evenly over its frames.
+/// \param frames Number of Porcupine frames processed.
+/// \param processNs Time spent on them in nanoseconds.
+///
+void PorcupineMetrics::observeFrames(qint64 frames, qint64 processNs)
+{
+    if (frames <= 0)
+        return;
+
+    const qint64 perFrameNs = processNs / frames;
+    int bucket = 0;
+
+    while (bucket < LatencyBuckets && perFrameNs > LatencyBoundsNs[bucket])
+        ++bucket;
+
+    m_latency[bucket].fetch_add(frames, std::memory_order_relaxed);
+    m_frames.fetch_add(frames, std::memory_order_relaxed);
+    m_processNs.fetch_add(processNs, std::memory_order_relaxed);
+}
+
+///
+/// \brief Accounts one detection of the keyword model row keywordIndex.
+///
+void PorcupineMetrics::addDetection(int keywordIndex)
+{
+    if (keywordIndex >= 0 && keywordIndex < MaxKeywords)
+        m_detections[keywordIndex].fetch_add(1, std::memory_order_relaxed);
+}
+
+///
+/// \brief Sets the number of captured bytes waiting in the audio device.
+///
+void PorcupineMetrics::setBacklog(qint64 bytes)
+{
+    m_backlog.store(bytes, std::memory_order_relaxed);
+}
+
+void PorcupineMetrics::addDeviceError()
+{
+    m_deviceErrors.fetch_add(1, std::memory_order_relaxed);
+}
+
+///
+/// \brief Accounts a recovered capture failure.
+/// \param ms Time without audio data until capture resumed.
+///
+void PorcupineMetrics::addRecovery(qint64 ms)
+{
+    m_recoveries.fetch_add(1, std::memory_order_relaxed);
+    m_lastRecoveryMs.store(ms, std::memory_order_relaxed);
+}
+
+void PorcupineMetrics::setInitTime(qint64 ms)
+{
+    m_initTimeMs.store(ms, std::memory_order_relaxed);
+}
+
+///
+/// \brief Sets the keyword names used as labels, indexed by model row.
+///
+void PorcupineMetrics::setKeywords(const QStringList& keywords)
+{
+    QMutexLocker locker(&m_mutex);
+    m_keywords = keywords;
+}
+
+///
+/// \brief Publishes the counters of the fanned out engines.
+///
+void PorcupineMetrics::setEngineCounters(const QVector<PorcupineFanout::Counters>& counters, qint64 skippedPackets)
+{
+    QMutexLocker locker(&m_mutex);
+    m_engineCounters = counters;
+    m_skippedPackets = skippedPackets;
+}
+
+///
+/// \brief Publishes the jitter buffer counters of UDP ingestion.
+///
+void PorcupineMetrics::setJitterCounters(const JitterBuffer::Counters& counters)
+{
+    QMutexLocker locker(&m_mutex);
+    m_hasJitter = true;
+    m_jitter = counters;
+}
+
+///
+/// \brief Publishes the counters of the detection bus subscribers.
+///
+void PorcupineMetrics::setBusCounters(const QVector<DetectionBus::Counters>& counters)
+{
+    QMutexLocker locker(&m_mutex);
+    m_busCounters = counters;
+}
+
+///
+/// \brief Formats all metrics in Prometheus text exposition format.
+///
+QByteArray PorcupineMetrics::render() const
+{
+    QByteArray text;
+    QTextStream out(&text);
+
+    out << "# HELP porcupine_frames_processed_total Porcupine frames processed by the primary engine.\n"
+        << "# TYPE porcupine_frames_processed_total counter\n"
+        << "porcupine_frames_processed_total " << m_frames.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP porcupine_frame_process_seconds Processing time per Porcupine frame.\n"
+        << "# TYPE porcupine_frame_process_seconds histogram\n";
+    qint64 cumulative = 0;
+
+    for (int i = 0; i < LatencyBuckets; ++i)
+    {
+        cumulative += m_latency[i].load(std::memory_order_relaxed);
+        out << "porcupine_frame_process_seconds_bucket{le=\"" << LatencyBoundsNs[i] / 1e9 << "\"} " << cumulative << "\n";
+    }
+
+    cumulative += m_latency[LatencyBuckets].load(std::memory_order_relaxed);
+    out << "porcupine_frame_process_seconds_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << "porcupine_frame_process_seconds_sum " << m_processNs.load(std::memory_order_relaxed) / 1e9 << "\n"
+        << "porcupine_frame_process_seconds_count " << cumulative << "\n";
+
+    out << "# HELP porcupine_capture_backlog_bytes Captured bytes waiting in the audio device.\n"
+        << "# TYPE porcupine_capture_backlog_bytes gauge\n"
+        << "porcupine_capture_backlog_bytes " << m_backlog.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP porcupine_audio_device_errors_total Audio device errors.\n"
+        << "# TYPE porcupine_audio_device_errors_total counter\n"
+        << "porcupine_audio_device_errors_total " << m_deviceErrors.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP porcupine_capture_recoveries_total Capture failures recovered by reopening the audio source.\n"
+        << "# TYPE porcupine_capture_recoveries_total counter\n"
+        << "porcupine_capture_recoveries_total " << m_recoveries.load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP porcupine_capture_last_recovery_seconds Audio gap of the last recovered capture failure.\n"
+        << "# TYPE porcupine_capture_last_recovery_seconds gauge\n"
+        << "porcupine_capture_last_recovery_seconds " << m_lastRecoveryMs.load(std::memory_order_relaxed) / 1e3 << "\n";
+
+    out << "# HELP porcupine_engine_init_seconds Duration of the last engine initialization.\n"
+        << "# TYPE porcupine_engine_init_seconds gauge\n"
+        << "porcupine_engine_init_seconds " << m_initTimeMs.load(std::memory_order_relaxed) / 1e3 << "\n";
+
+    out << "# HELP porcupine_log_dropped_records_total Log records dropped on a full log queue.\n"
+        << "# TYPE porcupine_log_dropped_records_total counter\n"
+        << "porcupine_log_dropped_records_total " << PorcupineLog::instance().droppedRecords() << "\n";
+
+    const PorcupineMemory::Usage memory = PorcupineMemory::sample();
+
+    if (memory.isValid())
+    {
+        out << "# HELP porcupine_process_resident_bytes Resident memory of the process.\n"
+            << "# TYPE porcupine_process_resident_bytes gauge\n"
+            << "porcupine_process_resident_bytes " << memory.rss << "\n";
+
+        out << "# HELP porcupine_process_proportional_bytes Proportional set size of the process, shared pages divided by their users.\n"
+            << "# TYPE porcupine_process_proportional_bytes gauge\n"
+            << "porcupine_process_proportional_bytes " << memory.pss << "\n";
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    out << "# HELP porcupine_detections_total Keyword detections of the primary engine.\n"
+        << "# TYPE porcupine_detections_total counter\n";
+
+    for (int i = 0; i < MaxKeywords; ++i)
+    {
+        const qint64 detections = m_detections[i].load(std::memory_order_relaxed);
+
+        if (i < m_keywords.size() || detections > 0)
+            out << "porcupine_detections_total{keyword=\"" << escapeLabel(m_keywords.value(i, QString::number(i)))
+                << "\"} " << detections << "\n";
+    }
+
+    out << "# HELP porcupine_fanout_skipped_packets_total Audio packets not fanned out for lack of a free block.\n"
+        << "# TYPE porcupine_fanout_skipped_packets_total counter\n"
+        << "porcupine_fanout_skipped_packets_total " << m_skippedPackets << "\n";
+
+    out << "# HELP porcupine_dropped_packets_total Audio packets dropped by a fanned out engine.\n"
+        << "# TYPE porcupine_dropped_packets_total counter\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_dropped_packets_total{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.dropped << "\n";
+
+    out << "# HELP porcupine_engine_frames_total Porcupine frames processed by a fanned out engine.\n"
+        << "# TYPE porcupine_engine_frames_total counter\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_engine_frames_total{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.frames << "\n";
+
+    out << "# HELP porcupine_engine_backlog_packets Packets queued for a fanned out engine.\n"
+        << "# TYPE porcupine_engine_backlog_packets gauge\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_engine_backlog_packets{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.backlog << "\n";
+
+    out << "# HELP porcupine_engine_shed_packets_total Packets skipped by load shedding of a fanned out engine.\n"
+        << "# TYPE porcupine_engine_shed_packets_total counter\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_engine_shed_packets_total{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.shed << "\n";
+
+    out << "# HELP porcupine_engine_shedding Load shedding level of a fanned out engine (0 normal, 1 gated, 2 paused).\n"
+        << "# TYPE porcupine_engine_shedding gauge\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_engine_shedding{engine=\"" << escapeLabel(counters.tag) << "\"} " << int(counters.shedding) << "\n";
+
+    out << "# HELP porcupine_engine_init_resident_bytes Resident memory the process grew by creating a fanned out engine.\n"
+        << "# TYPE porcupine_engine_init_resident_bytes gauge\n";
+
+    for (const auto& counters : m_engineCounters)
+        if (counters.memory.isValid())
+            out << "porcupine_engine_init_resident_bytes{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.memory.rss << "\n";
+
+    out << "# HELP porcupine_engine_buffer_bytes Audio buffer allocated by a fanned out engine.\n"
+        << "# TYPE porcupine_engine_buffer_bytes gauge\n";
+
+    for (const auto& counters : m_engineCounters)
+        out << "porcupine_engine_buffer_bytes{engine=\"" << escapeLabel(counters.tag) << "\"} " << counters.bufferBytes << "\n";
+
+    out << "# HELP porcupine_bus_delivered_total Detections queued for a detection bus subscriber.\n"
+        << "# TYPE porcupine_bus_delivered_total counter\n";
+
+    for (const auto& counters : m_busCounters)
+        out << "porcupine_bus_delivered_total{subscriber=\"" << escapeLabel(counters.name) << "\"} " << counters.delivered << "\n";
+
+    out << "# HELP porcupine_bus_dropped_total Detections dropped at the backlog limit of a detection bus subscriber.\n"
+        << "# TYPE porcupine_bus_dropped_total counter\n";
+
+    for (const auto& counters : m_busCounters)
+        out << "porcupine_bus_dropped_total{subscriber=\"" << escapeLabel(counters.name) << "\"} " << counters.dropped << "\n";
+
+    out << "# HELP porcupine_bus_backlog Detections queued and not yet taken by a detection bus subscriber.\n"
+        << "# TYPE porcupine_bus_backlog gauge\n";
+
+    for (const auto& counters : m_busCounters)
+        out << "porcupine_bus_backlog{subscriber=\"" << escapeLabel(counters.name) << "\"} " << counters.backlog << "\n";
+
+    if (m_hasJitter)
+    {
+        out << "# HELP porcupine_udp_packets_received_total RTP packets received.\n"
+            << "# TYPE porcupine_udp_packets_received_total counter\n"
+            << "porcupine_udp_packets_received_total " << m_jitter.received << "\n";
+
+        out << "# HELP porcupine_udp_packet_events_total RTP packets late, lost, reordered or duplicated.\n"
+            << "# TYPE porcupine_udp_packet_events_total counter\n"
+            << "porcupine_udp_packet_events_total{event=\"late\"} " << m_jitter.late << "\n"
+            << "porcupine_udp_packet_events_total{event=\"lost\"} " << m_jitter.lost << "\n"
+            << "porcupine_udp_packet_events_total{event=\"reordered\"} " << m_jitter.reordered << "\n"
+            << "porcupine_udp_packet_events_total{event=\"duplicate\"} " << m_jitter.duplicates << "\n";
+
+        out << "# HELP porcupine_udp_concealed_samples_total Samples of lost packets filled in by concealment.\n"
+            << "# TYPE porcupine_udp_concealed_samples_total counter\n"
+            << "porcupine_udp_concealed_samples_total " << m_jitter.concealedSamples << "\n";
+
+        out << "# HELP porcupine_udp_jitter_delay_seconds Current jitter buffer delay.\n"
+            << "# TYPE porcupine_udp_jitter_delay_seconds gauge\n"
+            << "porcupine_udp_jitter_delay_seconds " << m_jitter.delayMs / 1e3 << "\n";
+    }
+
+    out.flush();
+    return text;
+}
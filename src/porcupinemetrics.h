@@ -0,0 +1,81 @@
+#ifndef PORCUPINEMETRICS_H
+#define PORCUPINEMETRICS_H
+
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+#include "detectionbus.h"
+#include "jitterbuffer.h"
+#include "porcupinefanout.h"
+
+class QTcpServer;
+
+///
+/// \brief Serves engine and capture counters in Prometheus text format.
+/// The capture thread only performs relaxed atomic updates. The HTTP listener
+/// runs on its own thread, bound to localhost, and reads the counters when a
+/// scrape arrives. Keyword names and fan-out counters are published at UI rate.
+///
+class PorcupineMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PorcupineMetrics(QObject* parent = nullptr);
+    ~PorcupineMetrics();
+
+    bool listen(quint16 port, QString* errMsg = nullptr);
+
+    void close();
+
+    quint16 port() const;
+
+    // Capture thread
+    void observeFrames(qint64 frames, qint64 processNs);
+    void addDetection(int keywordIndex);
+    void setBacklog(qint64 bytes);
+    void addDeviceError();
+    void addRecovery(qint64 ms);
+
+    // UI thread
+    void setInitTime(qint64 ms);
+    void setKeywords(const QStringList& keywords);
+    void setEngineCounters(const QVector<PorcupineFanout::Counters>& counters, qint64 skippedPackets);
+    void setJitterCounters(const JitterBuffer::Counters& counters);
+    void setBusCounters(const QVector<DetectionBus::Counters>& counters);
+
+    QByteArray render() const;
+
+private:
+    static const int MaxKeywords = 64;
+    static const int LatencyBuckets = 9;
+    static const qint64 LatencyBoundsNs[LatencyBuckets];
+
+    QThread                 m_thread;
+    QTcpServer*             m_server;
+    quint16                 m_port;
+
+    std::atomic<qint64>     m_frames;
+    std::atomic<qint64>     m_processNs;
+    std::atomic<qint64>     m_latency[LatencyBuckets + 1];
+    std::atomic<qint64>     m_detections[MaxKeywords];
+    std::atomic<qint64>     m_backlog;
+    std::atomic<qint64>     m_deviceErrors;
+    std::atomic<qint64>     m_recoveries;
+    std::atomic<qint64>     m_lastRecoveryMs;
+    std::atomic<qint64>     m_initTimeMs;
+
+    mutable QMutex          m_mutex;
+    QStringList             m_keywords;
+    QVector<PorcupineFanout::Counters> m_engineCounters;
+    qint64                  m_skippedPackets;
+    bool                    m_hasJitter;
+    JitterBuffer::Counters  m_jitter;
+    QVector<DetectionBus::Counters> m_busCounters;
+};
+
+#endif // PORCUPINEMETRICS_H
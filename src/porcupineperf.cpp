@@ -0,0 +1,324 @@
+#include <QThread>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include "porcupineperf.h"
+
+std::atomic<bool> PorcupinePerf::s_enabled(false);
+
+namespace
+{
+
+const int HardwareEvents = 4;
+
+struct ThreadEntry
+{
+    QString                     name;
+    PorcupinePerf::Accumulator  counters;
+};
+
+std::mutex g_threadsMutex;
+std::vector<std::shared_ptr<ThreadEntry>> g_threads;
+
+#ifdef __linux__
+
+int openEvent(quint32 type, quint64 config, int groupFd, bool excludeKernel)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = excludeKernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+}
+
+//
+// Counter group of one thread, closed when the thread ends.
+//
+struct ThreadGroup
+{
+    int                             fds[HardwareEvents] = {-1, -1, -1, -1};
+    int                             switchesFd = -1;
+    bool                            opened = false;
+    std::shared_ptr<ThreadEntry>    entry;
+
+    ~ThreadGroup()
+    {
+        close();
+    }
+
+    bool open(QString* errMsg)
+    {
+        static const quint64 configs[HardwareEvents] =
+        {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        opened = true;
+
+        for (int i = 0; i < HardwareEvents; ++i)
+        {
+            fds[i] = openEvent(PERF_TYPE_HARDWARE, configs[i], i == 0 ? -1 : fds[0], true);
+
+            if (fds[i] < 0)
+            {
+                if (errMsg != nullptr)
+                    *errMsg = QString("perf_event_open failed: %1. Check /proc/sys/kernel/perf_event_paranoid.")
+                              .arg(QString::fromLocal8Bit(std::strerror(errno)));
+
+                close();
+                return false;
+            }
+        }
+
+        // Context switches happen in the kernel, count them unless that is not permitted
+        switchesFd = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, -1, false);
+
+        if (switchesFd < 0)
+            switchesFd = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, -1, true);
+
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+        if (switchesFd >= 0)
+            ioctl(switchesFd, PERF_EVENT_IOC_ENABLE, 0);
+
+        entry = std::make_shared<ThreadEntry>();
+        entry->name = QThread::currentThread()->objectName();
+
+        if (entry->name.isEmpty())
+            entry->name = QString("Thread 0x%1").arg(quintptr(QThread::currentThreadId()), 0, 16);
+
+        std::lock_guard<std::mutex> lock(g_threadsMutex);
+        g_threads.push_back(entry);
+        return true;
+    }
+
+    void close()
+    {
+        for (auto& fd : fds)
+        {
+            if (fd >= 0)
+                ::close(fd);
+
+            fd = -1;
+        }
+
+        if (switchesFd >= 0)
+            ::close(switchesFd);
+
+        switchesFd = -1;
+    }
+
+    bool read(qint64* values) const
+    {
+        struct
+        {
+            quint64 nr;
+            quint64 values[HardwareEvents];
+        } group;
+
+        if (::read(fds[0], &group, sizeof(group)) != ssize_t(sizeof(group)) || group.nr != HardwareEvents)
+            return false;
+
+        for (int i = 0; i < HardwareEvents; ++i)
+            values[i] = qint64(group.values[i]);
+
+        struct
+        {
+            quint64 nr;
+            quint64 value;
+        } switches = {0, 0};
+
+        if (switchesFd >= 0 && ::read(switchesFd, &switches, sizeof(switches)) != ssize_t(sizeof(switches)))
+            switches.value = 0;
+
+        values[HardwareEvents] = qint64(switches.value);
+        return true;
+    }
+};
+
+ThreadGroup* threadGroup()
+{
+    thread_local ThreadGroup group;
+
+    if (!group.opened)
+        group.open(nullptr);
+
+    return group.fds[0] >= 0 ? &group : nullptr;
+}
+
+#endif
+
+}
+
+qreal PorcupinePerf::Counters::ipc() const
+{
+    return cycles > 0 ? qreal(instructions) / cycles : 0;
+}
+
+qreal PorcupinePerf::Counters::perFrame(qint64 value) const
+{
+    return frames > 0 ? qreal(value) / frames : 0;
+}
+
+///
+/// \brief Formats the counters as one line, e.g. for a log or a report.
+///
+QString PorcupinePerf::Counters::format() const
+{
+    return QString("frames %1, IPC %2, cycles/frame %3, LLC misses/frame %4, branch misses/frame %5, context switches %6")
+           .arg(frames)
+           .arg(ipc(), 0, 'f', 2)
+           .arg(perFrame(cycles), 0, 'f', 0)
+           .arg(perFrame(llcMisses), 0, 'f', 1)
+           .arg(perFrame(branchMisses), 0, 'f', 1)
+           .arg(contextSwitches);
+}
+
+PorcupinePerf::Accumulator::Accumulator()
+{
+    reset();
+}
+
+void PorcupinePerf::Accumulator::add(const Counters& delta)
+{
+    m_values[0].fetch_add(delta.frames, std::memory_order_relaxed);
+    m_values[1].fetch_add(delta.cycles, std::memory_order_relaxed);
+    m_values[2].fetch_add(delta.instructions, std::memory_order_relaxed);
+    m_values[3].fetch_add(delta.llcMisses, std::memory_order_relaxed);
+    m_values[4].fetch_add(delta.branchMisses, std::memory_order_relaxed);
+    m_values[5].fetch_add(delta.contextSwitches, std::memory_order_relaxed);
+}
+
+PorcupinePerf::Counters PorcupinePerf::Accumulator::snapshot() const
+{
+    Counters counters;
+    counters.frames = m_values[0].load(std::memory_order_relaxed);
+    counters.cycles = m_values[1].load(std::memory_order_relaxed);
+    counters.instructions = m_values[2].load(std::memory_order_relaxed);
+    counters.llcMisses = m_values[3].load(std::memory_order_relaxed);
+    counters.branchMisses = m_values[4].load(std::memory_order_relaxed);
+    counters.contextSwitches = m_values[5].load(std::memory_order_relaxed);
+    return counters;
+}
+
+void PorcupinePerf::Accumulator::reset()
+{
+    for (auto& value : m_values)
+        value.store(0, std::memory_order_relaxed);
+}
+
+///
+/// \brief Switches profiling on or off.
+/// Enabling probes the counters on the calling thread first.
+/// \param enable True to profile processed frames.
+/// \param errMsg optional output of error messages.
+/// \return false if the counters are not available, profiling then stays off.
+///
+bool PorcupinePerf::enable(bool enable, QString* errMsg)
+{
+    if (!enable)
+    {
+        s_enabled.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+#ifdef __linux__
+    ThreadGroup probe;
+
+    if (!probe.open(errMsg))
+        return false;
+
+    {
+        // The probe group is not a profiled thread
+        std::lock_guard<std::mutex> lock(g_threadsMutex);
+        g_threads.erase(std::find(g_threads.begin(), g_threads.end(), probe.entry));
+    }
+
+    s_enabled.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    if (errMsg != nullptr)
+        *errMsg = "Hardware counter profiling is only available on Linux.";
+
+    return false;
+#endif
+}
+
+///
+/// \brief Reads the counters of the calling thread before a frame.
+/// \return false if the thread has no counters.
+///
+bool PorcupinePerf::begin(Sample* sample)
+{
+#ifdef __linux__
+    ThreadGroup* group = threadGroup();
+    return group != nullptr && group->read(sample->values);
+#else
+    Q_UNUSED(sample)
+    return false;
+#endif
+}
+
+///
+/// \brief Reads the counters after a frame and accounts the delta.
+/// \param sample Values read by begin().
+/// \param engine Accumulator of the engine, may be nullptr.
+///
+void PorcupinePerf::end(const Sample& sample, Accumulator* engine)
+{
+#ifdef __linux__
+    ThreadGroup* group = threadGroup();
+    qint64 values[HardwareEvents + 1];
+
+    if (group == nullptr || !group->read(values))
+        return;
+
+    Counters delta;
+    delta.frames = 1;
+    delta.cycles = values[0] - sample.values[0];
+    delta.instructions = values[1] - sample.values[1];
+    delta.llcMisses = values[2] - sample.values[2];
+    delta.branchMisses = values[3] - sample.values[3];
+    delta.contextSwitches = values[4] - sample.values[4];
+    group->entry->counters.add(delta);
+
+    if (engine != nullptr)
+        engine->add(delta);
+#else
+    Q_UNUSED(sample)
+    Q_UNUSED(engine)
+#endif
+}
+
+///
+/// \brief Gets the counters of all profiled threads, including finished ones.
+///
+QVector<QPair<QString, PorcupinePerf::Counters>> PorcupinePerf::threadCounters()
+{
+    QVector<QPair<QString, Counters>> result;
+    std::lock_guard<std::mutex> lock(g_threadsMutex);
+
+    for (const auto& entry : g_threads)
+        result.append(qMakePair(entry->name, entry->counters.snapshot()));
+
+    return result;
+}
@@ -0,0 +1,75 @@
+#ifndef PORCUPINEPERF_H
+#define PORCUPINEPERF_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+///
+/// \brief Hardware counter profiling of pv_porcupine_process (Linux perf_event_open).
+/// When enabled every processed frame is bracketed by reads of a per-thread
+/// counter group: cycles, instructions, last level cache misses, branch misses
+/// and context switches. The deltas are accumulated per engine and per thread.
+/// Threads on which the counters cannot be opened, e.g. because of
+/// perf_event_paranoid or a virtual machine without PMU, are simply not profiled.
+/// On other platforms enable() fails and profiling stays off.
+///
+class PorcupinePerf
+{
+
+public:
+    struct Counters
+    {
+        qint64 frames = 0;
+        qint64 cycles = 0;
+        qint64 instructions = 0;
+        qint64 llcMisses = 0;
+        qint64 branchMisses = 0;
+        qint64 contextSwitches = 0;
+
+        qreal ipc() const;
+        qreal perFrame(qint64 value) const;
+        QString format() const;
+    };
+
+    ///
+    /// \brief Lock-free accumulator, written by one thread at a time and read by any.
+    ///
+    class Accumulator
+    {
+
+    public:
+        Accumulator();
+
+        void add(const Counters& delta);
+        Counters snapshot() const;
+        void reset();
+
+    private:
+        std::atomic<qint64> m_values[6];
+    };
+
+    struct Sample
+    {
+        qint64 values[5];
+    };
+
+    static bool enable(bool enable, QString* errMsg = nullptr);
+
+    static bool enabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static bool begin(Sample* sample);
+
+    static void end(const Sample& sample, Accumulator* engine);
+
+    static QVector<QPair<QString, Counters>> threadCounters();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // PORCUPINEPERF_H
@@ -0,0 +1,142 @@
+#include <QFile>
+#include <QTextStream>
+
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "porcupinelog.h"
+#include "porcupinetrace.h"
+#include "porcupinestartup.h"
+
+namespace
+{
+
+const char* const PhaseNames[PorcupineStartup::PhaseCount] =
+{
+    "process start",
+    "application init",
+    "QML compile/load",
+    "QLibrary load",
+    "symbol resolution",
+    "pv_porcupine_init"
+};
+
+// Trace event names must be string literals
+const char* const TraceNames[PorcupineStartup::PhaseCount] =
+{
+    "startup.process",
+    "startup.application",
+    "startup.qml",
+    "startup.library",
+    "startup.symbols",
+    "startup.pv_porcupine_init"
+};
+
+}
+
+std::atomic<qint64> PorcupineStartup::s_startNs[PhaseCount];
+std::atomic<qint64> PorcupineStartup::s_durationNs[PhaseCount];
+std::atomic<qint64> PorcupineStartup::s_processStartNs(0);
+std::atomic<bool>   PorcupineStartup::s_autoReport(false);
+
+///
+/// \brief Records the time from process start to main(), call first thing in main().
+/// On Linux the process start is taken from /proc/self/stat, in clock ticks
+/// (usually 10 ms). Elsewhere process start is taken as now.
+///
+void PorcupineStartup::markMain()
+{
+    const qint64 nowNs = PorcupineTrace::now();
+    qint64 ageNs = 0;
+#ifdef __linux__
+    QFile file("/proc/self/stat");
+    timespec boot;
+
+    if (file.open(QIODevice::ReadOnly) && clock_gettime(CLOCK_BOOTTIME, &boot) == 0)
+    {
+        // Fields after the command name, which may contain spaces; starttime is field 22
+        const QByteArray stat = file.readAll();
+        const QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+        const long ticks = sysconf(_SC_CLK_TCK);
+
+        if (fields.size() > 19 && ticks > 0)
+        {
+            const qint64 startNs = fields.at(19).toLongLong() * 1000000000LL / ticks;
+            ageNs = qMax(qint64(0), qint64(boot.tv_sec) * 1000000000LL + boot.tv_nsec - startNs);
+        }
+    }
+#endif
+    s_processStartNs.store(nowNs - ageNs, std::memory_order_relaxed);
+    record(ProcessStart, nowNs - ageNs, ageNs);
+}
+
+///
+/// \brief Records a phase, only its first occurrence is kept.
+/// \param phase The phase.
+/// \param startNs Begin, PorcupineTrace::now() time base.
+/// \param durationNs Duration.
+///
+void PorcupineStartup::record(Phase phase, qint64 startNs, qint64 durationNs)
+{
+    qint64 unset = 0;
+
+    if (!s_startNs[phase].compare_exchange_strong(unset, startNs, std::memory_order_relaxed))
+        return;
+
+    s_durationNs[phase].store(durationNs, std::memory_order_release);
+
+    if (PorcupineTrace::enabled())
+        PorcupineTrace::instance().complete(TraceNames[phase], startNs, durationNs);
+
+    // The engine is ready, startup is over. Posted line by line, a log record
+    // holds one line and the engine may have initialized on a worker thread
+    if (phase == EngineInit && s_autoReport.load(std::memory_order_relaxed))
+    {
+        for (const QString& line : report().split('\n', Qt::SkipEmptyParts))
+            PorcupineLog::instance().post(PorcupineLog::Info, line);
+    }
+}
+
+///
+/// \brief Writes the report to the PorcupineLog once the engine has initialized,
+/// e.g. enabled by the environment variable PV_STARTUP_REPORT.
+///
+void PorcupineStartup::setAutoReport(bool report)
+{
+    s_autoReport.store(report, std::memory_order_relaxed);
+}
+
+///
+/// \brief Formats the phases recorded so far.
+/// \return One line per phase with its begin after process start and its
+/// duration in milliseconds.
+///
+QString PorcupineStartup::report()
+{
+    QString text;
+    QTextStream out(&text);
+    const qint64 originNs = s_processStartNs.load(std::memory_order_relaxed);
+    out << "Startup, ms after process start:\n";
+
+    for (int phase = 0; phase < PhaseCount; ++phase)
+    {
+        const qint64 startNs = s_startNs[phase].load(std::memory_order_relaxed);
+
+        if (startNs == 0)
+        {
+            out << QString("  %1 not recorded\n").arg(PhaseNames[phase], -20);
+            continue;
+        }
+
+        const qint64 durationNs = s_durationNs[phase].load(std::memory_order_acquire);
+        out << QString("  %1 at %2, took %3\n")
+               .arg(PhaseNames[phase], -20)
+               .arg(originNs != 0 ? (startNs - originNs) / 1e6 : 0.0, 8, 'f', 1)
+               .arg(durationNs / 1e6, 8, 'f', 1);
+    }
+
+    out.flush();
+    return text;
+}
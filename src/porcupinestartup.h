@@ -0,0 +1,44 @@
+#ifndef PORCUPINESTARTUP_H
+#define PORCUPINESTARTUP_H
+
+#include <QString>
+#include <atomic>
+
+///
+/// \brief Startup timing of the application, from process start to a ready engine.
+/// Each phase keeps its first occurrence, later engine rebuilds do not
+/// overwrite the launch. Phases may be recorded from any thread, e.g. the
+/// engine warm-up. Times are PorcupineTrace::now() nanoseconds; with tracing
+/// on, phases are added to the timeline as well.
+///
+class PorcupineStartup
+{
+
+public:
+    enum Phase
+    {
+        ProcessStart,
+        ApplicationInit,
+        QmlLoad,
+        LibraryLoad,
+        SymbolResolve,
+        EngineInit,
+        PhaseCount
+    };
+
+    static void markMain();
+
+    static void record(Phase phase, qint64 startNs, qint64 durationNs);
+
+    static void setAutoReport(bool report);
+
+    static QString report();
+
+private:
+    static std::atomic<qint64>  s_startNs[PhaseCount];
+    static std::atomic<qint64>  s_durationNs[PhaseCount];
+    static std::atomic<qint64>  s_processStartNs;
+    static std::atomic<bool>    s_autoReport;
+};
+
+#endif // PORCUPINESTARTUP_H
@@ -0,0 +1,72 @@
+#include "porcupinestats.h"
+
+PorcupineStats::PorcupineStats()
+    : m_wakeUps(0)
+    , m_packets(0)
+    , m_packetBytes(0)
+    , m_maxPacketBytes(0)
+    , m_frames(0)
+    , m_detections(0)
+    , m_processNs(0)
+{
+}
+
+///
+/// \brief Accounts one delivered audio packet.
+/// \param bytes Size of the packet in bytes, empty packets count as wake-up only.
+/// \param frames Number of Porcupine frames processed for this packet.
+/// \param processNs Time spent on the packet in nanoseconds.
+///
+void PorcupineStats::addPacket(qint64 bytes, qint64 frames, qint64 processNs)
+{
+    m_wakeUps.fetch_add(1, std::memory_order_relaxed);
+
+    if (bytes > 0)
+        m_packets.fetch_add(1, std::memory_order_relaxed);
+
+    m_packetBytes.fetch_add(bytes, std::memory_order_relaxed);
+    m_frames.fetch_add(frames, std::memory_order_relaxed);
+    m_processNs.fetch_add(processNs, std::memory_order_relaxed);
+
+    qint64 maxBytes = m_maxPacketBytes.load(std::memory_order_relaxed);
+
+    while (bytes > maxBytes
+           && !m_maxPacketBytes.compare_exchange_weak(maxBytes, bytes, std::memory_order_relaxed))
+    {
+    }
+}
+
+///
+/// \brief Accounts one keyword detection.
+///
+void PorcupineStats::addDetection()
+{
+    m_detections.fetch_add(1, std::memory_order_relaxed);
+}
+
+///
+/// \brief Collects the counters accumulated since the last call and resets them.
+/// \param intervalNs Length of the collected interval, copied into the snapshot.
+/// \return The consolidated counters.
+///
+PorcupineStats::Snapshot PorcupineStats::snapshot(qint64 intervalNs)
+{
+    Snapshot snap;
+    snap.wakeUps = m_wakeUps.exchange(0, std::memory_order_relaxed);
+    snap.packets = m_packets.exchange(0, std::memory_order_relaxed);
+    snap.packetBytes = m_packetBytes.exchange(0, std::memory_order_relaxed);
+    snap.maxPacketBytes = m_maxPacketBytes.exchange(0, std::memory_order_relaxed);
+    snap.frames = m_frames.exchange(0, std::memory_order_relaxed);
+    snap.detections = m_detections.exchange(0, std::memory_order_relaxed);
+    snap.processNs = m_processNs.exchange(0, std::memory_order_relaxed);
+    snap.intervalNs = intervalNs;
+    return snap;
+}
+
+///
+/// \brief Drops all accumulated counters.
+///
+void PorcupineStats::reset()
+{
+    snapshot(0);
+}
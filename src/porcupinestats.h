@@ -0,0 +1,48 @@
+#ifndef PORCUPINESTATS_H
+#define PORCUPINESTATS_H
+
+#include <QtGlobal>
+#include <atomic>
+
+///
+/// \brief Lock-free accumulator for capture and engine statistics.
+/// The audio path only performs relaxed atomic adds, the consumer collects
+/// and resets the counters with snapshot() at its own (UI) rate.
+///
+class PorcupineStats
+{
+
+public:
+    struct Snapshot
+    {
+        qint64 wakeUps = 0;
+        qint64 packets = 0;
+        qint64 packetBytes = 0;
+        qint64 maxPacketBytes = 0;
+        qint64 frames = 0;
+        qint64 detections = 0;
+        qint64 processNs = 0;
+        qint64 intervalNs = 0;
+    };
+
+    PorcupineStats();
+
+    void addPacket(qint64 bytes, qint64 frames, qint64 processNs);
+
+    void addDetection();
+
+    Snapshot snapshot(qint64 intervalNs);
+
+    void reset();
+
+private:
+    std::atomic<qint64> m_wakeUps;
+    std::atomic<qint64> m_packets;
+    std::atomic<qint64> m_packetBytes;
+    std::atomic<qint64> m_maxPacketBytes;
+    std::atomic<qint64> m_frames;
+    std::atomic<qint64> m_detections;
+    std::atomic<qint64> m_processNs;
+};
+
+#endif // PORCUPINESTATS_H
@@ -0,0 +1,242 @@
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+
+#include "porcupinetrace.h"
+
+std::atomic<bool> PorcupineTrace::s_enabled(false);
+
+///
+/// \brief Gets the process wide tracer.
+///
+PorcupineTrace& PorcupineTrace::instance()
+{
+    static PorcupineTrace trace;
+    return trace;
+}
+
+PorcupineTrace::PorcupineTrace()
+    : m_nextTid(1)
+    , m_eventsPerThread(1 << 18)
+    , m_startNs(0)
+{
+}
+
+///
+/// \brief Gets the trace clock, steady nanoseconds.
+///
+qint64 PorcupineTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///
+/// \brief Starts recording, events recorded before are not exported any more.
+/// The rings of finished threads are freed.
+/// \param eventsPerThread Ring size of threads tracing for the first time,
+/// the default of 262144 events (8 MB) holds well over a minute of capture.
+///
+void PorcupineTrace::start(int eventsPerThread)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                                   [](const std::unique_ptr<ThreadBuffer>& buffer) { return buffer->retired; }),
+                    m_buffers.end());
+    m_eventsPerThread.store(qMax(1024, eventsPerThread), std::memory_order_relaxed);
+    m_startNs.store(now(), std::memory_order_relaxed);
+    s_enabled.store(true, std::memory_order_seq_cst);
+}
+
+///
+/// \brief Stops recording, recorded events are kept for export.
+/// Returns once no thread is writing an event any more, events ending later
+/// are not recorded.
+///
+void PorcupineTrace::stop()
+{
+    s_enabled.store(false, std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A writer marks its ring before it checks s_enabled, so it either sees
+    // tracing off or is seen here
+    for (const auto& buffer : m_buffers)
+    {
+        while (buffer->recording.load(std::memory_order_seq_cst))
+            QThread::yieldCurrentThread();
+    }
+}
+
+///
+/// \brief Records a complete event of the calling thread.
+/// \param name Event name, a string literal.
+/// \param startNs Begin, see now().
+/// \param durationNs Duration in nanoseconds.
+/// \param arg Event argument shown in the viewer, e.g. a size.
+///
+void PorcupineTrace::complete(const char* name, qint64 startNs, qint64 durationNs, qint64 arg)
+{
+    record({name, startNs, durationNs, arg});
+}
+
+///
+/// \brief Records an instant event of the calling thread, e.g. a signal emission.
+///
+void PorcupineTrace::instant(const char* name, qint64 arg)
+{
+    record({name, now(), -1, arg});
+}
+
+//
+// Internal gets the ring of the calling thread on its first event, a ring
+// retired by a finished thread is recycled before a new one is allocated.
+//
+PorcupineTrace::ThreadBuffer* PorcupineTrace::threadBuffer()
+{
+    thread_local ThreadSlot slot;
+
+    if (slot.buffer == nullptr)
+    {
+        const quint64 capacity = quint64(m_eventsPerThread.load(std::memory_order_relaxed));
+        const QString name = QThread::currentThread()->objectName();
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (const auto& buffer : m_buffers)
+        {
+            if (buffer->retired && buffer->capacity == capacity)
+            {
+                slot.buffer = buffer.get();
+                break;
+            }
+        }
+
+        if (slot.buffer == nullptr)
+        {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer);
+            created->capacity = capacity;
+            created->events.reset(new Event[created->capacity]);
+            created->recording.store(false, std::memory_order_relaxed);
+            slot.buffer = created.get();
+            m_buffers.push_back(std::move(created));
+        }
+
+        slot.buffer->tid = m_nextTid++;
+        slot.buffer->name = name;
+        slot.buffer->count.store(0, std::memory_order_relaxed);
+        slot.buffer->retired = false;
+    }
+
+    return slot.buffer;
+}
+
+//
+// Internal hands the ring of a finishing thread back, its events stay
+// exportable until start() or another thread takes it over.
+//
+void PorcupineTrace::retire(ThreadBuffer* buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer->retired = true;
+}
+
+PorcupineTrace::ThreadSlot::~ThreadSlot()
+{
+    if (buffer != nullptr)
+        PorcupineTrace::instance().retire(buffer);
+
+    buffer = nullptr;
+}
+
+//
+// Internal single writer append, the oldest events are overwritten.
+//
+void PorcupineTrace::record(const Event& event)
+{
+    ThreadBuffer* buffer = threadBuffer();
+    buffer->recording.store(true, std::memory_order_seq_cst);
+
+    // Recheck after the mark, stop() waits for it to clear
+    if (s_enabled.load(std::memory_order_seq_cst))
+    {
+        const quint64 count = buffer->count.load(std::memory_order_relaxed);
+        buffer->events[count % buffer->capacity] = event;
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+    buffer->recording.store(false, std::memory_order_release);
+}
+
+///
+/// \brief Writes the recorded timeline as Chrome trace JSON, tracing is stopped first.
+/// \param path Output file, e.g. capture.json for the Perfetto UI.
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool PorcupineTrace::exportChromeTrace(const QString& path, QString* errMsg)
+{
+    stop();
+    QFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        if (errMsg != nullptr)
+            *errMsg = QString("Cannot write trace \"%1\": %2").arg(path, file.errorString());
+
+        return false;
+    }
+
+    const qint64 startNs = m_startNs.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+
+    auto append = [&](const QByteArray& event)
+    {
+        if (!first)
+            json += ",\n";
+
+        json += event;
+        first = false;
+    };
+
+    for (const auto& buffer : m_buffers)
+    {
+        const QString name = buffer->name.isEmpty() ? QString("Thread %1").arg(buffer->tid) : buffer->name;
+        append(QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,\"args\":{\"name\":\"%2\"}}")
+               .arg(buffer->tid).arg(QString(name).replace('"', '\'')).toUtf8());
+
+        const quint64 count = buffer->count.load(std::memory_order_acquire);
+        const quint64 begin = count > buffer->capacity ? count - buffer->capacity : 0;
+
+        for (quint64 i = begin; i < count; ++i)
+        {
+            const Event& event = buffer->events[i % buffer->capacity];
+
+            if (event.startNs < startNs)
+                continue;
+
+            QByteArray line = "{\"name\":\"" + QByteArray(event.name) + "\",\"pid\":1,\"tid\":"
+                              + QByteArray::number(buffer->tid) + ",\"ts\":"
+                              + QByteArray::number((event.startNs - startNs) / 1e3, 'f', 3);
+
+            if (event.durationNs >= 0)
+                line += ",\"ph\":\"X\",\"dur\":" + QByteArray::number(event.durationNs / 1e3, 'f', 3);
+            else
+                line += ",\"ph\":\"i\",\"s\":\"t\"";
+
+            line += ",\"args\":{\"arg\":" + QByteArray::number(event.arg) + "}}";
+            append(line);
+        }
+
+        if (json.size() > (1 << 20))
+        {
+            file.write(json);
+            json.clear();
+        }
+    }
+
+    json += "\n]}\n";
+    file.write(json);
+    return file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,123 @@
+#ifndef PORCUPINETRACE_H
+#define PORCUPINETRACE_H
+
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+///
+/// \brief Timeline tracing of the capture and inference pipeline.
+/// Trace points record complete (begin + duration) or instant events into a
+/// ring buffer of the calling thread, no lock and no formatting on the hot path.
+/// With tracing off PV_TRACE_INSTANT costs one relaxed load and one branch,
+/// PV_TRACE_SCOPE the same in its constructor and another branch in its
+/// destructor. The ring of a finished thread is kept for export and recycled
+/// by the next thread that starts tracing. The recorded timeline is exported
+/// as Chrome trace JSON, which chrome://tracing and the Perfetto UI load
+/// directly. Event names must be string literals.
+///
+class PorcupineTrace
+{
+
+public:
+    static PorcupineTrace& instance();
+
+    static bool enabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    static qint64 now();
+
+    void start(int eventsPerThread = 1 << 18);
+
+    void stop();
+
+    void complete(const char* name, qint64 startNs, qint64 durationNs, qint64 arg = 0);
+
+    void instant(const char* name, qint64 arg = 0);
+
+    bool exportChromeTrace(const QString& path, QString* errMsg = nullptr);
+
+private:
+    struct Event
+    {
+        const char* name;
+        qint64      startNs;
+        qint64      durationNs;
+        qint64      arg;
+    };
+
+    struct ThreadBuffer
+    {
+        int                     tid = 0;
+        QString                 name;
+        std::unique_ptr<Event[]> events;
+        quint64                 capacity = 0;
+        std::atomic<quint64>    count;
+        std::atomic<bool>       recording;
+        bool                    retired = false;
+    };
+
+    struct ThreadSlot
+    {
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadSlot();
+    };
+
+    PorcupineTrace();
+
+    ThreadBuffer* threadBuffer();
+    void retire(ThreadBuffer* buffer);
+    void record(const Event& event);
+
+    static std::atomic<bool>    s_enabled;
+
+    std::mutex                  m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    int                         m_nextTid;
+    std::atomic<int>            m_eventsPerThread;
+    std::atomic<qint64>         m_startNs;
+};
+
+///
+/// \brief Records the lifetime of a scope as complete event.
+///
+class PorcupineTraceScope
+{
+
+public:
+    explicit PorcupineTraceScope(const char* name, qint64 arg = 0)
+        : m_name(PorcupineTrace::enabled() ? name : nullptr)
+        , m_arg(arg)
+        , m_startNs(m_name != nullptr ? PorcupineTrace::now() : 0)
+    {
+    }
+
+    ~PorcupineTraceScope()
+    {
+        if (m_name != nullptr)
+            PorcupineTrace::instance().complete(m_name, m_startNs, PorcupineTrace::now() - m_startNs, m_arg);
+    }
+
+    void setArg(qint64 arg)
+    {
+        m_arg = arg;
+    }
+
+private:
+    const char* m_name;
+    qint64      m_arg;
+    qint64      m_startNs;
+};
+
+#define PV_TRACE_CONCAT_(a, b) a##b
+#define PV_TRACE_CONCAT(a, b) PV_TRACE_CONCAT_(a, b)
+#define PV_TRACE_SCOPE(name, ...) PorcupineTraceScope PV_TRACE_CONCAT(pvTraceScope, __LINE__)(name, ##__VA_ARGS__)
+#define PV_TRACE_INSTANT(name, arg) \
+    do { if (PorcupineTrace::enabled()) PorcupineTrace::instance().instant(name, arg); } while (false)
+
+#endif // PORCUPINETRACE_H
@@ -21,12 +21,70 @@
 #include <QUrl>
 #include <QTimer>
 #include <QDirIterator>
+#include <QFileSystemWatcher>
+#include <QSignalBlocker>
+#include <QDateTime>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
 
 #include "porcupine.h"
+#include "porcupinelog.h"
+#include "keywordsmodel.h"
+#include "porcupinefanout.h"
+#include "detectionjournal.h"
+#include "porcupinemetrics.h"
+#include "porcupineadmission.h"
+#include "detectionsink.h"
+#include "detectionbus.h"
+#include "porcupinestartup.h"
+#include "porcupinetrace.h"
+#include "porcupineperf.h"
+#include "porcupinememory.h"
+#include "udpaudiosource.h"
+#include "alsaaudiosource.h"
+#include "audiopipeline.h"
+#include "audiostages.h"
 #include "qmlporcupine.h"
 
 #undef PV_KEYWORDS_PATH
 
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+typedef QAudioDeviceInfo AudioDevice;
+
+static QList<AudioDevice> audioInputs()
+{
+    return QAudioDeviceInfo::availableDevices(QAudio::AudioInput);
+}
+
+static AudioDevice defaultAudioInput()
+{
+    return QAudioDeviceInfo::defaultInputDevice();
+}
+
+static QString audioDeviceName(const AudioDevice& device)
+{
+    return device.deviceName();
+}
+#else
+typedef QAudioDevice AudioDevice;
+
+static QList<AudioDevice> audioInputs()
+{
+    return QMediaDevices::audioInputs();
+}
+
+static AudioDevice defaultAudioInput()
+{
+    return QMediaDevices::defaultAudioInput();
+}
+
+static QString audioDeviceName(const AudioDevice& device)
+{
+    return device.description();
+}
+#endif
+
 QVector<QString> AudioErrMsg =
 {
     QStringLiteral("No Errors"),
@@ -36,21 +94,16 @@ QVector<QString> AudioErrMsg =
     QStringLiteral("A non-recoverable error has occurred, the audio device is not usable at this time")
 };
 
-QVector<QString> pvGetKeywordsFiles(const QString& keywordsDir = QString())
+static QString pvGetKeywordName(const QString& keywordFile)
 {
-    QVector<QString> kwfiles;
-    QString pvKwDir;
-#ifdef PV_KEYWORDS_PATH
-    pvKwDir = keywordsDir.isEmpty() ? PV_KEYWORDS_PATH : keywordsDir;
-#else
-    pvKwDir = keywordsDir;
-#endif
-    QDirIterator keyFilesIt(pvKwDir, {"*.ppn"}, QDir::Files);
-
-    while (keyFilesIt.hasNext())
-        kwfiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+    QFileInfo fi(keywordFile);
+    return fi.baseName().split('_').at(0);
+}
 
-    return kwfiles;
+static QPair<qint64, qint64> pvGetKeywordStamp(const QString& keywordFile)
+{
+    QFileInfo fi(keywordFile);
+    return qMakePair(fi.size(), fi.lastModified().toMSecsSinceEpoch());
 }
 
 QString pvGetKeywordsDir(const QString& keywordsDir = QString())
@@ -95,20 +148,124 @@ static QAudioFormat preferredAudioFormat(const qint32 sampleRate)
 
 QmlPorcupine::QmlPorcupine(QObject* parent)
     : QObject{parent}
+    , m_watchKeywords(false)
+    , m_keywordsWatcher(new QFileSystemWatcher(this))
+    , m_reloadTimer(new QTimer(this))
+    , m_engineBuild(new QFutureWatcher<EngineBuild>(this))
+    , m_engineBuildPending(false)
+    , m_warmUp(false)
+    , m_componentComplete(false)
+    , m_warmUpBuild(new QFutureWatcher<EngineBuild>(this))
+    , m_fanout(new PorcupineFanout(this))
+    , m_admission(new PorcupineAdmission(m_fanout, this))
+    , m_detectionBus(new DetectionBus)
+    , m_journal(nullptr)
+    , m_streamId(0)
+    , m_streamSamples(0)
+    , m_metrics(new PorcupineMetrics(this))
+    , m_metricsPort(0)
+    , m_reloadPending(false)
     , m_sensitivity(0.5)
+    , m_engineSensitivity(0.5)
+    , m_reloadSensitivity(0.5)
     , m_inputPacketSize(0)
-    , m_keywords(new QStringListModel(this))
+    , m_keywords(new KeywordsModel(this))
     , m_porcupine(nullptr)
     , m_audioEngine(nullptr)
     , m_ioDevice(nullptr)
+    , m_watchdog(new QTimer(this))
+    , m_watchdogTimeout(2000)
+    , m_recoverOnNextDevice(false)
+    , m_recovering(false)
+    , m_captureRecoveries(0)
+    , m_lastRecoveryMs(0)
+    , m_udpSource(nullptr)
+    , m_udpPort(0)
+    , m_udpRepeatLastFrame(false)
+    , m_captureBackend(QtMultimediaBackend)
+    , m_alsaSource(nullptr)
+    , m_alsaDevice("default")
+    , m_pipelineMode(DirectProcessing)
+    , m_pipeline(nullptr)
+    , m_pipelineSource(nullptr)
+    , m_pipelineEngine(nullptr)
     , m_error(false)
     , m_engineReady(false)
+    , m_deliveryMode(OnReadyRead)
+    , m_framesPerPeriod(1)
+    , m_bufferPeriods(4)
+    , m_maxLatencyFrames(8)
+    , m_currentPeriodFrames(1)
+    , m_deliveryTimer(new QTimer(this))
+    , m_statsTimer(new QTimer(this))
+    , m_statsRate(4)
+    , m_maxInputPacketSize(0)
+    , m_wakeUpsPerSecond(0)
+    , m_framesPerSecond(0)
+    , m_detectionCount(0)
+    , m_processLoad(0)
 {
+    // Starts the log writer thread before capture starts
+    PorcupineLog::instance();
+    m_deliveryTimer->setTimerType(Qt::PreciseTimer);
+    QObject::connect(m_deliveryTimer, &QTimer::timeout, this, &QmlPorcupine::pvProcess);
+    m_statsTimer->setInterval(qRound(1000 / m_statsRate));
+    QObject::connect(m_statsTimer, &QTimer::timeout, this, &QmlPorcupine::publishStats);
+    QObject::connect(m_watchdog, &QTimer::timeout, this, &QmlPorcupine::checkCapture);
+
+    // File operations usually come in bursts, collect them before rescanning
+    m_reloadTimer->setSingleShot(true);
+    m_reloadTimer->setInterval(250);
+    QObject::connect(m_reloadTimer, &QTimer::timeout, this, &QmlPorcupine::reloadKeywords);
+    QObject::connect(m_keywordsWatcher, &QFileSystemWatcher::directoryChanged, m_reloadTimer, [this]() { m_reloadTimer->start(); });
+    QObject::connect(m_keywordsWatcher, &QFileSystemWatcher::fileChanged, m_reloadTimer, [this]() { m_reloadTimer->start(); });
+    QObject::connect(m_engineBuild, &QFutureWatcher<EngineBuild>::finished, this, &QmlPorcupine::keywordsEngineBuilt);
+    QObject::connect(m_keywords, &KeywordsModel::activeChanged, this, &QmlPorcupine::applyActiveKeywords);
+    m_fanout->setDetectionSink(m_detectionBus);
+    QObject::connect(m_fanout, &PorcupineFanout::keywordDetected, this, &QmlPorcupine::engineKeywordDetected);
+    QObject::connect(m_admission, &PorcupineAdmission::overloadChanged, this, &QmlPorcupine::overloadedChanged);
+    QObject::connect(m_admission, &PorcupineAdmission::engineRejected, this, &QmlPorcupine::engineRejected);
+    QObject::connect(m_admission, &PorcupineAdmission::engineShed, this, [this](const QString& tag, PorcupineFanout::Shedding shedding)
+    {
+        emit engineShed(tag, shedding == PorcupineFanout::Gated, shedding == PorcupineFanout::Paused);
+    });
+    QObject::connect(m_keywords, &QAbstractItemModel::dataChanged, m_metrics, [this]() { m_metrics->setKeywords(m_keywords->stringList()); });
+    QObject::connect(m_keywords, &QAbstractItemModel::rowsRemoved, m_metrics, [this]() { m_metrics->setKeywords(m_keywords->stringList()); });
+    QObject::connect(m_keywords, &QAbstractItemModel::modelReset, m_metrics, [this]() { m_metrics->setKeywords(m_keywords->stringList()); });
+    QObject::connect(m_fanout, &PorcupineFanout::engineFailed, this, [this](const QString& tag, const QString& errMsg)
+    {
+        emit infoMessage(QString("Engine \"%1\" stopped: %2").arg(tag, errMsg));
+    });
 }
 
 QmlPorcupine::~QmlPorcupine()
 {
+    // Also a finished build whose signal was not delivered yet owns its engine
+    if (m_engineBuildPending)
+    {
+        m_engineBuild->waitForFinished();
+        delete m_engineBuild->result().first;
+    }
+
+    // A warm-up still running owns its engine, as do discarded ones
+    if (!m_warmUpSignature.isEmpty())
+        m_warmUpBuild->waitForFinished();
+
+    delete takeWarmEngine(QStringList());
+
+    for (auto build : m_discardedWarmUps)
+    {
+        build->waitForFinished();
+        delete build->result().first;
+    }
+
+    deletePipeline();
+    clearEngineCache();
     delete m_porcupine;
+    delete m_journal;
+    // The fan-out workers publish to the bus until they are gone
+    m_fanout->clear();
+    delete m_detectionBus;
 }
 
 void QmlPorcupine::classBegin()
@@ -118,8 +275,13 @@ void QmlPorcupine::classBegin()
 void QmlPorcupine::componentComplete()
 {
     QString infoMsg = QString("Using Qt Version %1").arg((QT_VERSION_STR));
-    qInfo("%s", qPrintable(infoMsg));
+    PorcupineLog::instance().post(PorcupineLog::Info, infoMsg);
     emit infoMessage(infoMsg);
+    m_componentComplete = true;
+
+    // Settings of the surrounding document are applied after this component
+    if (m_warmUp)
+        QMetaObject::invokeMethod(this, &QmlPorcupine::startWarmUp, Qt::QueuedConnection);
 }
 
 
@@ -154,8 +316,24 @@ void QmlPorcupine::setPvKeyWordsDir(const QString& pvKeyWordsDir)
     if (m_pvKeyWordsDir != pvKeyWordsDir)
     {
         m_pvKeyWordsDir = pvKeyWordsDir;
-        m_pvKeyWordsFiles = pvGetKeywordsFiles(pvKeyWordsDir);
-        createKeywordsModel();
+
+        if (m_watchKeywords && (m_ioDevice != nullptr || m_recovering))
+        {
+            // A running engine is replaced in the background
+            reloadKeywords();
+        }
+        else
+        {
+            m_pvKeyWordsFiles = scanKeywords();
+            m_pvKeyWordsStamps.clear();
+
+            for (const auto& file : m_pvKeyWordsFiles)
+                m_pvKeyWordsStamps.insert(file, pvGetKeywordStamp(file));
+
+            createKeywordsModel();
+            updateKeywordsWatcher();
+        }
+
         emit pvKeyWordsDirChanged();
     }
 }
@@ -174,6 +352,8 @@ void QmlPorcupine::setSensitivity(qreal sensitivity)
     if (m_sensitivity != sensitivity)
     {
         m_sensitivity = sensitivity;
+        // Engines prepared for other subsets were built with the old sensitivity
+        clearEngineCache();
         emit sensitivityChanged();
     }
 }
@@ -183,226 +363,1991 @@ QStringListModel* QmlPorcupine::keywords() const
     return m_keywords;
 }
 
-QString QmlPorcupine::pvVersion() const
-{
-    return m_porcupine == nullptr ? QString() : m_porcupine->version();
-}
-
-qint32 QmlPorcupine::pvFrameLength() const
+bool QmlPorcupine::watchKeywords() const
 {
-    return m_porcupine == nullptr ? -1 : m_porcupine->frameLength();
+    return m_watchKeywords;
 }
 
-qint32 QmlPorcupine::pvSampleRate() const
+///
+/// \brief Enables watching the keywords directory.
+/// Added, removed or changed keyword files are picked up automatically, a running
+/// engine is rebuilt in the background and swapped in while capture continues.
+/// \param watch True to watch the directory, otherwise false.
+///
+void QmlPorcupine::setWatchKeywords(bool watch)
 {
-    return m_porcupine == nullptr ? -1 : m_porcupine->sampleRate();
+    if (m_watchKeywords != watch)
+    {
+        m_watchKeywords = watch;
+        updateKeywordsWatcher();
+        emit watchKeywordsChanged();
+    }
 }
 
-int QmlPorcupine::inputPacketSize() const
+bool QmlPorcupine::warmUp() const
 {
-    return m_inputPacketSize / 2;
+    return m_warmUp;
 }
 
-void QmlPorcupine::setInputPacketSize(int size)
+///
+/// \brief Creates the engine in the background while the UI loads.
+/// The warm-up starts once the component and its settings are complete,
+/// startListening() then takes the warm engine instead of initializing one,
+/// or waits for the rest of the warm-up. A warm engine for a different
+/// configuration is discarded.
+/// \param warmUp True to warm up, otherwise false.
+///
+void QmlPorcupine::setWarmUp(bool warmUp)
 {
-    if (m_inputPacketSize != size)
+    if (m_warmUp != warmUp)
     {
-        m_inputPacketSize = size;
-        emit inputPacketSizeChanged();
+        m_warmUp = warmUp;
+
+        if (warmUp && m_componentComplete)
+            startWarmUp();
+
+        emit warmUpChanged();
     }
 }
 
-
-bool QmlPorcupine::error() const
+const QString& QmlPorcupine::journalDir() const
 {
-    return m_error;
+    return m_journalDir;
 }
 
-bool QmlPorcupine::engineReady() const
+///
+/// \brief Sets the directory of the detection journal.
+/// Detections are appended to the journal while listening. The journal is
+/// closed and the new one opened at once, an empty directory disables it.
+/// \param dir Journal directory.
+///
+void QmlPorcupine::setJournalDir(const QString& dir)
 {
-    return m_engineReady;
+    if (m_journalDir != dir)
+    {
+        m_journalDir = dir;
+        delete m_journal;
+        m_journal = nullptr;
+        openJournal();
+        emit journalDirChanged();
+    }
 }
 
-
-const QString& QmlPorcupine::errorMsg() const
+int QmlPorcupine::metricsPort() const
 {
-    return m_errorMsg;
+    return m_metricsPort;
 }
 
-void QmlPorcupine::initPv()
+///
+/// \brief Serves engine and capture metrics at http://127.0.0.1:port/metrics.
+/// \param port TCP port on localhost, 0 stops serving.
+///
+void QmlPorcupine::setMetricsPort(int port)
 {
-    m_engineReady = false;
-    QVector<qreal> sensitivities = QVector<qreal>(m_pvKeyWordsFiles.size(), m_sensitivity);
-    m_porcupine = Porcupine::create(m_pvAccessKey,
-                                    m_pvKeyWordsFiles,
-                                    m_pvModelPath,
-                                    sensitivities,
-                                    &m_errorMsg);
-    m_error = m_porcupine == nullptr;
+    if (m_metricsPort == port)
+        return;
 
-    if (m_error)
+    m_metricsPort = port;
+    m_metrics->close();
+
+    if (port > 0 && port <= 65535)
     {
-        emit errorChanged();
+        QString errMsg;
+
+        if (!m_metrics->listen(quint16(port), &errMsg))
+        {
+            PorcupineLog::instance().post(PorcupineLog::Warning, errMsg);
+            emit infoMessage(errMsg);
+        }
     }
-    else
+
+    emit metricsPortChanged();
+}
+
+///
+/// \brief Gets the journaled detections of a time range.
+/// \param fromMs Begin of the range, milliseconds since epoch.
+/// \param toMs End of the range, milliseconds since epoch.
+/// \return One map per detection with time, stream, keyword, sample and version.
+/// The stream identifies the listening session, sample is the position in it.
+///
+QVariantList QmlPorcupine::journalQuery(qint64 fromMs, qint64 toMs) const
+{
+    QVariantList result;
+
+    if (m_journal == nullptr)
+        return result;
+
+    for (const auto& record : m_journal->query(fromMs * 1000, toMs * 1000 + 999))
     {
-        QString message = QString("Porcubine V%1 successfull initialized").arg(m_porcupine->version());
-        emit infoMessage(message);
-        m_pvAudioFormat = preferredAudioFormat(m_porcupine->sampleRate());
-        createKeywordsModel();
+        result.append(QVariantMap{
+            {"time", QDateTime::fromMSecsSinceEpoch(record.wallTimeUs / 1000)},
+            {"stream", record.streamId},
+            {"keyword", record.keywordIndex},
+            {"sample", record.sampleOffset},
+            {"version", QString::fromLatin1(record.engineVersion)}
+        });
     }
 
-    m_engineReady = !m_error;
-    emit engineReadyChanged();
-    return;
+    return result;
 }
 
-void QmlPorcupine::removePv()
+///
+/// \brief Gets the rows of the active keywords.
+/// \return Rows of the keywords model passed to the engine.
+///
+QVector<int> QmlPorcupine::activeKeywords() const
 {
-    delete m_porcupine;
-    m_porcupine = nullptr;
-    m_engineReady = false;
-    return;
+    return m_keywords->activeRows();
 }
 
-bool QmlPorcupine::startListening()
+///
+/// \brief Selects the keywords passed to the engine.
+/// While listening the engine is replaced by one for the new subset.
+/// \param rows Rows of the keywords model to activate, all others are deactivated.
+///
+void QmlPorcupine::setActiveKeywords(const QVector<int>& rows)
 {
-    initPv();
+    const QSignalBlocker blocker(m_keywords);
 
-    if (!m_engineReady)
-        return false;
+    for (int row = 0; row < m_keywords->rowCount(); ++row)
+        m_keywords->setActive(row, rows.contains(row));
 
-    m_errorMsg = QString();
-    m_error = false;
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    QAudioDeviceInfo device = QAudioDeviceInfo::defaultInputDevice();
-    QString deviceName = device.deviceName();
-#else
-    QAudioDevice device(QMediaDevices::defaultAudioInput());
-    QString deviceName = device.description();
-#endif
+    // dataChanged was blocked as well, refresh the views once
+    if (m_keywords->rowCount() > 0)
+        emit m_keywords->dataChanged(m_keywords->index(0), m_keywords->index(m_keywords->rowCount() - 1));
 
-    if (m_audioEngine == nullptr)
-    {
-        // Get default audio input device
-        QString message = QString("Using audio input device: %1").arg(deviceName);
-        emit infoMessage(message);
-        qInfo("%s", qPrintable(message));
+    applyActiveKeywords();
+}
 
-        // Check whether the format is supported
-        if (!device.isFormatSupported(m_pvAudioFormat))
-        {
-            m_error = true;
-            m_errorMsg = "Default audio format is not supported.";
-            qCritical("%s", qPrintable(m_errorMsg));
-            emit errorChanged();
-            return false;
-        }
+///
+/// \brief Activates or deactivates a single keyword.
+/// \param row Row of the keywords model.
+/// \param active True to activate.
+///
+void QmlPorcupine::setKeywordActive(int row, bool active)
+{
+    m_keywords->setActive(row, active);
+}
 
-        // Instantiate QAudioInput with the settings
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-        m_audioEngine = new QAudioInput(device, m_pvAudioFormat, this);
-#else
-        m_audioEngine = new QAudioSource(device, m_pvAudioFormat, this);
-#endif
+///
+/// \brief Adds an engine running side by side with the primary one on the same stream.
+/// While listening the engine is started right away unless the engines are
+/// overloaded, otherwise with the next startListening(). Detections are reported
+/// by engineKeywordDetected() tagged with the engine name.
+/// \param tag Name of the engine.
+/// \param modelPath Model file, e.g. of another language.
+/// \param keywordsDir Directory of the keyword files of this engine.
+/// \param shadow True for an evaluation engine which is dropped first under load.
+/// \param libraryPath Optional runtime library, e.g. of a new release.
+/// \param priority Engines with lower priority are shed first under overload,
+/// after all shadow engines for a production engine, from priority 100 on an
+/// engine is never shed.
+///
+void QmlPorcupine::addEngine(const QString& tag,
+                             const QString& modelPath,
+                             const QString& keywordsDir,
+                             bool shadow,
+                             const QString& libraryPath,
+                             int priority)
+{
+    m_engineConfigs.append({tag, pvGetModelFile(modelPath), pvGetKeywordsDir(keywordsDir), libraryPath, shadow, priority});
+
+    if (m_porcupine != nullptr && (m_ioDevice != nullptr || m_recovering) && m_admission->admit(tag))
+        startEngine(m_engineConfigs.last());
+}
+
+///
+/// \brief Removes all engines added by addEngine(), takes effect with the next start.
+///
+void QmlPorcupine::clearEngines()
+{
+    m_engineConfigs.clear();
+}
+
+///
+/// \brief Gets the counters of the engines added by addEngine().
+/// \return One map per running engine.
+///
+QVariantList QmlPorcupine::engineCounters() const
+{
+    QVariantList list;
+
+    for (const auto& counters : m_fanout->counters())
+    {
+        QVariantMap map;
+        map.insert("tag", counters.tag);
+        map.insert("shadow", counters.role == PorcupineFanout::Shadow);
+        map.insert("packets", counters.packets);
+        map.insert("frames", counters.frames);
+        map.insert("dropped", counters.dropped);
+        map.insert("detections", counters.detections);
+        map.insert("backlog", counters.backlog);
+        map.insert("priority", counters.priority);
+        map.insert("gated", counters.shedding == PorcupineFanout::Gated);
+        map.insert("paused", counters.shedding == PorcupineFanout::Paused);
+        map.insert("shed", counters.shed);
+        list.append(map);
     }
 
-    // Start receiving data from audio input
-    m_ioDevice = m_audioEngine->start();
-    m_error = m_ioDevice == nullptr;
+    return list;
+}
 
-    if (m_error)
+//
+// Internal creates the additional engines, an engine failing to initialize is
+// reported and skipped, it never affects the primary engine.
+//
+void QmlPorcupine::startEngines()
+{
+    m_fanout->clear();
+
+    for (const auto& config : m_engineConfigs)
+        startEngine(config);
+}
+
+//
+// Internal creates and starts one additional engine.
+//
+bool QmlPorcupine::startEngine(const EngineConfig& config)
+{
+    const QVector<QString> files = m_keywordIndex.scan(config.keywordsDir);
+    QString errMsg;
+    Porcupine* engine = Porcupine::create(m_pvAccessKey,
+                                          files,
+                                          config.modelPath,
+                                          QVector<qreal>(files.size(), m_sensitivity),
+                                          &errMsg,
+                                          config.libraryPath);
+
+    if (engine == nullptr)
     {
-        m_errorMsg = QString("Cannot start device \"%0\": %1.")
-                     .arg(deviceName, AudioErrMsg[m_audioEngine->error()]);
-        qCritical("%s", qPrintable(m_errorMsg));
-        m_engineReady = false;
-        emit engineReadyChanged();
-        emit errorChanged();
+        emit infoMessage(QString("Engine \"%1\" not started: %2").arg(config.tag, errMsg));
         return false;
     }
 
-    QObject::connect(m_ioDevice, &QIODevice::readyRead, this, &QmlPorcupine::pvProcess);
-    m_porcupine->enable(true);
-    emit started();
+    if (engine->frameLength() != m_porcupine->frameLength() || engine->sampleRate() != m_porcupine->sampleRate())
+    {
+        emit infoMessage(QString("Engine \"%1\" not started: incompatible audio format.").arg(config.tag));
+        delete engine;
+        return false;
+    }
+
+    emit infoMessage(QString("Engine \"%1\" V%2 started%3.")
+                     .arg(config.tag, engine->version(), config.shadow ? " as shadow" : ""));
+    m_fanout->addEngine(config.tag,
+                        engine,
+                        config.shadow ? PorcupineFanout::Shadow : PorcupineFanout::Secondary,
+                        config.priority);
     return true;
 }
 
-void QmlPorcupine::stopListening()
+//
+// Internal replaces the running engine by one for the active keywords.
+//
+void QmlPorcupine::applyActiveKeywords()
 {
-    m_audioEngine->stop();
+    if (m_porcupine != nullptr && (m_ioDevice != nullptr || m_recovering))
+        reloadKeywords();
+}
 
-    if (m_ioDevice != nullptr)
-        QObject::disconnect(m_ioDevice, nullptr, nullptr, nullptr);
+QString QmlPorcupine::pvVersion() const
+{
+    return m_porcupine == nullptr ? QString() : m_porcupine->version();
+}
 
-    m_ioDevice = nullptr;
-    m_engineReady = false;
-    emit engineReadyChanged();
-    removePv();
-    emit infoMessage("Porcubine Instance deleted.");
-    emit stopped();
+qint32 QmlPorcupine::pvFrameLength() const
+{
+    return m_porcupine == nullptr ? -1 : m_porcupine->frameLength();
 }
 
-void QmlPorcupine::handleProcessError(const QString& errMsg)
+qint32 QmlPorcupine::pvSampleRate() const
 {
-    m_error = true;
-    m_errorMsg = errMsg;
-    qCritical("%s", qPrintable(m_errorMsg));
-    // In our test environment we stop further processing
-    QTimer* ti = new QTimer();
-    ti->setSingleShot(true);
-    ti->setInterval(20);
-    QObject::connect(ti, &QTimer::timeout, ti, [ti, this]()
+    return m_porcupine == nullptr ? -1 : m_porcupine->sampleRate();
+}
+
+int QmlPorcupine::inputPacketSize() const
+{
+    return m_inputPacketSize / 2;
+}
+
+void QmlPorcupine::setInputPacketSize(int size)
+{
+    if (m_inputPacketSize != size)
     {
-        stopListening();
-        delete ti;
-    });
-    ti->start();
-    emit errorChanged();
+        m_inputPacketSize = size;
+        emit inputPacketSizeChanged();
+    }
 }
 
-void QmlPorcupine::pvProcess()
+QmlPorcupine::DeliveryMode QmlPorcupine::deliveryMode() const
 {
-    if (m_error || m_audioEngine == nullptr)
-        return;
+    return m_deliveryMode;
+}
 
-    if (m_audioEngine->error() != QAudio::NoError)
+void QmlPorcupine::setDeliveryMode(DeliveryMode mode)
+{
+    if (m_deliveryMode != mode)
     {
-        handleProcessError(AudioErrMsg[m_audioEngine->error()]);
-        return;
+        m_deliveryMode = mode;
+        emit deliveryModeChanged();
     }
+}
 
-    QString errMsg;
-    int keywordsIndex;
-    QByteArray audioData = m_ioDevice->readAll();
-    setInputPacketSize(audioData.size());
-    bool success = m_porcupine->process(keywordsIndex, audioData.constData(), audioData.size(), &errMsg);
+int QmlPorcupine::framesPerPeriod() const
+{
+    return m_framesPerPeriod;
+}
 
-    if (success && keywordsIndex < 0)
-        return;
+void QmlPorcupine::setFramesPerPeriod(int frames)
+{
+    frames = qMax(1, frames);
 
-    if (success && keywordsIndex >= 0)
+    if (m_framesPerPeriod != frames)
     {
-        emit keyWordDetected(keywordsIndex);
+        m_framesPerPeriod = frames;
+        emit framesPerPeriodChanged();
     }
-    else
+}
+
+int QmlPorcupine::bufferPeriods() const
+{
+    return m_bufferPeriods;
+}
+
+void QmlPorcupine::setBufferPeriods(int periods)
+{
+    periods = qMax(2, periods);
+
+    if (m_bufferPeriods != periods)
     {
-        handleProcessError(errMsg);
+        m_bufferPeriods = periods;
+        emit bufferPeriodsChanged();
     }
 }
 
+int QmlPorcupine::maxLatencyFrames() const
+{
+    return m_maxLatencyFrames;
+}
 
-void QmlPorcupine::createKeywordsModel()
+void QmlPorcupine::setMaxLatencyFrames(int frames)
 {
-    QStringList keywords;
+    frames = qMax(1, frames);
 
-    for (const auto& file : m_pvKeyWordsFiles)
+    if (m_maxLatencyFrames != frames)
+    {
+        m_maxLatencyFrames = frames;
+        emit maxLatencyFramesChanged();
+    }
+}
+
+int QmlPorcupine::maxInputPacketSize() const
+{
+    return m_maxInputPacketSize / 2;
+}
+
+qreal QmlPorcupine::statsRate() const
+{
+    return m_statsRate;
+}
+
+///
+/// \brief Sets the rate at which statistics are published to QML.
+/// \param rate Publishing rate in Hz, limited to [0.1, 50].
+///
+void QmlPorcupine::setStatsRate(qreal rate)
+{
+    rate = qBound(0.1, rate, 50.0);
+
+    if (m_statsRate != rate)
     {
-        QFileInfo fi(file);
-        keywords.append(fi.baseName().split('_').at(0));
+        m_statsRate = rate;
+        m_statsTimer->setInterval(qRound(1000 / m_statsRate));
+        emit statsRateChanged();
     }
+}
+
+qreal QmlPorcupine::wakeUpsPerSecond() const
+{
+    return m_wakeUpsPerSecond;
+}
+
+qreal QmlPorcupine::framesPerSecond() const
+{
+    return m_framesPerSecond;
+}
+
+qint64 QmlPorcupine::detectionCount() const
+{
+    return m_detectionCount;
+}
+
+qreal QmlPorcupine::processLoad() const
+{
+    return m_processLoad;
+}
 
-    m_keywords->setStringList(keywords);
+qint64 QmlPorcupine::logDroppedRecords() const
+{
+    return PorcupineLog::instance().droppedRecords();
+}
+
+bool QmlPorcupine::overloaded() const
+{
+    return m_admission->overloaded();
+}
+
+///
+/// \brief Gets the processing load of the additional engines in busy cores.
+///
+qreal QmlPorcupine::engineLoad() const
+{
+    return m_admission->load();
+}
+
+qint64 QmlPorcupine::rejectedEngines() const
+{
+    return m_admission->rejectedEngines();
+}
+
+qint64 QmlPorcupine::sheddingDecisions() const
+{
+    return m_admission->sheddingDecisions();
+}
+
+bool QmlPorcupine::tracing() const
+{
+    return PorcupineTrace::enabled();
+}
+
+///
+/// \brief Records a timeline of capture, buffering and inference, see exportTrace().
+/// \param tracing True to start a new recording, false to stop it.
+///
+void QmlPorcupine::setTracing(bool tracing)
+{
+    if (tracing == PorcupineTrace::enabled())
+        return;
+
+    if (tracing)
+        PorcupineTrace::instance().start();
+    else
+        PorcupineTrace::instance().stop();
+
+    emit tracingChanged();
+}
+
+///
+/// \brief Stops tracing and writes the timeline as Chrome trace JSON.
+/// The file opens in chrome://tracing or ui.perfetto.dev.
+/// \param path Output file, a file URL or a local path.
+/// \return true on success otherwise false.
+///
+bool QmlPorcupine::exportTrace(const QString& path)
+{
+    QString errMsg;
+    const bool wasTracing = PorcupineTrace::enabled();
+    const bool success = PorcupineTrace::instance().exportChromeTrace(toNativePathSyntax(path), &errMsg);
+
+    if (!success)
+        emit infoMessage(errMsg);
+
+    if (wasTracing)
+        emit tracingChanged();
+
+    return success;
+}
+
+int QmlPorcupine::watchdogTimeout() const
+{
+    return m_watchdogTimeout;
+}
+
+///
+/// \brief Sets the time without audio data after which capture is reopened.
+/// Capture is also reopened on an audio device error. The engine stays
+/// initialized, only the audio source is recreated. 0 disables the watchdog,
+/// errors then stop listening, as does a pending recovery without an open device.
+/// \param ms Timeout in milliseconds, default 2000.
+///
+void QmlPorcupine::setWatchdogTimeout(int ms)
+{
+    ms = qMax(0, ms);
+
+    if (m_watchdogTimeout != ms)
+    {
+        m_watchdogTimeout = ms;
+
+        if (ms == 0)
+        {
+            m_watchdog->stop();
+
+            // Nothing would retry the recovery any more
+            if (m_recovering && m_ioDevice == nullptr)
+                handleProcessError("Capture recovery aborted, the watchdog was disabled");
+        }
+        else if (m_ioDevice != nullptr)
+        {
+            startWatchdog();
+        }
+
+        emit watchdogTimeoutChanged();
+    }
+}
+
+bool QmlPorcupine::recoverOnNextDevice() const
+{
+    return m_recoverOnNextDevice;
+}
+
+///
+/// \brief Reopens capture on the next available input device instead of the failed one.
+///
+void QmlPorcupine::setRecoverOnNextDevice(bool next)
+{
+    if (m_recoverOnNextDevice != next)
+    {
+        m_recoverOnNextDevice = next;
+        emit recoverOnNextDeviceChanged();
+    }
+}
+
+int QmlPorcupine::captureRecoveries() const
+{
+    return m_captureRecoveries;
+}
+
+///
+/// \brief Gets the audio gap of the last recovery, from the last data before
+/// the failure to the first data after reopening, in milliseconds.
+///
+qint64 QmlPorcupine::lastRecoveryMs() const
+{
+    return m_lastRecoveryMs;
+}
+
+int QmlPorcupine::udpPort() const
+{
+    return m_udpPort;
+}
+
+///
+/// \brief Sets the UDP port RTP audio packets are received on instead of
+/// capturing from an audio device, 0 for the audio device.
+/// Takes effect with the next startListening().
+///
+void QmlPorcupine::setUdpPort(int port)
+{
+    port = qBound(0, port, 65535);
+
+    if (m_udpPort != port)
+    {
+        m_udpPort = port;
+        emit udpPortChanged();
+    }
+}
+
+bool QmlPorcupine::udpRepeatLastFrame() const
+{
+    return m_udpRepeatLastFrame;
+}
+
+///
+/// \brief Conceals lost UDP packets by repeating the last frame instead of silence.
+///
+void QmlPorcupine::setUdpRepeatLastFrame(bool repeat)
+{
+    if (m_udpRepeatLastFrame != repeat)
+    {
+        m_udpRepeatLastFrame = repeat;
+
+        if (m_udpSource != nullptr)
+            m_udpSource->setConcealment(repeat ? JitterBuffer::RepeatLast : JitterBuffer::Silence);
+
+        emit udpRepeatLastFrameChanged();
+    }
+}
+
+///
+/// \brief Gets the number of UDP packets arriving after their samples were played out.
+///
+qint64 QmlPorcupine::udpLatePackets() const
+{
+    return m_udpSource != nullptr ? m_udpSource->counters().jitter.late : 0;
+}
+
+///
+/// \brief Gets the number of UDP packets missing at playout and concealed.
+///
+qint64 QmlPorcupine::udpLostPackets() const
+{
+    return m_udpSource != nullptr ? m_udpSource->counters().jitter.lost : 0;
+}
+
+qint64 QmlPorcupine::udpReorderedPackets() const
+{
+    return m_udpSource != nullptr ? m_udpSource->counters().jitter.reordered : 0;
+}
+
+///
+/// \brief Gets the current jitter buffer delay, the longest wait for a missing packet.
+///
+int QmlPorcupine::udpDelayMs() const
+{
+    return m_udpSource != nullptr ? m_udpSource->counters().jitter.delayMs : 0;
+}
+
+QmlPorcupine::CaptureBackend QmlPorcupine::captureBackend() const
+{
+    return m_captureBackend;
+}
+
+///
+/// \brief Sets where captured audio comes from, see CaptureBackend.
+/// Takes effect with the next startListening(), udpPort takes precedence.
+///
+void QmlPorcupine::setCaptureBackend(CaptureBackend backend)
+{
+    if (m_captureBackend != backend)
+    {
+        m_captureBackend = backend;
+        emit captureBackendChanged();
+    }
+}
+
+const QString& QmlPorcupine::alsaDevice() const
+{
+    return m_alsaDevice;
+}
+
+///
+/// \brief Sets the ALSA PCM captured with AlsaBackend, "default" by default.
+/// Any PCM name works, e.g. "hw:1,0", "plughw:1,0" or a "file" plugin
+/// defined in ~/.asoundrc. Takes effect with the next startListening().
+///
+void QmlPorcupine::setAlsaDevice(const QString& device)
+{
+    if (m_alsaDevice != device)
+    {
+        m_alsaDevice = device;
+        emit alsaDeviceChanged();
+    }
+}
+
+///
+/// \brief Checks whether the ALSA backend was built in.
+///
+bool QmlPorcupine::alsaAvailable() const
+{
+    return AlsaAudioSource::isAvailable();
+}
+
+///
+/// \brief Gets the ALSA overruns of the current capture, samples lost in the device.
+///
+qint64 QmlPorcupine::alsaOverruns() const
+{
+    return m_alsaSource != nullptr ? m_alsaSource->counters().overruns : 0;
+}
+
+QmlPorcupine::PipelineMode QmlPorcupine::pipelineMode() const
+{
+    return m_pipelineMode;
+}
+
+///
+/// \brief Sets how captured audio reaches the engine, see PipelineMode.
+/// Takes effect with the next startListening().
+///
+void QmlPorcupine::setPipelineMode(PipelineMode mode)
+{
+    if (m_pipelineMode != mode)
+    {
+        m_pipelineMode = mode;
+        emit pipelineModeChanged();
+    }
+}
+
+///
+/// \brief Gets the timing of the pipeline stages.
+/// \return One line per stage, empty with DirectProcessing.
+///
+QString QmlPorcupine::pipelineReport() const
+{
+    QStringList lines;
+
+    if (m_pipeline == nullptr)
+        return QString();
+
+    for (const auto& timing : m_pipeline->timings())
+    {
+        lines.append(QString("stage %1: frames %2, dropped %3, mean %4 us, max %5 us, backlog %6")
+                     .arg(timing.name)
+                     .arg(timing.frames)
+                     .arg(timing.dropped)
+                     .arg(timing.frames > 0 ? timing.processNs / 1e3 / timing.frames : 0, 0, 'f', 1)
+                     .arg(timing.maxNs / 1e3, 0, 'f', 1)
+                     .arg(timing.backlog));
+    }
+
+    lines.append(QString("pipeline: dropped %1 frames, pool exhausted %2 times")
+                 .arg(m_pipeline->droppedFrames())
+                 .arg(m_pipeline->pool()->exhausted()));
+    return lines.join('\n');
+}
+
+///
+/// \brief Gets the startup timing, from process start over QML load to the
+/// first engine initialization, see PorcupineStartup.
+///
+QString QmlPorcupine::startupReport() const
+{
+    return PorcupineStartup::report();
+}
+
+bool QmlPorcupine::perfProfiling() const
+{
+    return PorcupinePerf::enabled();
+}
+
+///
+/// \brief Profiles every engine frame with hardware counters (Linux only).
+/// If the counters are not permitted profiling stays off and the reason is reported.
+/// \param profiling True to profile, see perfReport().
+///
+void QmlPorcupine::setPerfProfiling(bool profiling)
+{
+    if (profiling == PorcupinePerf::enabled())
+        return;
+
+    QString errMsg;
+
+    if (!PorcupinePerf::enable(profiling, &errMsg))
+    {
+        PorcupineLog::instance().post(PorcupineLog::Warning, errMsg);
+        emit infoMessage(errMsg);
+        return;
+    }
+
+    emit perfProfilingChanged();
+}
+
+bool QmlPorcupine::memoryAccounting() const
+{
+    return PorcupineMemory::enabled();
+}
+
+///
+/// \brief Records the memory each engine adds while it is created, see memoryReport().
+/// Off by default, each creation then reads /proc/self/smaps_rollup twice.
+/// Engines created before it is switched on report no footprint.
+///
+void QmlPorcupine::setMemoryAccounting(bool accounting)
+{
+    if (accounting != PorcupineMemory::enabled())
+    {
+        PorcupineMemory::enable(accounting);
+        emit memoryAccountingChanged();
+    }
+}
+
+///
+/// \brief Gets IPC and misses per frame per engine and per thread.
+/// \return One line per engine and per profiled thread.
+///
+QString QmlPorcupine::perfReport() const
+{
+    QStringList lines;
+
+    if (m_porcupine != nullptr)
+        lines.append(QString("engine primary: %1").arg(m_porcupine->perfCounters().format()));
+
+    for (const auto& counters : m_fanout->counters())
+        lines.append(QString("engine %1: %2").arg(counters.tag, counters.perf.format()));
+
+    for (const auto& thread : PorcupinePerf::threadCounters())
+        lines.append(QString("thread %1: %2").arg(thread.first, thread.second.format()));
+
+    return lines.join('\n');
+}
+
+///
+/// \brief Gets the memory of the process and what each engine instance added.
+/// \return One line for the process and one per engine with its creation
+/// delta, recorded with memoryAccounting on, and audio buffer size.
+///
+QString QmlPorcupine::memoryReport() const
+{
+    QStringList lines;
+    lines.append(QString("process: %1").arg(PorcupineMemory::sample().format()));
+
+    if (m_porcupine != nullptr)
+        lines.append(QString("engine primary: %1, buffer %2")
+                     .arg(m_porcupine->memoryFootprint().format(),
+                          PorcupineMemory::formatBytes(m_porcupine->bufferBytes())));
+
+    for (const auto& counters : m_fanout->counters())
+        lines.append(QString("engine %1: %2, buffer %3")
+                     .arg(counters.tag, counters.memory.format(), PorcupineMemory::formatBytes(counters.bufferBytes)));
+
+    return lines.join('\n');
+}
+
+///
+/// \brief Reports the detections of all engines to sink in addition to the signals.
+/// Detections of the primary engine are reported on the capture thread, or on
+/// the stage thread of a ThreadedPipeline, those of additional engines on their
+/// worker threads, e.g. to an AwaitableDetector.
+/// \param sink The sink, not owned, nullptr to stop reporting.
+///
+void QmlPorcupine::setDetectionSink(DetectionSink* sink)
+{
+    m_detectionBus->setForward(sink);
+}
+
+///
+/// \brief Gets the bus all engines publish their detections to.
+/// Consumers subscribe with their own backlog limit and take detections on
+/// their own thread, see DetectionBus. Owned by this object.
+///
+DetectionBus* QmlPorcupine::detectionBus() const
+{
+    return m_detectionBus;
+}
+
+bool QmlPorcupine::error() const
+{
+    return m_error;
+}
+
+bool QmlPorcupine::engineReady() const
+{
+    return m_engineReady;
+}
+
+
+const QString& QmlPorcupine::errorMsg() const
+{
+    return m_errorMsg;
+}
+
+void QmlPorcupine::initPv()
+{
+    m_engineReady = false;
+    QElapsedTimer initClock;
+    initClock.start();
+    m_activeFiles = activeKeywordFiles(m_pvKeyWordsFiles);
+    m_porcupine = takeWarmEngine(engineSignature(m_activeFiles));
+
+    if (m_porcupine == nullptr)
+    {
+        // Let the page cache load model and keywords while the runtime library is loaded
+        KeywordIndex::prefetch(QVector<QString>(m_activeFiles) << m_pvModelPath);
+        QVector<qreal> sensitivities = QVector<qreal>(m_activeFiles.size(), m_sensitivity);
+        m_porcupine = Porcupine::create(m_pvAccessKey,
+                                        m_activeFiles,
+                                        m_pvModelPath,
+                                        sensitivities,
+                                        &m_errorMsg);
+    }
+
+    m_engineSensitivity = m_sensitivity;
+
+    m_error = m_porcupine == nullptr;
+    m_metrics->setInitTime(initClock.elapsed());
+    emit infoMessage(QString("Engine initialization took %1 ms").arg(initClock.elapsed()));
+
+    if (m_error)
+    {
+        emit errorChanged();
+    }
+    else
+    {
+        QString message = QString("Porcubine V%1 successfull initialized").arg(m_porcupine->version());
+        emit infoMessage(message);
+        m_pvAudioFormat = preferredAudioFormat(m_porcupine->sampleRate());
+        createKeywordsModel();
+        updateActiveRows();
+    }
+
+    m_engineReady = !m_error;
+    emit engineReadyChanged();
+    return;
+}
+
+//
+// Internal starts the engine warm-up for the current configuration, unless
+// an engine exists, a warm-up is running or the configuration is incomplete.
+//
+void QmlPorcupine::startWarmUp()
+{
+    if (!m_warmUp || m_porcupine != nullptr || !m_warmUpSignature.isEmpty())
+        return;
+
+    const QVector<QString> active = activeKeywordFiles(m_pvKeyWordsFiles);
+
+    if (m_pvAccessKey.isEmpty() || m_pvModelPath.isEmpty() || active.isEmpty())
+        return;
+
+    const QString accessKey = m_pvAccessKey;
+    const QString modelPath = m_pvModelPath;
+    const QVector<qreal> sensitivities(active.size(), m_sensitivity);
+    m_warmUpSignature = engineSignature(active);
+    emit infoMessage("Engine warm-up started");
+
+    m_warmUpBuild->setFuture(QtConcurrent::run([accessKey, active, modelPath, sensitivities]()
+    {
+        KeywordIndex::prefetch(QVector<QString>(active) << modelPath);
+        QString errMsg;
+        Porcupine* porcupine = Porcupine::create(accessKey, active, modelPath, sensitivities, &errMsg);
+        return qMakePair(porcupine, errMsg);
+    }));
+}
+
+//
+// Internal takes the engine of the warm-up, waiting for it if still running.
+// Returns nullptr without warm-up, if it failed, or if it was made for another
+// configuration than signature; such an engine is deleted, a running warm-up
+// of another configuration is discarded without waiting.
+//
+Porcupine* QmlPorcupine::takeWarmEngine(const QStringList& signature)
+{
+    if (m_warmUpSignature.isEmpty())
+        return nullptr;
+
+    const bool matches = m_warmUpSignature == signature;
+    m_warmUpSignature.clear();
+
+    if (!matches && !m_warmUpBuild->future().isFinished())
+    {
+        discardWarmUp();
+        return nullptr;
+    }
+
+    m_warmUpBuild->waitForFinished();
+    const EngineBuild build = m_warmUpBuild->result();
+
+    if (build.first != nullptr && matches)
+    {
+        emit infoMessage("Using the warmed up engine");
+        return build.first;
+    }
+
+    if (build.first == nullptr && !signature.isEmpty())
+        emit infoMessage(QString("Engine warm-up failed: %1").arg(build.second));
+
+    delete build.first;
+    return nullptr;
+}
+
+//
+// Internal leaves the running warm-up to delete its engine once it finished,
+// the next warm-up gets a new watcher.
+//
+void QmlPorcupine::discardWarmUp()
+{
+    QFutureWatcher<EngineBuild>* build = m_warmUpBuild;
+    m_warmUpBuild = new QFutureWatcher<EngineBuild>(this);
+    m_discardedWarmUps.append(build);
+
+    // Not finished yet, so the signal is still to come
+    QObject::connect(build, &QFutureWatcher<EngineBuild>::finished, this, [this, build]()
+    {
+        m_discardedWarmUps.removeOne(build);
+        delete build->result().first;
+        build->deleteLater();
+    });
+}
+
+//
+// Internal identifies an engine configuration, to match a warmed up engine.
+//
+QStringList QmlPorcupine::engineSignature(const QVector<QString>& files) const
+{
+    QStringList signature = {m_pvAccessKey, m_pvModelPath, QString::number(m_sensitivity)};
+
+    for (const auto& file : files)
+        signature.append(file);
+
+    return signature;
+}
+
+void QmlPorcupine::removePv()
+{
+    clearEngineCache();
+    delete m_porcupine;
+    m_porcupine = nullptr;
+    m_engineReady = false;
+    return;
+}
+
+bool QmlPorcupine::startListening()
+{
+    initPv();
+
+    if (!m_engineReady)
+        return false;
+
+    m_errorMsg = QString();
+    m_error = false;
+    m_recovering = false;
+
+    if (!openCapture(QString(), &m_errorMsg))
+    {
+        m_error = true;
+        PorcupineLog::instance().post(PorcupineLog::Critical, m_errorMsg);
+        m_engineReady = false;
+        emit engineReadyChanged();
+        emit errorChanged();
+        return false;
+    }
+
+    m_stats.reset();
+    m_detectionCount = 0;
+    m_streamSamples = 0;
+    m_engineVersion = m_porcupine->version().toLatin1();
+    // Identifies this listening session in the journal, also across runs
+    m_streamId = qMax(m_streamId + 1, quint32(QDateTime::currentSecsSinceEpoch()));
+    openJournal();
+    m_statsClock.start();
+    m_statsTimer->start();
+    m_porcupine->enable(true);
+
+    if (m_pipelineMode != DirectProcessing)
+        buildPipeline();
+
+    startEngines();
+    m_admission->start();
+    emit started();
+    return true;
+}
+
+//
+// Internal opens the journal of journalDir unless it is open or disabled.
+//
+void QmlPorcupine::openJournal()
+{
+    if (m_journalDir.isEmpty() || m_journal != nullptr)
+        return;
+
+    QString errMsg;
+    m_journal = new DetectionJournal(m_journalDir);
+
+    if (!m_journal->open(&errMsg))
+    {
+        PorcupineLog::instance().post(PorcupineLog::Warning, errMsg);
+        emit infoMessage(errMsg);
+        delete m_journal;
+        m_journal = nullptr;
+    }
+}
+
+void QmlPorcupine::stopListening()
+{
+    m_statsTimer->stop();
+    closeCapture();
+    m_recovering = false;
+    m_engineReady = false;
+    emit engineReadyChanged();
+    m_admission->stop();
+    deletePipeline();
+    m_fanout->clear();
+    removePv();
+    emit infoMessage("Porcubine Instance deleted.");
+    emit stopped();
+}
+
+void QmlPorcupine::handleProcessError(const QString& errMsg)
+{
+    m_error = true;
+    m_errorMsg = errMsg;
+    PorcupineLog::instance().post(PorcupineLog::Critical, m_errorMsg);
+    // In our test environment we stop further processing
+    QTimer* ti = new QTimer();
+    ti->setSingleShot(true);
+    ti->setInterval(20);
+    QObject::connect(ti, &QTimer::timeout, ti, [ti, this]()
+    {
+        stopListening();
+        delete ti;
+    });
+    ti->start();
+    emit errorChanged();
+}
+
+void QmlPorcupine::pvProcess()
+{
+    if (m_error || m_ioDevice == nullptr)
+        return;
+
+    const QString deviceError = m_audioEngine != nullptr && m_audioEngine->error() != QAudio::NoError
+                                ? AudioErrMsg[m_audioEngine->error()]
+                                : m_alsaSource != nullptr && m_alsaSource->failed()
+                                  ? m_alsaSource->errorString()
+                                  : QString();
+
+    if (!deviceError.isEmpty())
+    {
+        m_metrics->addDeviceError();
+
+        if (m_watchdogTimeout > 0)
+            recoverCapture(deviceError);
+        else
+            handleProcessError(deviceError);
+
+        return;
+    }
+
+    if (m_pipeline != nullptr)
+    {
+        pvProcessPipeline();
+        return;
+    }
+
+    PV_TRACE_SCOPE("pvProcess");
+    QElapsedTimer processClock;
+    processClock.start();
+
+    // errMsg stays a null string unless processing fails
+    QString errMsg;
+    bool success = true;
+    int keywordsIndex = -1;
+    qint64 packetBytes = 0;
+    int frames = 0;
+    qint64 backlogBytes = 0;
+    qint64 remaining = std::numeric_limits<qint64>::max();
+    const qint64 capacity = m_readBuffer.size();
+    qint64 bytesRead = 0;
+    qint64 bytesToRead = 0;
+
+    if (m_deliveryMode != OnReadyRead)
+    {
+        // Only hand over whole Porcupine frames, the rest stays in the device
+        const qint64 frameBytes = m_porcupine->bytesFrameLength();
+        backlogBytes = m_ioDevice->bytesAvailable();
+        remaining = backlogBytes - backlogBytes % frameBytes;
+    }
+
+    // Read into the preallocated buffer, no QByteArray is created per packet
+    do
+    {
+        bytesToRead = qMin(capacity, remaining);
+        const qint64 readStartNs = PorcupineTrace::enabled() ? PorcupineTrace::now() : 0;
+        bytesRead = bytesToRead > 0 ? m_ioDevice->read(m_readBuffer.data(), bytesToRead) : 0;
+
+        if (readStartNs != 0)
+            PorcupineTrace::instance().complete("device.read", readStartNs, PorcupineTrace::now() - readStartNs, bytesRead);
+
+        if (bytesRead <= 0)
+            break;
+
+        success = m_porcupine->process(keywordsIndex, m_readBuffer.constData(), int(bytesRead), &errMsg);
+        // Never waits on shadow engines, see PorcupineFanout::dispatch
+        m_fanout->dispatch(m_readBuffer.constData(), int(bytesRead));
+        packetBytes += bytesRead;
+        frames += m_porcupine->framesProcessed();
+        m_streamSamples += qint64(m_porcupine->framesProcessed()) * m_porcupine->frameLength();
+        remaining -= bytesRead;
+    }
+    while (success && keywordsIndex < 0 && bytesRead == bytesToRead && remaining > 0);
+
+    if (m_deliveryMode == Adaptive && success && m_audioEngine != nullptr)
+        adaptDeliveryPeriod(backlogBytes, keywordsIndex >= 0);
+
+    if (packetBytes > 0)
+        captureDataArrived();
+
+    const qint64 processNs = processClock.nsecsElapsed();
+    m_stats.addPacket(packetBytes, frames, processNs);
+    m_metrics->observeFrames(frames, processNs);
+    m_metrics->setBacklog(m_ioDevice->bytesAvailable());
+
+    if (success && keywordsIndex < 0)
+        return;
+
+    if (success && keywordsIndex >= 0)
+    {
+        const int row = m_activeRows.value(keywordsIndex, keywordsIndex);
+        m_detectionBus->detected(QString(), row, m_streamSamples / m_porcupine->frameLength());
+        reportDetection(row, m_streamSamples);
+    }
+    else
+        handleProcessError(errMsg);
+}
+
+//
+// Internal pumps the device through the pipeline, the stages report detections.
+// Threaded, processNs only covers reading the device and queueing the frames.
+//
+void QmlPorcupine::pvProcessPipeline()
+{
+    PV_TRACE_SCOPE("pvProcess");
+    QElapsedTimer processClock;
+    processClock.start();
+    const qint64 bytesBefore = m_pipelineSource->bytesRead();
+    const int frames = m_pipeline->pump();
+    const qint64 packetBytes = m_pipelineSource->bytesRead() - bytesBefore;
+
+    if (packetBytes > 0)
+        captureDataArrived();
+
+    const qint64 processNs = processClock.nsecsElapsed();
+    m_stats.addPacket(packetBytes, frames, processNs);
+    m_metrics->observeFrames(frames, processNs);
+    m_metrics->setBacklog(m_ioDevice->bytesAvailable());
+
+    if (m_pipelineEngine->failed())
+        handleProcessError(m_pipelineEngine->errorMessage());
+}
+
+//
+// Internal notes audio data for the watchdog and completes a pending recovery.
+//
+void QmlPorcupine::captureDataArrived()
+{
+    if (m_recovering)
+    {
+        m_recovering = false;
+        m_lastRecoveryMs = m_lastDataClock.elapsed();
+        ++m_captureRecoveries;
+        m_metrics->addRecovery(m_lastRecoveryMs);
+        PorcupineLog::instance().post(PorcupineLog::Info, QString("Capture recovered after %1 ms").arg(m_lastRecoveryMs));
+        emit captureRecovered();
+    }
+
+    m_lastDataClock.restart();
+}
+
+//
+// Internal reports a detection of the primary engine on this thread, the caller
+// already published it to the detection bus.
+// row is the keywords model row of the engine's keyword index, mapped through
+// m_activeRows by the caller, streamSamples the stream position after the frame.
+//
+void QmlPorcupine::reportDetection(int row, qint64 streamSamples)
+{
+    m_stats.addDetection();
+    m_metrics->addDetection(row);
+
+    if (m_journal != nullptr)
+        m_journal->append(m_streamId, row, streamSamples, m_engineVersion.constData());
+
+    PV_TRACE_INSTANT("keyWordDetected", row);
+    emit keyWordDetected(row);
+}
+
+//
+// Internal builds source, fan-out, engine and detection stages on the capture device.
+//
+void QmlPorcupine::buildPipeline()
+{
+    m_pipeline = new AudioPipeline(m_porcupine->frameLength());
+    m_pipelineSource = new DeviceSource(m_ioDevice);
+    m_pipeline->setSource(m_pipelineSource);
+    m_pipeline->addStage(new FanoutStage(m_fanout));
+    m_pipelineEngine = new PorcupineStage(m_porcupine);
+    m_pipeline->addStage(m_pipelineEngine);
+    // Built once per listening session, restarts of the pipeline keep it
+    const quint32 streamId = m_streamId;
+    m_pipeline->addStage(new CallbackStage("detections", [this, streamId](const AudioFrame& frame)
+    {
+        if (frame.keywordIndex < 0)
+            return;
+
+        // Mapped with the engine that detected it: m_activeRows only changes
+        // while the pipeline is stopped, a queued detection may outlive it
+        const int row = m_activeRows.value(frame.keywordIndex, frame.keywordIndex);
+        const qint64 streamSamples = frame.position + frame.length;
+        // The bus never blocks, its subscribers get the detection without
+        // waiting for this thread's event loop
+        m_detectionBus->detected(QString(), row, streamSamples / frame.length);
+        // Called directly inline, queued to this thread from a stage thread
+        QMetaObject::invokeMethod(this, [this, streamId, row, streamSamples]()
+        {
+            // Still queued after stop(), dropped once a new session started
+            if (m_porcupine != nullptr && m_streamId == streamId)
+                reportDetection(row, streamSamples);
+        });
+    }));
+    m_pipeline->start(m_pipelineMode == ThreadedPipeline ? AudioPipeline::Threaded : AudioPipeline::Inline);
+}
+
+void QmlPorcupine::deletePipeline()
+{
+    delete m_pipeline;
+    m_pipeline = nullptr;
+    m_pipelineSource = nullptr;
+    m_pipelineEngine = nullptr;
+}
+
+//
+// Internal creates the audio source on the named input device, the default
+// device if empty or gone, and starts capturing into the warm engine.
+//
+bool QmlPorcupine::openCapture(const QString& deviceName, QString* errMsg)
+{
+    if (m_udpPort > 0)
+        return openUdpCapture(errMsg);
+
+    if (m_captureBackend == AlsaBackend)
+        return openAlsaCapture(errMsg);
+
+    AudioDevice device = defaultAudioInput();
+
+    for (const auto& input : audioInputs())
+    {
+        if (audioDeviceName(input) == deviceName)
+        {
+            device = input;
+            break;
+        }
+    }
+
+    const QString name = audioDeviceName(device);
+    QString message = QString("Using audio input device: %1").arg(name);
+    emit infoMessage(message);
+    PorcupineLog::instance().post(PorcupineLog::Info, message);
+
+    // Check whether the format is supported
+    if (!device.isFormatSupported(m_pvAudioFormat))
+    {
+        *errMsg = QString("Audio format is not supported by \"%1\".").arg(name);
+        return false;
+    }
+
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    m_audioEngine = new QAudioInput(device, m_pvAudioFormat, this);
+#else
+    m_audioEngine = new QAudioSource(device, m_pvAudioFormat, this);
+#endif
+    configureCapture();
+
+    // Start receiving data from audio input
+    m_ioDevice = m_audioEngine->start();
+
+    if (m_ioDevice == nullptr)
+    {
+        *errMsg = QString("Cannot start device \"%0\": %1.").arg(name, AudioErrMsg[m_audioEngine->error()]);
+        delete m_audioEngine;
+        m_audioEngine = nullptr;
+        return false;
+    }
+
+    m_deviceName = name;
+
+    if (m_pipelineSource != nullptr)
+        m_pipelineSource->setDevice(m_ioDevice);
+
+    if (m_deliveryMode == OnReadyRead)
+        QObject::connect(m_ioDevice, &QIODevice::readyRead, this, &QmlPorcupine::pvProcess);
+    else
+        m_deliveryTimer->start(frameDurationMs(m_currentPeriodFrames));
+
+    // Sized when capture opens, so reading audio data does not allocate
+    const qint64 readSize = qMax(qint64(m_audioEngine->bufferSize()), qint64(8 * m_porcupine->bytesFrameLength()));
+
+    if (m_readBuffer.size() < readSize)
+        m_readBuffer.resize(int(readSize));
+
+    if (!m_recovering)
+        m_lastDataClock.start();
+
+    startWatchdog();
+
+    return true;
+}
+
+//
+// Internal receives RTP packets instead of capturing, see UdpAudioSource.
+// Frames are always handed over on readyRead, there is no device to watch.
+//
+bool QmlPorcupine::openUdpCapture(QString* errMsg)
+{
+    m_udpSource = new UdpAudioSource(m_porcupine->sampleRate(), m_porcupine->frameLength(), this);
+    m_udpSource->setConcealment(m_udpRepeatLastFrame ? JitterBuffer::RepeatLast : JitterBuffer::Silence);
+
+    if (!m_udpSource->listen(quint16(m_udpPort), QHostAddress::Any, errMsg))
+    {
+        delete m_udpSource;
+        m_udpSource = nullptr;
+        return false;
+    }
+
+    const QString message = QString("Receiving RTP audio on UDP port %1").arg(m_udpPort);
+    emit infoMessage(message);
+    PorcupineLog::instance().post(PorcupineLog::Info, message);
+    m_deviceName = QString("udp:%1").arg(m_udpPort);
+    m_ioDevice = m_udpSource;
+
+    if (m_pipelineSource != nullptr)
+        m_pipelineSource->setDevice(m_ioDevice);
+
+    QObject::connect(m_ioDevice, &QIODevice::readyRead, this, &QmlPorcupine::pvProcess);
+
+    const qint64 readSize = 8 * m_porcupine->bytesFrameLength();
+
+    if (m_readBuffer.size() < readSize)
+        m_readBuffer.resize(int(readSize));
+
+    m_lastDataClock.start();
+    return true;
+}
+
+//
+// Internal captures from an ALSA PCM instead of QtMultimedia, see AlsaAudioSource.
+// Every period is one engine frame, so frames are handed over on readyRead.
+//
+bool QmlPorcupine::openAlsaCapture(QString* errMsg)
+{
+    m_alsaSource = new AlsaAudioSource(m_porcupine->sampleRate(), m_porcupine->frameLength(), this);
+
+    if (!m_alsaSource->start(m_alsaDevice, m_bufferPeriods, errMsg))
+    {
+        delete m_alsaSource;
+        m_alsaSource = nullptr;
+        return false;
+    }
+
+    const AlsaAudioSource::Counters counters = m_alsaSource->counters();
+    const QString message = QString("Using ALSA device: %1, period %2, buffer %3 samples")
+                            .arg(m_alsaDevice).arg(counters.periodFrames).arg(counters.bufferFrames);
+    emit infoMessage(message);
+    PorcupineLog::instance().post(PorcupineLog::Info, message);
+    m_deviceName = QString("alsa:%1").arg(m_alsaDevice);
+    m_ioDevice = m_alsaSource;
+
+    if (m_pipelineSource != nullptr)
+        m_pipelineSource->setDevice(m_ioDevice);
+
+    QObject::connect(m_ioDevice, &QIODevice::readyRead, this, &QmlPorcupine::pvProcess);
+
+    const qint64 readSize = 8 * m_porcupine->bytesFrameLength();
+
+    if (m_readBuffer.size() < readSize)
+        m_readBuffer.resize(int(readSize));
+
+    if (!m_recovering)
+        m_lastDataClock.start();
+
+    startWatchdog();
+
+    return true;
+}
+
+//
+// Internal stops and deletes the audio source, the engine is not touched.
+//
+void QmlPorcupine::closeCapture()
+{
+    m_deliveryTimer->stop();
+    m_watchdog->stop();
+
+    if (m_ioDevice != nullptr)
+        QObject::disconnect(m_ioDevice, nullptr, nullptr, nullptr);
+
+    m_ioDevice = nullptr;
+
+    if (m_pipelineSource != nullptr)
+        m_pipelineSource->setDevice(nullptr);
+
+    if (m_udpSource != nullptr)
+    {
+        m_udpSource->close();
+        m_udpSource->deleteLater();
+        m_udpSource = nullptr;
+    }
+
+    if (m_alsaSource != nullptr)
+    {
+        m_alsaSource->close();
+        m_alsaSource->deleteLater();
+        m_alsaSource = nullptr;
+    }
+
+    if (m_audioEngine != nullptr)
+    {
+        m_audioEngine->stop();
+        // May be called from one of its signals
+        m_audioEngine->deleteLater();
+        m_audioEngine = nullptr;
+    }
+}
+
+//
+// Internal reopens capture after a device error or stall. The engine and its
+// buffered audio stay as they are. If no device can be opened the watchdog
+// retries on its next tick.
+//
+void QmlPorcupine::recoverCapture(const QString& reason)
+{
+    if (!m_recovering)
+    {
+        m_recovering = true;
+        const QString message = QString("Capture on \"%1\" failed: %2").arg(m_deviceName, reason);
+        PorcupineLog::instance().post(PorcupineLog::Warning, message);
+        emit infoMessage(message);
+        emit captureFailed(reason);
+    }
+
+    const QString failed = m_deviceName;
+    closeCapture();
+    QStringList candidates;
+
+    if (m_captureBackend == AlsaBackend)
+    {
+        // The ALSA PCM is named, there is nothing to fall back to
+        candidates.append(m_alsaDevice);
+    }
+    else
+    {
+        for (const auto& input : audioInputs())
+            candidates.append(audioDeviceName(input));
+
+        if (m_recoverOnNextDevice && candidates.contains(failed))
+        {
+            // The devices after the failed one first, the failed one last
+            const int index = candidates.indexOf(failed);
+            candidates = candidates.mid(index + 1) + candidates.mid(0, index + 1);
+        }
+        else
+        {
+            candidates.removeAll(failed);
+            candidates.prepend(failed);
+        }
+    }
+
+    QString errMsg;
+
+    for (const auto& candidate : candidates)
+    {
+        if (openCapture(candidate, &errMsg))
+            return;
+
+        PorcupineLog::instance().post(PorcupineLog::Warning, errMsg);
+    }
+
+    startWatchdog();
+}
+
+//
+// Internal starts the watchdog unless it is disabled. It ticks at half the
+// timeout, so a stall is noticed within 1.5 times watchdogTimeout.
+//
+void QmlPorcupine::startWatchdog()
+{
+    if (m_watchdogTimeout > 0)
+        m_watchdog->start(qMax(1, m_watchdogTimeout / 2));
+}
+
+//
+// Watchdog: reopens capture on a device error, a stall of watchdogTimeout or
+// a pending recovery.
+//
+void QmlPorcupine::checkCapture()
+{
+    if (m_porcupine == nullptr || m_error || m_udpSource != nullptr)
+        return;
+
+    if (m_alsaSource != nullptr && m_alsaSource->failed())
+        recoverCapture(m_alsaSource->errorString());
+    else if (m_audioEngine == nullptr && m_alsaSource == nullptr)
+        recoverCapture("No audio input device available");
+    else if (m_audioEngine != nullptr && m_audioEngine->error() != QAudio::NoError)
+        recoverCapture(AudioErrMsg[m_audioEngine->error()]);
+    else if (m_lastDataClock.elapsed() > m_watchdogTimeout)
+        recoverCapture(QString("No audio data for %1 ms").arg(m_lastDataClock.elapsed()));
+}
+
+//
+// Applies device buffer size and delivery period before the audio source is started.
+// Sizes are multiples of the Porcupine frame, so each wake-up hands over whole frames.
+//
+void QmlPorcupine::configureCapture()
+{
+    m_currentPeriodFrames = m_framesPerPeriod;
+
+    if (m_deliveryMode == OnReadyRead)
+        return;
+
+    const int periodFrames = m_deliveryMode == Adaptive
+                             ? qMax(m_framesPerPeriod, m_maxLatencyFrames)
+                             : m_framesPerPeriod;
+    m_audioEngine->setBufferSize(m_bufferPeriods * periodFrames * m_porcupine->bytesFrameLength());
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    // Delivery is driven by our own timer, keep the device notifications rare
+    m_audioEngine->setNotifyInterval(frameDurationMs(m_bufferPeriods * periodFrames));
+#endif
+    QString message = QString("Capture buffer %1 bytes, delivery period %2 ms")
+                      .arg(m_audioEngine->bufferSize())
+                      .arg(frameDurationMs(m_currentPeriodFrames));
+    emit infoMessage(message);
+}
+
+//
+// Adaptive delivery: lengthen the period by one frame per quiet wake-up up to
+// maxLatencyFrames, fall back to framesPerPeriod on a detection or when the
+// device backlog exceeds half of its buffer.
+//
+void QmlPorcupine::adaptDeliveryPeriod(qint64 backlogBytes, bool detected)
+{
+    int periodFrames = m_currentPeriodFrames;
+
+    if (detected || backlogBytes > m_audioEngine->bufferSize() / 2)
+        periodFrames = m_framesPerPeriod;
+    else if (periodFrames < m_maxLatencyFrames)
+        ++periodFrames;
+
+    if (periodFrames != m_currentPeriodFrames)
+    {
+        m_currentPeriodFrames = periodFrames;
+        m_deliveryTimer->setInterval(frameDurationMs(periodFrames));
+    }
+}
+
+int QmlPorcupine::frameDurationMs(int frames) const
+{
+    if (m_porcupine == nullptr)
+        return 0;
+
+    return qMax(1, int(qint64(frames) * m_porcupine->frameLength() * 1000 / m_porcupine->sampleRate()));
+}
+
+//
+// Publishes the statistics accumulated since the last call as one consolidated
+// update, so QML bindings are re-evaluated at statsRate and not per audio packet.
+//
+void QmlPorcupine::publishStats()
+{
+    const qint64 elapsedNs = m_statsClock.nsecsElapsed();
+    m_statsClock.restart();
+
+    if (elapsedNs <= 0)
+        return;
+
+    const PorcupineStats::Snapshot snap = m_stats.snapshot(elapsedNs);
+    m_wakeUpsPerSecond = snap.wakeUps * 1e9 / elapsedNs;
+    m_framesPerSecond = snap.frames * 1e9 / elapsedNs;
+    m_processLoad = qreal(snap.processNs) / elapsedNs;
+    m_detectionCount += snap.detections;
+    m_maxInputPacketSize = int(snap.maxPacketBytes);
+
+    if (snap.packets > 0)
+        setInputPacketSize(int(snap.packetBytes / snap.packets));
+
+    m_metrics->setEngineCounters(m_fanout->counters(), m_fanout->skippedPackets());
+    m_metrics->setBusCounters(m_detectionBus->counters());
+
+    if (m_udpSource != nullptr)
+        m_metrics->setJitterCounters(m_udpSource->counters().jitter);
+
+    emit statsChanged();
+}
+
+void QmlPorcupine::createKeywordsModel()
+{
+    QStringList keywords;
+    QStringList files;
+
+    for (const auto& file : m_pvKeyWordsFiles)
+    {
+        keywords.append(pvGetKeywordName(file));
+        files.append(file);
+    }
+
+    // Keyed by file, different files may carry the same keyword name
+    m_keywords->setKeywords(keywords, files);
+}
+
+//
+// Internal lists the valid keyword files of the keywords directory through the
+// persistent index, rejected files are reported and the index is saved.
+//
+QVector<QString> QmlPorcupine::scanKeywords()
+{
+    QElapsedTimer scanClock;
+    scanClock.start();
+    const int hits = m_keywordIndex.hits();
+    QVector<QString> rejected;
+    QVector<QString> files = m_keywordIndex.scan(pvGetKeywordsDir(m_pvKeyWordsDir), &rejected);
+
+    for (const auto& file : rejected)
+        emit infoMessage(QString("Ignoring invalid keyword file \"%1\"").arg(file));
+
+    m_keywordIndex.save();
+    PorcupineLog::instance().post(PorcupineLog::Info,
+                                  QString("Keyword scan: %1 files, %2 from index, %3 ms")
+                                  .arg(files.size() + rejected.size())
+                                  .arg(m_keywordIndex.hits() - hits)
+                                  .arg(scanClock.elapsed()));
+    return files;
+}
+
+//
+// Internal brings the keywords model in line with files by removing and inserting
+// single rows. Surviving files keep their rows, new files are appended.
+//
+void QmlPorcupine::updateKeywordsModel(const QVector<QString>& files)
+{
+    for (int row = m_pvKeyWordsFiles.size() - 1; row >= 0; --row)
+    {
+        if (!files.contains(m_pvKeyWordsFiles.at(row)))
+        {
+            m_keywords->removeRows(row, 1);
+            m_pvKeyWordsFiles.remove(row);
+        }
+    }
+
+    for (const auto& file : files)
+    {
+        if (!m_pvKeyWordsFiles.contains(file))
+        {
+            const int row = m_keywords->rowCount();
+            m_keywords->insertRows(row, 1);
+            m_keywords->setData(m_keywords->index(row), pvGetKeywordName(file));
+            m_keywords->setKey(row, file);
+            m_pvKeyWordsFiles.append(file);
+        }
+    }
+}
+
+void QmlPorcupine::updateKeywordsWatcher()
+{
+    const QStringList watched = m_keywordsWatcher->files() + m_keywordsWatcher->directories();
+
+    if (!watched.isEmpty())
+        m_keywordsWatcher->removePaths(watched);
+
+    if (!m_watchKeywords || m_pvKeyWordsDir.isEmpty())
+        return;
+
+    m_keywordsWatcher->addPath(m_pvKeyWordsDir);
+
+    for (const auto& file : m_pvKeyWordsFiles)
+        m_keywordsWatcher->addPath(file);
+}
+
+//
+// Rescans the keywords directory. Without a running engine only the model is
+// updated, otherwise a new engine is validated and built on a worker thread.
+//
+void QmlPorcupine::reloadKeywords()
+{
+    if (m_engineBuild->isRunning())
+    {
+        m_reloadPending = true;
+        return;
+    }
+
+    QVector<QString> found = scanKeywords();
+    std::sort(found.begin(), found.end());
+    KeywordStamps stamps;
+    QVector<QString> files;
+    bool changed = false;
+
+    for (const auto& file : found)
+        stamps.insert(file, pvGetKeywordStamp(file));
+
+    for (const auto& file : m_pvKeyWordsFiles)
+    {
+        if (stamps.contains(file))
+        {
+            files.append(file);
+            changed |= stamps.value(file) != m_pvKeyWordsStamps.value(file);
+        }
+        else
+        {
+            changed = true;
+        }
+    }
+
+    for (const auto& file : found)
+    {
+        if (!files.contains(file))
+        {
+            files.append(file);
+            changed = true;
+        }
+    }
+
+    const bool listening = m_porcupine != nullptr && (m_ioDevice != nullptr || m_recovering);
+
+    if (!changed && (!listening || activeKeywordFiles(files) == m_activeFiles))
+        return;
+
+    if (!listening)
+    {
+        updateKeywordsModel(files);
+        m_pvKeyWordsStamps = stamps;
+        updateKeywordsWatcher();
+        return;
+    }
+
+    rebuildEngine(files, stamps);
+}
+
+//
+// Internal gets the keyword files of files passed to the engine: files with an
+// active row in the keywords model and files not yet in the model.
+//
+QVector<QString> QmlPorcupine::activeKeywordFiles(const QVector<QString>& files) const
+{
+    QVector<QString> active;
+
+    for (const auto& file : files)
+    {
+        const int row = m_pvKeyWordsFiles.indexOf(file);
+
+        if (row < 0 || m_keywords->isActive(row))
+            active.append(file);
+    }
+
+    return active;
+}
+
+//
+// Internal replaces the running engine by one for the active subset of files.
+// An engine prepared for the same subset is taken from the cache, otherwise a
+// new one is validated and built on a worker thread.
+//
+void QmlPorcupine::rebuildEngine(const QVector<QString>& files, const KeywordStamps& stamps)
+{
+    const QVector<QString> active = activeKeywordFiles(files);
+
+    if (active.isEmpty())
+    {
+        emit infoMessage("Keyword selection ignored, at least one keyword must stay active.");
+        return;
+    }
+
+    m_reloadFiles = files;
+    m_reloadStamps = stamps;
+    m_reloadActive = active;
+    m_reloadSensitivity = m_sensitivity;
+
+    if (stamps == m_pvKeyWordsStamps)
+    {
+        for (int i = 0; i < m_engineCache.size(); ++i)
+        {
+            if (m_engineCache.at(i).first == active)
+            {
+                swapEngine(m_engineCache.takeAt(i).second);
+                return;
+            }
+        }
+    }
+
+    const QString accessKey = m_pvAccessKey;
+    const QString modelPath = m_pvModelPath;
+    const QVector<qreal> sensitivities(active.size(), m_sensitivity);
+
+    m_engineBuildPending = true;
+    m_engineBuild->setFuture(QtConcurrent::run([accessKey, active, modelPath, sensitivities]()
+    {
+        QString errMsg;
+        Porcupine* porcupine = Porcupine::create(accessKey, active, modelPath, sensitivities, &errMsg);
+        return qMakePair(porcupine, errMsg);
+    }));
+}
+
+//
+// Swaps the engine in between two deliveries. The new instance takes over the
+// partial frame of the old one, so no audio is dropped. The old instance is kept
+// for a later selection of the same subset as long as the files are unchanged.
+//
+void QmlPorcupine::swapEngine(Porcupine* porcupine)
+{
+    // Drains the frames in flight into the old engine first
+    if (m_pipeline != nullptr)
+        m_pipeline->stop();
+
+    porcupine->enable(true);
+    porcupine->takeOverAudio(*m_porcupine);
+    m_porcupine->enable(false);
+
+    // Only engines of the current files and sensitivity are worth keeping
+    if (m_reloadStamps == m_pvKeyWordsStamps && m_engineSensitivity == m_sensitivity)
+    {
+        m_engineCache.prepend(qMakePair(m_activeFiles, m_porcupine));
+
+        while (m_engineCache.size() > EngineCacheSize)
+            delete m_engineCache.takeLast().second;
+    }
+    else
+    {
+        clearEngineCache();
+        delete m_porcupine;
+    }
+
+    m_porcupine = porcupine;
+    updateKeywordsModel(m_reloadFiles);
+    m_pvKeyWordsStamps = m_reloadStamps;
+    m_activeFiles = m_reloadActive;
+    m_engineSensitivity = m_reloadSensitivity;
+    // Before the restart, the detection stage reads the rows on its thread
+    updateActiveRows();
+
+    if (m_pipeline != nullptr)
+    {
+        m_pipelineEngine->setEngine(porcupine);
+        m_pipeline->start(m_pipelineMode == ThreadedPipeline ? AudioPipeline::Threaded : AudioPipeline::Inline);
+    }
+    emit infoMessage(QString("Keywords reloaded, %1 of %2 active.")
+                     .arg(m_activeFiles.size())
+                     .arg(m_pvKeyWordsFiles.size()));
+    emit keywordsReloaded();
+}
+
+void QmlPorcupine::clearEngineCache()
+{
+    for (const auto& engine : m_engineCache)
+        delete engine.second;
+
+    m_engineCache.clear();
+}
+
+//
+// Internal maps the engine's keyword indices to rows of the keywords model.
+//
+void QmlPorcupine::updateActiveRows()
+{
+    m_activeRows.clear();
+
+    for (const auto& file : m_activeFiles)
+        m_activeRows.append(m_pvKeyWordsFiles.indexOf(file));
+}
+
+void QmlPorcupine::keywordsEngineBuilt()
+{
+    const EngineBuild build = m_engineBuild->result();
+    m_engineBuildPending = false;
+
+    if (build.first == nullptr)
+    {
+        emit infoMessage(QString("Keyword reload failed: %1").arg(build.second));
+    }
+    else if (m_porcupine != nullptr && (m_ioDevice != nullptr || m_recovering))
+    {
+        swapEngine(build.first);
+    }
+    else
+    {
+        // Listening stopped while building, the scan is still applied to the model
+        delete build.first;
+
+        if (m_reloadStamps != m_pvKeyWordsStamps)
+            clearEngineCache();
+
+        updateKeywordsModel(m_reloadFiles);
+        m_pvKeyWordsStamps = m_reloadStamps;
+    }
+
+    updateKeywordsWatcher();
+
+    if (m_reloadPending)
+    {
+        m_reloadPending = false;
+        reloadKeywords();
+    }
 }
 
 QString QmlPorcupine::toNativePathSyntax(const QString& urlString)
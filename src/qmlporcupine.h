@@ -5,11 +5,32 @@
 #include <QQmlEngine>
 #include <QAudioFormat>
 #include <QStringListModel>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QPair>
+
+#include "keywordindex.h"
+#include "porcupinestats.h"
 
 class QLibrary;
+class QTimer;
+class QFileSystemWatcher;
 class QAudioSource;
 class QIODevice;
 class Porcupine;
+class KeywordsModel;
+class PorcupineFanout;
+class DetectionJournal;
+class PorcupineMetrics;
+class PorcupineAdmission;
+class DetectionSink;
+class DetectionBus;
+class UdpAudioSource;
+class AlsaAudioSource;
+class AudioPipeline;
+class DeviceSource;
+class PorcupineStage;
 
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
 class QAudioInput;
@@ -29,17 +50,99 @@ class QmlPorcupine : public QObject, public QQmlParserStatus
     Q_PROPERTY(QString pvModelPath READ pvModelPath WRITE setPvModelPath NOTIFY pvModelPathChanged)
     Q_PROPERTY(QString pvKeyWordsDir READ pvKeyWordsDir WRITE setPvKeyWordsDir NOTIFY pvKeyWordsDirChanged)
     Q_PROPERTY(QStringListModel* keywords READ keywords CONSTANT)
+    Q_PROPERTY(bool watchKeywords READ watchKeywords WRITE setWatchKeywords NOTIFY watchKeywordsChanged)
+    Q_PROPERTY(bool warmUp READ warmUp WRITE setWarmUp NOTIFY warmUpChanged)
+    Q_PROPERTY(QString journalDir READ journalDir WRITE setJournalDir NOTIFY journalDirChanged)
+    Q_PROPERTY(int metricsPort READ metricsPort WRITE setMetricsPort NOTIFY metricsPortChanged)
+    Q_PROPERTY(bool tracing READ tracing WRITE setTracing NOTIFY tracingChanged)
+    Q_PROPERTY(bool perfProfiling READ perfProfiling WRITE setPerfProfiling NOTIFY perfProfilingChanged)
+    Q_PROPERTY(bool memoryAccounting READ memoryAccounting WRITE setMemoryAccounting NOTIFY memoryAccountingChanged)
+    Q_PROPERTY(int watchdogTimeout READ watchdogTimeout WRITE setWatchdogTimeout NOTIFY watchdogTimeoutChanged)
+    Q_PROPERTY(bool recoverOnNextDevice READ recoverOnNextDevice WRITE setRecoverOnNextDevice NOTIFY recoverOnNextDeviceChanged)
+    Q_PROPERTY(int captureRecoveries READ captureRecoveries NOTIFY captureRecovered)
+    Q_PROPERTY(qint64 lastRecoveryMs READ lastRecoveryMs NOTIFY captureRecovered)
+    Q_PROPERTY(int udpPort READ udpPort WRITE setUdpPort NOTIFY udpPortChanged)
+    Q_PROPERTY(bool udpRepeatLastFrame READ udpRepeatLastFrame WRITE setUdpRepeatLastFrame NOTIFY udpRepeatLastFrameChanged)
+    Q_PROPERTY(qint64 udpLatePackets READ udpLatePackets NOTIFY statsChanged)
+    Q_PROPERTY(qint64 udpLostPackets READ udpLostPackets NOTIFY statsChanged)
+    Q_PROPERTY(qint64 udpReorderedPackets READ udpReorderedPackets NOTIFY statsChanged)
+    Q_PROPERTY(int udpDelayMs READ udpDelayMs NOTIFY statsChanged)
+    Q_PROPERTY(CaptureBackend captureBackend READ captureBackend WRITE setCaptureBackend NOTIFY captureBackendChanged)
+    Q_PROPERTY(QString alsaDevice READ alsaDevice WRITE setAlsaDevice NOTIFY alsaDeviceChanged)
+    Q_PROPERTY(bool alsaAvailable READ alsaAvailable CONSTANT)
+    Q_PROPERTY(qint64 alsaOverruns READ alsaOverruns NOTIFY statsChanged)
     Q_PROPERTY(bool error READ error NOTIFY errorChanged)
     Q_PROPERTY(bool engineReady READ engineReady  NOTIFY engineReadyChanged)
     Q_PROPERTY(int inputPacketSize READ inputPacketSize NOTIFY inputPacketSizeChanged)
+    Q_PROPERTY(int maxInputPacketSize READ maxInputPacketSize NOTIFY statsChanged)
     Q_PROPERTY(int pvFrameLength READ pvFrameLength CONSTANT);
     Q_PROPERTY(QString errorMsg READ errorMsg CONSTANT)
 
     Q_PROPERTY(qreal sensitivity READ sensitivity WRITE setSensitivity NOTIFY sensitivityChanged)
 
+    Q_PROPERTY(DeliveryMode deliveryMode READ deliveryMode WRITE setDeliveryMode NOTIFY deliveryModeChanged)
+    Q_PROPERTY(PipelineMode pipelineMode READ pipelineMode WRITE setPipelineMode NOTIFY pipelineModeChanged)
+    Q_PROPERTY(int framesPerPeriod READ framesPerPeriod WRITE setFramesPerPeriod NOTIFY framesPerPeriodChanged)
+    Q_PROPERTY(int bufferPeriods READ bufferPeriods WRITE setBufferPeriods NOTIFY bufferPeriodsChanged)
+    Q_PROPERTY(int maxLatencyFrames READ maxLatencyFrames WRITE setMaxLatencyFrames NOTIFY maxLatencyFramesChanged)
+    Q_PROPERTY(qreal statsRate READ statsRate WRITE setStatsRate NOTIFY statsRateChanged)
+    Q_PROPERTY(qreal wakeUpsPerSecond READ wakeUpsPerSecond NOTIFY statsChanged)
+    Q_PROPERTY(qreal framesPerSecond READ framesPerSecond NOTIFY statsChanged)
+    Q_PROPERTY(qint64 detectionCount READ detectionCount NOTIFY statsChanged)
+    Q_PROPERTY(qreal processLoad READ processLoad NOTIFY statsChanged)
+    Q_PROPERTY(qint64 logDroppedRecords READ logDroppedRecords NOTIFY statsChanged)
+    Q_PROPERTY(bool overloaded READ overloaded NOTIFY overloadedChanged)
+    Q_PROPERTY(qreal engineLoad READ engineLoad NOTIFY statsChanged)
+    Q_PROPERTY(qint64 rejectedEngines READ rejectedEngines NOTIFY statsChanged)
+    Q_PROPERTY(qint64 sheddingDecisions READ sheddingDecisions NOTIFY statsChanged)
+
     QML_ELEMENT
 
 public:
+    ///
+    /// \brief How captured audio is delivered to the engine.
+    /// OnReadyRead: processing on every readyRead of the audio device (default).
+    /// FrameAligned: fixed delivery period of framesPerPeriod Porcupine frames.
+    /// Adaptive: the period grows up to maxLatencyFrames while idle and falls
+    /// back to framesPerPeriod on a detection or a growing device backlog.
+    ///
+    enum DeliveryMode
+    {
+        OnReadyRead,
+        FrameAligned,
+        Adaptive
+    };
+    Q_ENUM(DeliveryMode)
+
+    ///
+    /// \brief How captured audio reaches the engine.
+    /// DirectProcessing: pvProcess() hands the device data to the engine.
+    /// InlinePipeline: frames pass an AudioPipeline of fan-out, engine and
+    /// detection stages on the capture thread.
+    /// ThreadedPipeline: the same stages, each on its own thread.
+    ///
+    enum PipelineMode
+    {
+        DirectProcessing,
+        InlinePipeline,
+        ThreadedPipeline
+    };
+    Q_ENUM(PipelineMode)
+
+    ///
+    /// \brief Where captured audio comes from.
+    /// QtMultimediaBackend: QAudioSource (QAudioInput with Qt 5) on the
+    /// selected input device (default).
+    /// AlsaBackend: an ALSA PCM opened directly with a period of one engine
+    /// frame, see AlsaAudioSource. Linux only.
+    ///
+    enum CaptureBackend
+    {
+        QtMultimediaBackend,
+        AlsaBackend
+    };
+    Q_ENUM(CaptureBackend)
+
     explicit QmlPorcupine(QObject *parent = nullptr);
     ~QmlPorcupine();
 
@@ -57,6 +160,21 @@ public:
 
     QStringListModel* keywords() const;
 
+    QVector<int> activeKeywords() const;
+    void setActiveKeywords(const QVector<int>& rows);
+
+    bool watchKeywords() const;
+    void setWatchKeywords(bool watch);
+
+    bool warmUp() const;
+    void setWarmUp(bool warmUp);
+
+    const QString& journalDir() const;
+    void setJournalDir(const QString& dir);
+
+    int metricsPort() const;
+    void setMetricsPort(int port);
+
     QString pvVersion() const;
     qint32 pvFrameLength() const;
     qint32 pvSampleRate() const;
@@ -68,6 +186,78 @@ public:
 
     int inputPacketSize() const ;
     void setInputPacketSize(int size);
+    int maxInputPacketSize() const;
+
+    DeliveryMode deliveryMode() const;
+
+    PipelineMode pipelineMode() const;
+    void setPipelineMode(PipelineMode mode);
+    void setDeliveryMode(DeliveryMode mode);
+
+    int framesPerPeriod() const;
+    void setFramesPerPeriod(int frames);
+
+    int bufferPeriods() const;
+    void setBufferPeriods(int periods);
+
+    int maxLatencyFrames() const;
+    void setMaxLatencyFrames(int frames);
+
+    qreal statsRate() const;
+    void setStatsRate(qreal rate);
+
+    qreal wakeUpsPerSecond() const;
+    qreal framesPerSecond() const;
+    qint64 detectionCount() const;
+    qreal processLoad() const;
+    qint64 logDroppedRecords() const;
+
+    bool overloaded() const;
+    qreal engineLoad() const;
+    qint64 rejectedEngines() const;
+    qint64 sheddingDecisions() const;
+
+    bool tracing() const;
+    void setTracing(bool tracing);
+
+    bool perfProfiling() const;
+    void setPerfProfiling(bool profiling);
+
+    bool memoryAccounting() const;
+    void setMemoryAccounting(bool accounting);
+
+    int watchdogTimeout() const;
+    void setWatchdogTimeout(int ms);
+
+    bool recoverOnNextDevice() const;
+    void setRecoverOnNextDevice(bool next);
+
+    int captureRecoveries() const;
+    qint64 lastRecoveryMs() const;
+
+    int udpPort() const;
+    void setUdpPort(int port);
+
+    bool udpRepeatLastFrame() const;
+    void setUdpRepeatLastFrame(bool repeat);
+
+    qint64 udpLatePackets() const;
+    qint64 udpLostPackets() const;
+    qint64 udpReorderedPackets() const;
+    int udpDelayMs() const;
+
+    CaptureBackend captureBackend() const;
+    void setCaptureBackend(CaptureBackend backend);
+
+    const QString& alsaDevice() const;
+    void setAlsaDevice(const QString& device);
+
+    bool alsaAvailable() const;
+    qint64 alsaOverruns() const;
+
+    void setDetectionSink(DetectionSink* sink);
+
+    DetectionBus* detectionBus() const;
 
 
     void classBegin() override;
@@ -77,6 +267,29 @@ public slots:
 
     QString toNativePathSyntax(const QString &urlString);
 
+    void setKeywordActive(int row, bool active);
+
+    void addEngine(const QString& tag,
+                   const QString& modelPath,
+                   const QString& keywordsDir,
+                   bool shadow = false,
+                   const QString& libraryPath = QString(),
+                   int priority = 0);
+    void clearEngines();
+    QVariantList engineCounters() const;
+
+    QVariantList journalQuery(qint64 fromMs, qint64 toMs) const;
+
+    bool exportTrace(const QString& path);
+
+    QString perfReport() const;
+
+    QString memoryReport() const;
+
+    QString pipelineReport() const;
+
+    QString startupReport() const;
+
     bool startListening();
     void stopListening();
 
@@ -84,33 +297,142 @@ signals:
     void pvAccessKeyChanged();
     void pvModelPathChanged();
     void pvKeyWordsDirChanged();
+    void watchKeywordsChanged();
+    void warmUpChanged();
+    void journalDirChanged();
+    void metricsPortChanged();
+    void tracingChanged();
+    void perfProfilingChanged();
+    void memoryAccountingChanged();
+    void watchdogTimeoutChanged();
+    void udpPortChanged();
+    void udpRepeatLastFrameChanged();
+    void captureBackendChanged();
+    void alsaDeviceChanged();
+    void recoverOnNextDeviceChanged();
+    void captureFailed(const QString& reason);
+    void captureRecovered();
+    void keywordsReloaded();
     void sensitivityChanged();
     void rmChanged();
     void inputPacketSizeChanged();
     void keyWordDetected(int keywordIndex);
+    void engineKeywordDetected(const QString& engine, int keywordIndex);
+    void overloadedChanged();
+    void engineRejected(const QString& engine);
+    void engineShed(const QString& engine, bool gated, bool paused);
     void errorChanged();
     void engineReadyChanged();
     void started();
     void stopped();
     void infoMessage(const QString& message);
+    void deliveryModeChanged();
+    void pipelineModeChanged();
+    void framesPerPeriodChanged();
+    void bufferPeriodsChanged();
+    void maxLatencyFramesChanged();
+    void statsRateChanged();
+    void statsChanged();
 
 private slots:
     void pvProcess();
+    void publishStats();
+    void reloadKeywords();
+    void keywordsEngineBuilt();
+    void applyActiveKeywords();
+    void checkCapture();
+    void startWarmUp();
 
 
 private:
+    typedef QPair<qint64, qint64> KeywordStamp;
+    typedef QHash<QString, KeywordStamp> KeywordStamps;
+    typedef QPair<Porcupine*, QString> EngineBuild;
+
+    QVector<QString> scanKeywords();
+    struct EngineConfig
+    {
+        QString tag;
+        QString modelPath;
+        QString keywordsDir;
+        QString libraryPath;
+        bool    shadow;
+        int     priority;
+    };
+
     void createKeywordsModel();
+    void startEngines();
+    bool startEngine(const EngineConfig& config);
+    void updateKeywordsModel(const QVector<QString>& files);
+    void updateKeywordsWatcher();
+    QVector<QString> activeKeywordFiles(const QVector<QString>& files) const;
+    void rebuildEngine(const QVector<QString>& files, const KeywordStamps& stamps);
+    void swapEngine(Porcupine* porcupine);
+    void clearEngineCache();
+    void updateActiveRows();
+
+    static const int EngineCacheSize = 4;
     void initPv();
     void removePv();
+    void openJournal();
+    Porcupine* takeWarmEngine(const QStringList& signature);
+    void discardWarmUp();
+    QStringList engineSignature(const QVector<QString>& files) const;
     void handleProcessError(const QString& errMsg);
+    void configureCapture();
+    bool openCapture(const QString& deviceName, QString* errMsg);
+    bool openUdpCapture(QString* errMsg);
+    bool openAlsaCapture(QString* errMsg);
+    void closeCapture();
+    void recoverCapture(const QString& reason);
+    void startWatchdog();
+    void adaptDeliveryPeriod(qint64 backlogBytes, bool detected);
+    void buildPipeline();
+    void deletePipeline();
+    void pvProcessPipeline();
+    void captureDataArrived();
+    void reportDetection(int row, qint64 streamSamples);
+    int frameDurationMs(int frames) const;
 
     QString             m_pvAccessKey;
     QString             m_pvModelPath;
     QString             m_pvKeyWordsDir;
     QVector<QString>    m_pvKeyWordsFiles;
+    KeywordStamps       m_pvKeyWordsStamps;
+    KeywordIndex        m_keywordIndex;
+    bool                m_watchKeywords;
+    QFileSystemWatcher* m_keywordsWatcher;
+    QTimer*             m_reloadTimer;
+    QFutureWatcher<EngineBuild>* m_engineBuild;
+    bool                m_engineBuildPending;
+    bool                m_warmUp;
+    bool                m_componentComplete;
+    QFutureWatcher<EngineBuild>* m_warmUpBuild;
+    QStringList         m_warmUpSignature;
+    QVector<QFutureWatcher<EngineBuild>*> m_discardedWarmUps;
+    QVector<QString>    m_reloadFiles;
+    KeywordStamps       m_reloadStamps;
+    QVector<QString>    m_reloadActive;
+    QVector<QString>    m_activeFiles;
+    QVector<int>        m_activeRows;
+    QVector<QPair<QVector<QString>, Porcupine*>> m_engineCache;
+    QVector<EngineConfig> m_engineConfigs;
+    PorcupineFanout*    m_fanout;
+    PorcupineAdmission* m_admission;
+    DetectionBus*       m_detectionBus;
+    QString             m_journalDir;
+    DetectionJournal*   m_journal;
+    quint32             m_streamId;
+    QByteArray          m_engineVersion;
+    qint64              m_streamSamples;
+    PorcupineMetrics*   m_metrics;
+    int                 m_metricsPort;
+    bool                m_reloadPending;
     qreal               m_sensitivity;
+    qreal               m_engineSensitivity;
+    qreal               m_reloadSensitivity;
     int                 m_inputPacketSize;
-    QStringListModel*   m_keywords;
+    KeywordsModel*      m_keywords;
     Porcupine*          m_porcupine;
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QAudioInput*        m_audioEngine;
@@ -119,9 +441,43 @@ private:
 #endif
     QAudioFormat        m_pvAudioFormat;
     QIODevice*          m_ioDevice;
+    QString             m_deviceName;
+    QTimer*             m_watchdog;
+    int                 m_watchdogTimeout;
+    bool                m_recoverOnNextDevice;
+    bool                m_recovering;
+    int                 m_captureRecoveries;
+    qint64              m_lastRecoveryMs;
+    QElapsedTimer       m_lastDataClock;
+    UdpAudioSource*     m_udpSource;
+    int                 m_udpPort;
+    bool                m_udpRepeatLastFrame;
+    CaptureBackend      m_captureBackend;
+    AlsaAudioSource*    m_alsaSource;
+    QString             m_alsaDevice;
+    PipelineMode        m_pipelineMode;
+    AudioPipeline*      m_pipeline;
+    DeviceSource*       m_pipelineSource;
+    PorcupineStage*     m_pipelineEngine;
+    QByteArray          m_readBuffer;
     bool                m_error;
     bool                m_engineReady;
     QString             m_errorMsg;
+    DeliveryMode        m_deliveryMode;
+    int                 m_framesPerPeriod;
+    int                 m_bufferPeriods;
+    int                 m_maxLatencyFrames;
+    int                 m_currentPeriodFrames;
+    QTimer*             m_deliveryTimer;
+    QTimer*             m_statsTimer;
+    QElapsedTimer       m_statsClock;
+    PorcupineStats      m_stats;
+    qreal               m_statsRate;
+    int                 m_maxInputPacketSize;
+    qreal               m_wakeUpsPerSecond;
+    qreal               m_framesPerSecond;
+    qint64              m_detectionCount;
+    qreal               m_processLoad;
 
 };
 
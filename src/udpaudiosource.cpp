@@ -0,0 +1,234 @@
+#include <QTimer>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <cstring>
+
+#include "porcupinelog.h"
+#include "udpaudiosource.h"
+
+namespace
+{
+
+// Gaps are checked at this period while packets are buffered
+const int ReleasePeriodMs = 5;
+
+// Samples kept unread before the oldest are dropped, 2 s
+const int MaxPendingSeconds = 2;
+
+}
+
+///
+/// \brief Constructs a closed source.
+/// \param sampleRate Sample rate of the engine, also of the RTP timestamps.
+/// \param frameLength Samples per engine frame.
+///
+UdpAudioSource::UdpAudioSource(qint32 sampleRate, int frameLength, QObject* parent)
+    : QIODevice(parent)
+    , m_socket(new QUdpSocket(this))
+    , m_releaseTimer(new QTimer(this))
+    , m_jitter(sampleRate)
+    , m_sampleRate(sampleRate)
+    , m_frameBytes(2 * frameLength)
+    , m_readPos(0)
+    , m_hasSsrc(false)
+    , m_ssrc(0)
+    , m_malformed(0)
+    , m_overruns(0)
+{
+    m_jitter.setFrameLength(frameLength);
+    m_releaseTimer->setInterval(ReleasePeriodMs);
+    m_datagram.resize(65536);
+    QObject::connect(m_socket, &QUdpSocket::readyRead, this, &UdpAudioSource::readDatagrams);
+    QObject::connect(m_releaseTimer, &QTimer::timeout, this, &UdpAudioSource::releaseAudio);
+}
+
+UdpAudioSource::~UdpAudioSource()
+{
+    close();
+}
+
+///
+/// \brief Binds the socket and opens the device for reading.
+/// \param port UDP port.
+/// \param address Local address, by default all interfaces.
+/// \param errMsg Optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool UdpAudioSource::listen(quint16 port, const QHostAddress& address, QString* errMsg)
+{
+    close();
+
+    if (!m_socket->bind(address, port))
+    {
+        if (errMsg != nullptr)
+            *errMsg = QString("Cannot bind UDP port %1: %2").arg(port).arg(m_socket->errorString());
+
+        return false;
+    }
+
+    // Enough socket buffer for bursts while the UI thread is busy
+    m_socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 1 << 20);
+    m_jitter.reset();
+    m_hasSsrc = false;
+    m_pending.clear();
+    m_readPos = 0;
+    m_clock.start();
+    m_releaseTimer->start();
+    return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void UdpAudioSource::close()
+{
+    m_releaseTimer->stop();
+    m_socket->close();
+
+    if (isOpen())
+        QIODevice::close();
+}
+
+void UdpAudioSource::setConcealment(JitterBuffer::Concealment concealment)
+{
+    m_jitter.setConcealment(concealment);
+}
+
+///
+/// \brief Gets the jitter buffer and packet counters.
+///
+UdpAudioSource::Counters UdpAudioSource::counters() const
+{
+    Counters counters;
+    counters.jitter = m_jitter.counters();
+    counters.malformed = m_malformed;
+    counters.overruns = m_overruns;
+    return counters;
+}
+
+bool UdpAudioSource::isSequential() const
+{
+    return true;
+}
+
+qint64 UdpAudioSource::bytesAvailable() const
+{
+    return wholeFrameBytes();
+}
+
+qint64 UdpAudioSource::wholeFrameBytes() const
+{
+    const qint64 bytes = m_pending.size() - m_readPos;
+    return bytes - bytes % m_frameBytes;
+}
+
+qint64 UdpAudioSource::readData(char* data, qint64 maxSize)
+{
+    const qint64 bytes = qMin(maxSize, wholeFrameBytes());
+
+    if (bytes <= 0)
+        return 0;
+
+    std::memcpy(data, m_pending.constData() + m_readPos, size_t(bytes));
+    m_readPos += int(bytes);
+
+    // Compact once the consumed part dominates, the capacity is kept
+    if (m_readPos > m_pending.size() / 2)
+    {
+        m_pending.remove(0, m_readPos);
+        m_readPos = 0;
+    }
+
+    return bytes;
+}
+
+qint64 UdpAudioSource::writeData(const char* data, qint64 maxSize)
+{
+    Q_UNUSED(data)
+    Q_UNUSED(maxSize)
+    return -1;
+}
+
+//
+// Internal parses the RTP packets received and hands them to the jitter buffer.
+//
+void UdpAudioSource::readDatagrams()
+{
+    const qint64 nowMs = m_clock.elapsed();
+
+    while (m_socket->hasPendingDatagrams())
+    {
+        const qint64 size = m_socket->readDatagram(m_datagram.data(), m_datagram.size());
+        const uchar* packet = reinterpret_cast<const uchar*>(m_datagram.constData());
+
+        // Fixed header, version 2
+        if (size < 12 || (packet[0] >> 6) != 2)
+        {
+            ++m_malformed;
+            continue;
+        }
+
+        qint64 offset = 12 + 4 * (packet[0] & 0x0f);
+        qint64 end = size;
+
+        if ((packet[0] & 0x10) != 0)
+            offset = offset + 4 <= size ? offset + 4 + 4 * qFromBigEndian<quint16>(packet + offset + 2) : size + 1;
+
+        if ((packet[0] & 0x20) != 0)
+            end -= packet[size - 1];
+
+        if (offset > end || (end - offset) % 2 != 0)
+        {
+            ++m_malformed;
+            continue;
+        }
+
+        const quint16 sequence = qFromBigEndian<quint16>(packet + 2);
+        const quint32 timestamp = qFromBigEndian<quint32>(packet + 4);
+        const quint32 ssrc = qFromBigEndian<quint32>(packet + 8);
+
+        if (!m_hasSsrc || ssrc != m_ssrc)
+        {
+            if (m_hasSsrc)
+                PorcupineLog::instance().post(PorcupineLog::Info, QString("UDP audio source changed to SSRC %1").arg(ssrc));
+
+            m_jitter.restart();
+            m_hasSsrc = true;
+            m_ssrc = ssrc;
+        }
+
+        const int count = int(end - offset) / 2;
+        m_samples.resize(count);
+
+        for (int i = 0; i < count; ++i)
+            m_samples[i] = qFromBigEndian<qint16>(packet + offset + 2 * i);
+
+        m_jitter.push(sequence, timestamp, m_samples.constData(), count, nowMs);
+    }
+
+    releaseAudio();
+}
+
+//
+// Internal moves due samples into the frame assembly and signals whole frames.
+//
+void UdpAudioSource::releaseAudio()
+{
+    m_released.clear();
+
+    if (m_jitter.pull(m_clock.elapsed(), &m_released) <= 0)
+        return;
+
+    const qint64 before = wholeFrameBytes();
+    m_pending.append(reinterpret_cast<const char*>(m_released.constData()), 2 * m_released.size());
+    const qint64 limit = qint64(MaxPendingSeconds) * 2 * m_sampleRate;
+
+    // Nobody reads, keep the newest audio, whole frames are dropped
+    if (m_pending.size() - m_readPos > limit)
+    {
+        const qint64 drop = m_pending.size() - m_readPos - limit;
+        m_readPos += int(qMin(drop + m_frameBytes - 1 - (drop + m_frameBytes - 1) % m_frameBytes,
+                              qint64(m_pending.size() - m_readPos)));
+        ++m_overruns;
+    }
+
+    if (wholeFrameBytes() > before)
+        emit readyRead();
+}
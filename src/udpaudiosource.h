@@ -0,0 +1,79 @@
+#ifndef UDPAUDIOSOURCE_H
+#define UDPAUDIOSOURCE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QIODevice>
+#include <QVector>
+
+#include "jitterbuffer.h"
+
+class QTimer;
+class QUdpSocket;
+
+///
+/// \brief Audio input from RTP packets over UDP, read like a capture device.
+/// Packets carry an RTP header (RFC 3550) and 16 bit mono L16 samples in
+/// network byte order (RFC 3551) at the engine sample rate. They pass a
+/// JitterBuffer and are reassembled into whole engine frames of native
+/// samples: bytesAvailable() and readyRead() only ever cover complete frames.
+/// A new SSRC restarts the jitter buffer. Lives on the thread reading it.
+///
+class UdpAudioSource : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    struct Counters
+    {
+        JitterBuffer::Counters jitter;
+        qint64  malformed = 0;
+        qint64  overruns = 0;
+    };
+
+    UdpAudioSource(qint32 sampleRate, int frameLength, QObject* parent = nullptr);
+    ~UdpAudioSource();
+
+    bool listen(quint16 port, const QHostAddress& address = QHostAddress::Any, QString* errMsg = nullptr);
+
+    void close() override;
+
+    void setConcealment(JitterBuffer::Concealment concealment);
+
+    Counters counters() const;
+
+    bool isSequential() const override;
+
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private slots:
+    void readDatagrams();
+    void releaseAudio();
+
+private:
+    qint64 wholeFrameBytes() const;
+
+    QUdpSocket*         m_socket;
+    QTimer*             m_releaseTimer;
+    JitterBuffer        m_jitter;
+    const qint32        m_sampleRate;
+    const int           m_frameBytes;
+    QElapsedTimer       m_clock;
+    QByteArray          m_datagram;
+    QVector<qint16>     m_samples;
+    QVector<qint16>     m_released;
+    QByteArray          m_pending;
+    int                 m_readPos;
+    bool                m_hasSsrc;
+    quint32             m_ssrc;
+    qint64              m_malformed;
+    qint64              m_overruns;
+};
+
+#endif // UDPAUDIOSOURCE_H
@@ -0,0 +1,17 @@
+#include "check.h"
+
+static int s_failures = 0;
+
+void check(QTextStream& out, bool passed, const QString& what)
+{
+    out << (passed ? "OK: " : "FAIL: ") << what << Qt::endl;
+
+    if (!passed)
+        ++s_failures;
+}
+
+int checkSummary(QTextStream& out)
+{
+    out << (s_failures == 0 ? QString("All checks passed") : QString("%1 checks failed").arg(s_failures)) << Qt::endl;
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,19 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <QString>
+#include <QTextStream>
+
+///
+/// \brief Reports one check of a check tool as "OK: what" or "FAIL: what".
+/// Failures are counted for checkSummary().
+///
+void check(QTextStream& out, bool passed, const QString& what);
+
+///
+/// \brief Reports the number of failed checks.
+/// \return The exit code of the check tool, 1 if a check failed.
+///
+int checkSummary(QTextStream& out);
+
+#endif // CHECK_H
@@ -0,0 +1,258 @@
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+#include <random>
+
+#include "corpus.h"
+
+static bool errCorpus(const QString& message, QString* errMsg)
+{
+    if (errMsg != nullptr)
+        *errMsg = message;
+
+    return false;
+}
+
+///
+/// \brief Loads and decodes all files of a corpus directory.
+/// \param directory Corpus directory.
+/// \param sampleRate Required sample rate of all files.
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool Corpus::load(const QString& directory, qint32 sampleRate, QString* errMsg)
+{
+    m_files.clear();
+    m_sampleRate = sampleRate;
+    QStringList paths;
+    QDirIterator wavIt(directory, {"*.wav"}, QDir::Files, QDirIterator::Subdirectories);
+
+    while (wavIt.hasNext())
+        paths.append(wavIt.next());
+
+    std::sort(paths.begin(), paths.end());
+
+    if (paths.isEmpty())
+        return errCorpus(QString("No *.wav files found in \"%1\"").arg(directory), errMsg);
+
+    for (const auto& path : paths)
+    {
+        CorpusFile file;
+        file.path = path;
+
+        if (!readWav(path, sampleRate, &file.pcm, errMsg))
+            return false;
+
+        const QFileInfo fi(path);
+        const QString labelsPath = fi.dir().filePath(fi.completeBaseName() + ".labels");
+
+        if (QFileInfo::exists(labelsPath) && !readLabels(labelsPath, sampleRate, &file.labels, errMsg))
+            return false;
+
+        m_files.append(file);
+    }
+
+    return true;
+}
+
+const QVector<CorpusFile>& Corpus::files() const
+{
+    return m_files;
+}
+
+///
+/// \brief Gets the names of all labeled keywords.
+///
+QStringList Corpus::keywords() const
+{
+    QStringList keywords;
+
+    for (const auto& file : m_files)
+    {
+        for (const auto& label : file.labels)
+        {
+            if (!keywords.contains(label.keyword))
+                keywords.append(label.keyword);
+        }
+    }
+
+    return keywords;
+}
+
+///
+/// \brief Gets the length of the corpus in samples.
+///
+qint64 Corpus::totalSamples() const
+{
+    qint64 samples = 0;
+
+    for (const auto& file : m_files)
+        samples += file.pcm.size();
+
+    return samples;
+}
+
+qint32 Corpus::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+///
+/// \brief Reads a RIFF/WAVE file with 16 bit mono PCM samples.
+/// \param path Path of the file.
+/// \param sampleRate Required sample rate.
+/// \param pcm Outputs the samples.
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool Corpus::readWav(const QString& path, qint32 sampleRate, QVector<qint16>* pcm, QString* errMsg)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly))
+        return errCorpus(QString("Cannot open \"%1\"").arg(path), errMsg);
+
+    QDataStream in(&file);
+    in.setByteOrder(QDataStream::LittleEndian);
+    char riff[4];
+    char wave[4];
+    quint32 riffSize = 0;
+
+    if (in.readRawData(riff, 4) != 4 || qstrncmp(riff, "RIFF", 4) != 0)
+        return errCorpus(QString("\"%1\" is not a RIFF file").arg(path), errMsg);
+
+    in >> riffSize;
+
+    if (in.readRawData(wave, 4) != 4 || qstrncmp(wave, "WAVE", 4) != 0)
+        return errCorpus(QString("\"%1\" is not a WAVE file").arg(path), errMsg);
+
+    bool formatOk = false;
+
+    while (!in.atEnd())
+    {
+        char chunkId[4];
+        quint32 chunkSize = 0;
+
+        if (in.readRawData(chunkId, 4) != 4)
+            break;
+
+        in >> chunkSize;
+
+        // A corrupt size must not turn negative or reach past the file
+        if (chunkSize > quint64(file.size() - file.pos()) || chunkSize > quint32(std::numeric_limits<int>::max() - 1))
+            return errCorpus(QString("\"%1\" has a chunk beyond the end of the file").arg(path), errMsg);
+
+        if (qstrncmp(chunkId, "fmt ", 4) == 0)
+        {
+            if (chunkSize < 16)
+                return errCorpus(QString("\"%1\" has a short format chunk").arg(path), errMsg);
+
+            quint16 format = 0;
+            quint16 channels = 0;
+            quint32 rate = 0;
+            quint32 byteRate = 0;
+            quint16 blockAlign = 0;
+            quint16 bitsPerSample = 0;
+            in >> format >> channels >> rate >> byteRate >> blockAlign >> bitsPerSample;
+            in.skipRawData(int(chunkSize) - 16);
+            formatOk = format == 1 && channels == 1 && bitsPerSample == 16 && qint32(rate) == sampleRate;
+
+            if (!formatOk)
+                return errCorpus(QString("\"%1\" is not %2 Hz 16 bit mono PCM").arg(path).arg(sampleRate), errMsg);
+        }
+        else if (qstrncmp(chunkId, "data", 4) == 0)
+        {
+            if (!formatOk)
+                return errCorpus(QString("\"%1\" has no format before its data").arg(path), errMsg);
+
+            pcm->resize(int(chunkSize / 2));
+            const int bytes = pcm->size() * 2;
+
+            if (in.readRawData(reinterpret_cast<char*>(pcm->data()), bytes) != bytes)
+                return errCorpus(QString("\"%1\" is truncated").arg(path), errMsg);
+
+            return true;
+        }
+        else
+        {
+            in.skipRawData(int(chunkSize + (chunkSize & 1)));
+        }
+    }
+
+    return errCorpus(QString("\"%1\" has no data chunk").arg(path), errMsg);
+}
+
+///
+/// \brief Reads a labels file, lines "keyword start end" with times in seconds.
+/// Empty lines and lines starting with # are ignored.
+/// \param path Path of the file.
+/// \param sampleRate Sample rate to convert times to sample positions.
+/// \param labels Outputs the labels.
+/// \param errMsg optional output of error messages.
+/// \return true on success otherwise false.
+///
+bool Corpus::readLabels(const QString& path, qint32 sampleRate, QVector<CorpusLabel>* labels, QString* errMsg)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return errCorpus(QString("Cannot open \"%1\"").arg(path), errMsg);
+
+    QTextStream in(&file);
+    int lineNo = 0;
+
+    while (!in.atEnd())
+    {
+        const QString line = in.readLine().trimmed();
+        ++lineNo;
+
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        const QStringList parts = line.split(QRegularExpression("\\s+"));
+        bool startOk = false;
+        bool endOk = false;
+
+        if (parts.size() == 3)
+        {
+            CorpusLabel label;
+            label.keyword = parts.at(0);
+            label.start = qint64(parts.at(1).toDouble(&startOk) * sampleRate);
+            label.end = qint64(parts.at(2).toDouble(&endOk) * sampleRate);
+
+            if (startOk && endOk && label.end >= label.start)
+            {
+                labels->append(label);
+                continue;
+            }
+        }
+
+        return errCorpus(QString("\"%1\" line %2: expected \"keyword start end\"").arg(path).arg(lineNo), errMsg);
+    }
+
+    return true;
+}
+
+QString corpusKeywordName(const QString& keywordFile)
+{
+    QFileInfo fi(keywordFile);
+    return fi.baseName().split('_').at(0);
+}
+
+QVector<qint16> syntheticAudio(qint32 sampleRate)
+{
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0, 300);
+    QVector<qint16> pcm(10 * sampleRate);
+
+    for (auto& sample : pcm)
+        sample = qint16(qBound(-32768.0f, noise(rng), 32767.0f));
+
+    return pcm;
+}
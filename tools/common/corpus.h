@@ -0,0 +1,69 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+///
+/// \brief A labeled keyword occurrence, positions in samples.
+///
+struct CorpusLabel
+{
+    QString keyword;
+    qint64  start = 0;
+    qint64  end = 0;
+};
+
+///
+/// \brief One decoded corpus file with its labels.
+///
+struct CorpusFile
+{
+    QString                 path;
+    QVector<qint16>         pcm;
+    QVector<CorpusLabel>    labels;
+};
+
+///
+/// \brief Labeled audio corpus for offline evaluation.
+/// A corpus is a directory of 16 bit mono PCM *.wav files. Each file may have
+/// a sidecar *.labels text file with one "keyword start end" line per
+/// occurrence, start and end in seconds. Files without labels contain no
+/// keyword and count for false alarms only.
+///
+class Corpus
+{
+
+public:
+    bool load(const QString& directory, qint32 sampleRate, QString* errMsg = nullptr);
+
+    const QVector<CorpusFile>& files() const;
+
+    QStringList keywords() const;
+
+    qint64 totalSamples() const;
+
+    qint32 sampleRate() const;
+
+    static bool readWav(const QString& path, qint32 sampleRate, QVector<qint16>* pcm, QString* errMsg = nullptr);
+
+    static bool readLabels(const QString& path, qint32 sampleRate, QVector<CorpusLabel>* labels, QString* errMsg = nullptr);
+
+private:
+    QVector<CorpusFile> m_files;
+    qint32              m_sampleRate = 0;
+};
+
+///
+/// \brief Keyword name of a keyword file, e.g. "ananas" for ananas_mac.ppn.
+///
+QString corpusKeywordName(const QString& keywordFile);
+
+///
+/// \brief 10 s of low level noise, for load and allocation runs whose cost
+/// does not depend on the content. The same samples on every call.
+///
+QVector<qint16> syntheticAudio(qint32 sampleRate);
+
+#endif // CORPUS_H
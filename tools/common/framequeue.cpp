@@ -0,0 +1,110 @@
+#include <QElapsedTimer>
+
+#include "framequeue.h"
+
+FrameQueue::FrameQueue(int frameLength, int framesPerBlock, int blocks)
+    : m_blocks(blocks)
+    , m_blockSamples(frameLength * framesPerBlock)
+    , m_closed(false)
+    , m_producerWaitNs(0)
+    , m_consumerWaitNs(0)
+{
+    for (auto& block : m_blocks)
+    {
+        block.reserve(m_blockSamples);
+        m_free.enqueue(&block);
+    }
+}
+
+///
+/// \brief Gets an empty block for the producer, waits while all blocks are in flight.
+/// \return An empty block with capacity for blockSamples() samples.
+///
+QVector<qint16>* FrameQueue::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_free.isEmpty())
+    {
+        QElapsedTimer waitClock;
+        waitClock.start();
+
+        while (m_free.isEmpty())
+            m_freeCond.wait(&m_mutex);
+
+        m_producerWaitNs += waitClock.nsecsElapsed();
+    }
+
+    QVector<qint16>* block = m_free.dequeue();
+    block->resize(0);
+    return block;
+}
+
+///
+/// \brief Hands a filled block to the consumer.
+///
+void FrameQueue::push(QVector<qint16>* block)
+{
+    QMutexLocker locker(&m_mutex);
+    m_ready.enqueue(block);
+    m_readyCond.wakeOne();
+}
+
+///
+/// \brief Marks the end of the stream, pop() returns nullptr once all blocks are consumed.
+///
+void FrameQueue::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_closed = true;
+    m_readyCond.wakeAll();
+}
+
+///
+/// \brief Gets the next filled block for the consumer, waits while none is ready.
+/// \return The block or nullptr at the end of the stream.
+///
+QVector<qint16>* FrameQueue::pop()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_ready.isEmpty() && !m_closed)
+    {
+        QElapsedTimer waitClock;
+        waitClock.start();
+
+        while (m_ready.isEmpty() && !m_closed)
+            m_readyCond.wait(&m_mutex);
+
+        m_consumerWaitNs += waitClock.nsecsElapsed();
+    }
+
+    return m_ready.isEmpty() ? nullptr : m_ready.dequeue();
+}
+
+///
+/// \brief Returns a consumed block to the producer.
+///
+void FrameQueue::release(QVector<qint16>* block)
+{
+    QMutexLocker locker(&m_mutex);
+    m_free.enqueue(block);
+    m_freeCond.wakeOne();
+}
+
+int FrameQueue::blockSamples() const
+{
+    return m_blockSamples;
+}
+
+qint64 FrameQueue::producerWaitNs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_producerWaitNs;
+}
+
+qint64 FrameQueue::consumerWaitNs() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_consumerWaitNs;
+}
@@ -0,0 +1,50 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QWaitCondition>
+
+///
+/// \brief Bounded queue of audio blocks between a producer and a consumer thread.
+/// All blocks are allocated up front and recycled, each holds a whole number
+/// of engine frames. The producer blocks when all blocks are in flight, the
+/// consumer blocks when no block is ready; both waiting times are accounted.
+///
+class FrameQueue
+{
+
+public:
+    FrameQueue(int frameLength, int framesPerBlock, int blocks);
+
+    QVector<qint16>* acquire();
+
+    void push(QVector<qint16>* block);
+
+    void close();
+
+    QVector<qint16>* pop();
+
+    void release(QVector<qint16>* block);
+
+    int blockSamples() const;
+
+    qint64 producerWaitNs() const;
+
+    qint64 consumerWaitNs() const;
+
+private:
+    QVector<QVector<qint16>>    m_blocks;
+    QQueue<QVector<qint16>*>    m_free;
+    QQueue<QVector<qint16>*>    m_ready;
+    mutable QMutex              m_mutex;
+    QWaitCondition              m_freeCond;
+    QWaitCondition              m_readyCond;
+    const int                   m_blockSamples;
+    bool                        m_closed;
+    qint64                      m_producerWaitNs;
+    qint64                      m_consumerWaitNs;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,9 @@
+#include "stats.h"
+
+qreal percentile(const QVector<qreal>& sorted, qreal p)
+{
+    if (sorted.isEmpty())
+        return 0;
+
+    return sorted.at(qMin(sorted.size() - 1, int(sorted.size() * p)));
+}
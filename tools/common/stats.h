@@ -0,0 +1,12 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <QVector>
+
+///
+/// \brief Gets the p-quantile of ascending sorted values, e.g. p = 0.99.
+/// \return The value at rank p * size, 0 for no values.
+///
+qreal percentile(const QVector<qreal>& sorted, qreal p);
+
+#endif // STATS_H
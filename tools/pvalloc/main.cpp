@@ -0,0 +1,340 @@
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "corpus.h"
+#include "porcupine.h"
+
+///
+/// Allocation check of the capture-to-processFrame path.
+///
+/// Global operator new and, with glibc, malloc/calloc/realloc are replaced by
+/// counting versions. A long stream is replayed like QmlPorcupine::pvProcess()
+/// does: packets of varying size are read from a QIODevice into a buffer
+/// sized once and handed to Porcupine::process(). After the warm-up every
+/// allocation on the replaying thread is counted, including those of the
+/// runtime library, and the tool fails with exit code 1 if there was any.
+///
+/// With the stub runtime library of tools/pvstub, PV_STUB_DETECT_EVERY covers
+/// the detection path as well, e.g. PV_STUB_FRAME_US=0 PV_STUB_DETECT_EVERY=50.
+///
+
+namespace
+{
+
+thread_local bool t_counting = false;
+std::atomic<qint64> s_allocations(0);
+std::atomic<qint64> s_allocatedBytes(0);
+
+inline void countAllocation(std::size_t size)
+{
+    if (t_counting)
+    {
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocatedBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+    }
+}
+
+}
+
+#if defined(__GLIBC__)
+// glibc exports its allocator under these names, the replacements below forward to them
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t count, std::size_t size);
+extern "C" void* __libc_realloc(void* pointer, std::size_t size);
+extern "C" void  __libc_free(void* pointer);
+
+extern "C" void* malloc(std::size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+static void* rawAllocate(std::size_t size)
+{
+    return __libc_malloc(size);
+}
+
+static void rawFree(void* pointer)
+{
+    __libc_free(pointer);
+}
+#else
+static void* rawAllocate(std::size_t size)
+{
+    return std::malloc(size);
+}
+
+static void rawFree(void* pointer)
+{
+    std::free(pointer);
+}
+#endif
+
+void* operator new(std::size_t size)
+{
+    countAllocation(size);
+
+    if (void* pointer = rawAllocate(size > 0 ? size : 1))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    countAllocation(size);
+    return rawAllocate(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    rawFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    rawFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    rawFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    rawFree(pointer);
+}
+
+struct AllocConfig
+{
+    QString         accessKey;
+    QString         modelPath;
+    QVector<QString> keywordFiles;
+    QString         libraryPath;
+    int             packetMs = 20;
+    int             jitterMs = 5;
+    qint64          warmUpMs = 2000;
+    qint64          durationMs = 600000;
+};
+
+struct AllocReport
+{
+    qint64  packets = 0;
+    qint64  frames = 0;
+    qint64  detections = 0;
+    qint64  allocations = 0;
+    qint64  allocatedBytes = 0;
+    QString errMsg;
+};
+
+//
+// Replays source as a looping capture device until durationMs of stream time
+// after the warm-up. Returns false on an engine error.
+//
+static bool replay(Porcupine* engine, const QByteArray& source, const AllocConfig& config, AllocReport* report)
+{
+    const qint32 sampleRate = engine->sampleRate();
+    const qint64 frameBytes = engine->bytesFrameLength();
+    const qint64 warmUpBytes = config.warmUpMs * sampleRate / 1000 * 2;
+    const qint64 totalBytes = warmUpBytes + config.durationMs * sampleRate / 1000 * 2;
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> packetMs(config.packetMs - config.jitterMs, config.packetMs + config.jitterMs);
+    // Sized once like m_readBuffer, a packet never exceeds it
+    QByteArray readBuffer(int((config.packetMs + config.jitterMs) * sampleRate / 1000 * 2 + frameBytes), 0);
+    QBuffer device;
+    device.setData(source);
+    device.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    QString errMsg;
+    qint64 streamBytes = 0;
+
+    while (streamBytes < totalBytes)
+    {
+        if (streamBytes >= warmUpBytes && !t_counting)
+        {
+            s_allocations.store(0);
+            s_allocatedBytes.store(0);
+            t_counting = true;
+        }
+
+        qint64 remaining = qint64(packetMs(rng)) * sampleRate / 1000 * 2;
+        bool success = true;
+        int keywordIndex = -1;
+
+        // Same read loop as pvProcess, a detection ends the packet
+        while (success && keywordIndex < 0 && remaining > 0)
+        {
+            if (device.atEnd())
+                device.seek(0);
+
+            const qint64 bytesRead = device.read(readBuffer.data(), qMin(remaining, qint64(readBuffer.size())));
+
+            if (bytesRead <= 0)
+                break;
+
+            success = engine->process(keywordIndex, readBuffer.constData(), int(bytesRead), &errMsg);
+            remaining -= bytesRead;
+            streamBytes += bytesRead;
+
+            if (t_counting)
+                report->frames += engine->framesProcessed();
+        }
+
+        if (!success)
+        {
+            t_counting = false;
+            report->errMsg = errMsg;
+            return false;
+        }
+
+        if (t_counting)
+        {
+            ++report->packets;
+            report->detections += keywordIndex >= 0 ? 1 : 0;
+        }
+    }
+
+    t_counting = false;
+    report->allocations = s_allocations.load();
+    report->allocatedBytes = s_allocatedBytes.load();
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvalloc");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a long stream through Porcupine::process() and fails if the "
+                                     "per-frame path allocates heap memory after the warm-up.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, e.g. the stub of tools/pvstub.", "file"},
+        {"corpus", "Directory of *.wav files to replay, default synthetic noise.", "dir"},
+        {"packet-ms", "Nominal packet length in ms, default 20.", "ms", "20"},
+        {"jitter-ms", "Maximum packet length deviation in ms, default 5.", "ms", "5"},
+        {"warm-up", "Stream time not counted in seconds, default 2.", "s", "2"},
+        {"duration", "Counted stream time in seconds, default 600.", "s", "600"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    AllocConfig config;
+    config.accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    config.modelPath = parser.value("model");
+    config.libraryPath = parser.value("library");
+    config.packetMs = qMax(1, parser.value("packet-ms").toInt());
+    config.jitterMs = qBound(0, parser.value("jitter-ms").toInt(), config.packetMs - 1);
+    config.warmUpMs = qMax(0, parser.value("warm-up").toInt()) * 1000LL;
+    config.durationMs = qMax(1, parser.value("duration").toInt()) * 1000LL;
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        config.keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(config.keywordFiles.begin(), config.keywordFiles.end());
+
+    QString errMsg;
+    QScopedPointer<Porcupine> engine(Porcupine::create(config.accessKey,
+                                                       config.keywordFiles,
+                                                       config.modelPath,
+                                                       QVector<qreal>(config.keywordFiles.size(), 0.5),
+                                                       &errMsg,
+                                                       config.libraryPath));
+
+    if (engine.isNull())
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    engine->enable(true);
+    QVector<qint16> pcm;
+
+    if (parser.isSet("corpus"))
+    {
+        Corpus corpus;
+
+        if (!corpus.load(parser.value("corpus"), engine->sampleRate(), &errMsg))
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        for (const auto& file : corpus.files())
+            pcm += file.pcm;
+    }
+
+    if (pcm.isEmpty())
+        pcm = syntheticAudio(engine->sampleRate());
+
+    const QByteArray source(reinterpret_cast<const char*>(pcm.constData()), pcm.size() * 2);
+    AllocReport report;
+
+    if (!replay(engine.data(), source, config, &report))
+    {
+        err << report.errMsg << Qt::endl;
+        return 1;
+    }
+
+    out << "packets,frames,detections,allocations,allocated_bytes" << Qt::endl;
+    out << QString("%1,%2,%3,%4,%5")
+           .arg(report.packets)
+           .arg(report.frames)
+           .arg(report.detections)
+           .arg(report.allocations)
+           .arg(report.allocatedBytes) << Qt::endl;
+
+    if (report.allocations > 0)
+    {
+        err << QString("FAIL: %1 heap allocations (%2 bytes) on the per-frame path after warm-up")
+               .arg(report.allocations).arg(report.allocatedBytes) << Qt::endl;
+        return 1;
+    }
+
+    err << "OK: no heap allocations on the per-frame path after warm-up" << Qt::endl;
+    return 0;
+}
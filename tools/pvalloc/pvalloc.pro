@@ -0,0 +1,13 @@
+TARGET = pvalloc
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    main.cpp
+
+# make check PVALLOC_ARGS="--library ... --model ... --keywords ..."
+# fails when the per-frame path allocated after the warm-up.
+check.commands = $$OUT_PWD/$$TARGET $(PVALLOC_ARGS)
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,237 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QHash>
+#include <QTextStream>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if !defined(__cpp_impl_coroutine)
+#error "pvawait needs a compiler with C++20 coroutines"
+#endif
+
+#include "porcupineawaitable.h"
+
+///
+/// Example and check of AwaitableDetector.
+///
+/// Several producer threads stand in for detecting engines and report
+/// detections with increasing frames. One coroutine consumes them with
+/// co_await nextDetection() until the detector is closed. This runs twice:
+/// resumed inline on the producer threads (the default) and resumed on an
+/// executor thread through setScheduler(). Every detection must be received
+/// or counted as dropped, each engine's frames in order, or the check fails.
+///
+
+namespace
+{
+
+///
+/// Fire-and-forget coroutine, signals its end through a future.
+///
+struct Task
+{
+    struct promise_type
+    {
+        std::promise<void> finished;
+
+        Task get_return_object()
+        {
+            return Task{finished.get_future()};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+            finished.set_value();
+        }
+
+        void unhandled_exception()
+        {
+            finished.set_exception(std::current_exception());
+        }
+    };
+
+    std::future<void> finished;
+};
+
+///
+/// Single thread executor, the scheduler of AwaitableDetector posts to it.
+///
+class Executor
+{
+
+public:
+    Executor()
+        : m_running(true)
+        , m_thread(&Executor::run, this)
+    {
+    }
+
+    ~Executor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+
+        m_wake.notify_one();
+        m_thread.join();
+    }
+
+    static void schedule(std::coroutine_handle<> handle, void* context)
+    {
+        Executor* executor = static_cast<Executor*>(context);
+
+        {
+            std::lock_guard<std::mutex> lock(executor->m_mutex);
+            executor->m_queue.push_back(handle);
+        }
+
+        executor->m_wake.notify_one();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        for (;;)
+        {
+            m_wake.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+
+            if (m_queue.empty())
+                return;
+
+            const std::coroutine_handle<> handle = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+        }
+    }
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_wake;
+    std::deque<std::coroutine_handle<>> m_queue;
+    bool                                m_running;
+    std::thread                         m_thread;
+};
+
+struct ConsumerResult
+{
+    qint64  received = 0;
+    qint64  outOfOrder = 0;
+};
+
+Task consume(AwaitableDetector& detector, ConsumerResult& result)
+{
+    QHash<QString, qint64> lastFrames;
+
+    while (auto detection = co_await detector.nextDetection())
+    {
+        ++result.received;
+        const qint64 last = lastFrames.value(detection->engine, -1);
+
+        if (detection->frame <= last)
+            ++result.outOfOrder;
+
+        lastFrames.insert(detection->engine, detection->frame);
+    }
+}
+
+bool runCheck(const QString& mode, int producers, int detections, int capacity, QTextStream& out)
+{
+    AwaitableDetector detector(capacity);
+    std::unique_ptr<Executor> executor;
+
+    if (mode == "executor")
+    {
+        executor.reset(new Executor);
+        detector.setScheduler(&Executor::schedule, executor.get());
+    }
+
+    ConsumerResult result;
+    Task task = consume(detector, result);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&detector, p, detections]()
+        {
+            const QString engine = QString("engine-%1").arg(p);
+
+            for (int i = 0; i < detections; ++i)
+            {
+                detector.detected(engine, i % 4, i);
+
+                if (i % 16 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    detector.close();
+    task.finished.get();
+    executor.reset();
+
+    const qint64 produced = qint64(producers) * detections;
+    const bool ok = result.received + detector.dropped() == produced && result.outOfOrder == 0;
+    out << QString("%1,%2,%3,%4,%5,%6")
+           .arg(mode)
+           .arg(produced)
+           .arg(result.received)
+           .arg(detector.dropped())
+           .arg(result.outOfOrder)
+           .arg(ok ? "ok" : "FAIL") << Qt::endl;
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvawait");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Consumes detections of concurrent producers with a coroutine "
+                                     "awaiting AwaitableDetector, resumed inline and on an executor.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"producers", "Producer threads, default 4.", "n", "4"},
+        {"detections", "Detections per producer, default 100000.", "n", "100000"},
+        {"capacity", "Ring capacity of the detector, default 64.", "n", "64"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    const int producers = qMax(1, parser.value("producers").toInt());
+    const int detections = qMax(1, parser.value("detections").toInt());
+    const int capacity = qMax(2, parser.value("capacity").toInt());
+    bool ok = true;
+
+    out << "resumption,produced,received,dropped,out_of_order,result" << Qt::endl;
+    ok &= runCheck("inline", producers, detections, capacity, out);
+    ok &= runCheck("executor", producers, detections, capacity, out);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,26 @@
+# Example and check of the awaitable detection API, the only part of the
+# project that needs C++20 (coroutines). No engine is involved.
+
+TARGET = pvawait
+TEMPLATE = app
+
+QT -= gui
+QT += core
+
+CONFIG += c++2a console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../../src
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    $$PWD/../../src/detectionsink.h \
+    $$PWD/../../src/mpscring.h \
+    $$PWD/../../src/porcupineawaitable.h
+
+# make check runs the example, it fails when detections were lost
+check.commands = $$OUT_PWD/$$TARGET
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
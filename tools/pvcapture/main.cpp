@@ -0,0 +1,224 @@
+#include <QAudioFormat>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QTimer>
+#include <algorithm>
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+#include <QAudioDeviceInfo>
+#include <QAudioInput>
+#else
+#include <QAudioDevice>
+#include <QAudioSource>
+#include <QMediaDevices>
+#endif
+
+#include "alsaaudiosource.h"
+#include "stats.h"
+
+///
+/// Capture latency comparison of the QtMultimedia and the ALSA backend.
+///
+/// Each backend captures 16 bit mono for a while with a buffer of the given
+/// number of engine frames and is read on every readyRead, like QmlPorcupine
+/// does with OnReadyRead delivery. At every read the lag of the newest sample
+/// handed over is taken: the time since capture started minus the duration
+/// of all samples read so far. It contains the start-up of the device, the
+/// same for both, and all buffering between the hardware and the reader.
+/// The spread above its minimum is the delivery jitter.
+///
+/// The ALSA device can be any PCM, for a reproducible run without hardware
+/// e.g. a "file" plugin reading raw audio (see README).
+///
+
+struct CaptureConfig
+{
+    qint32  sampleRate = 16000;
+    int     frameLength = 512;
+    int     periods = 4;
+    int     seconds = 10;
+    QString qtDevice;
+    QString alsaDevice = "default";
+};
+
+struct CaptureReport
+{
+    QString         backend;
+    QVector<qreal>  lagMs;
+    qint64          wakeUps = 0;
+    qint64          samples = 0;
+    qint64          overruns = 0;
+    qint64          dropped = 0;
+    bool            realtime = false;
+    QString         errMsg;
+};
+
+//
+// Reads the device on every readyRead until the capture time is over.
+//
+static void measure(QIODevice* device, const CaptureConfig& config, CaptureReport* report)
+{
+    QElapsedTimer clock;
+    QByteArray buffer(1 << 16, 0);
+    QEventLoop loop;
+
+    QObject::connect(device, &QIODevice::readyRead, &loop, [&]()
+    {
+        const qint64 bytes = device->read(buffer.data(), buffer.size());
+
+        if (bytes <= 0)
+            return;
+
+        ++report->wakeUps;
+        report->samples += bytes / 2;
+        report->lagMs.append(clock.nsecsElapsed() / 1e6 - report->samples * 1000.0 / config.sampleRate);
+    });
+
+    QTimer::singleShot(config.seconds * 1000, &loop, &QEventLoop::quit);
+    clock.start();
+    loop.exec();
+    QObject::disconnect(device, nullptr, &loop, nullptr);
+}
+
+static CaptureReport captureQt(const CaptureConfig& config)
+{
+    CaptureReport report;
+    report.backend = "qt";
+    QAudioFormat format;
+    format.setSampleRate(config.sampleRate);
+    format.setChannelCount(1);
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setCodec("audio/pcm");
+    QAudioDeviceInfo device = QAudioDeviceInfo::defaultInputDevice();
+
+    for (const auto& input : QAudioDeviceInfo::availableDevices(QAudio::AudioInput))
+    {
+        if (input.deviceName() == config.qtDevice)
+            device = input;
+    }
+
+    QAudioInput source(device, format);
+#else
+    format.setSampleFormat(QAudioFormat::Int16);
+    QAudioDevice device = QMediaDevices::defaultAudioInput();
+
+    for (const auto& input : QMediaDevices::audioInputs())
+    {
+        if (input.description() == config.qtDevice)
+            device = input;
+    }
+
+    QAudioSource source(device, format);
+#endif
+    source.setBufferSize(config.periods * config.frameLength * 2);
+    QIODevice* io = source.start();
+
+    if (io == nullptr)
+    {
+        report.errMsg = "Cannot start the QtMultimedia input device";
+        return report;
+    }
+
+    measure(io, config, &report);
+    source.stop();
+    return report;
+}
+
+static CaptureReport captureAlsa(const CaptureConfig& config)
+{
+    CaptureReport report;
+    report.backend = "alsa";
+    AlsaAudioSource source(config.sampleRate, config.frameLength);
+
+    if (!source.start(config.alsaDevice, config.periods, &report.errMsg))
+        return report;
+
+    measure(&source, config, &report);
+    const AlsaAudioSource::Counters counters = source.counters();
+    report.overruns = counters.overruns;
+    report.dropped = counters.dropped;
+    report.realtime = counters.realtime;
+    source.close();
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvcapture");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compares the capture latency of the QtMultimedia and the ALSA backend.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"backend", "qt, alsa or both (default).", "name", "both"},
+        {"qt-device", "QtMultimedia input device, default the system default.", "name"},
+        {"alsa-device", "ALSA PCM name, default \"default\".", "name", "default"},
+        {"seconds", "Capture time per backend, default 10.", "seconds", "10"},
+        {"periods", "Buffer size in engine frames, default 4.", "frames", "4"},
+        {"frame-length", "Samples per engine frame, default 512.", "samples", "512"},
+        {"sample-rate", "Sample rate, default 16000.", "hz", "16000"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    CaptureConfig config;
+    config.sampleRate = qMax(8000, parser.value("sample-rate").toInt());
+    config.frameLength = qMax(16, parser.value("frame-length").toInt());
+    config.periods = qMax(2, parser.value("periods").toInt());
+    config.seconds = qMax(1, parser.value("seconds").toInt());
+    config.qtDevice = parser.value("qt-device");
+    config.alsaDevice = parser.value("alsa-device");
+    const QString backend = parser.value("backend");
+    QVector<CaptureReport> reports;
+
+    if (backend == "qt" || backend == "both")
+        reports.append(captureQt(config));
+
+    if (backend == "alsa" || backend == "both")
+        reports.append(captureAlsa(config));
+
+    if (reports.isEmpty())
+    {
+        err << QString("Unknown backend \"%1\"").arg(backend) << Qt::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    out << "backend,wakeups,samples_per_wakeup,lag_min_ms,lag_p50_ms,lag_p99_ms,lag_max_ms,jitter_p99_ms,overruns,dropped,realtime"
+        << Qt::endl;
+
+    for (auto& report : reports)
+    {
+        if (!report.errMsg.isEmpty())
+        {
+            err << report.backend << ": " << report.errMsg << Qt::endl;
+            ++failures;
+            continue;
+        }
+
+        std::sort(report.lagMs.begin(), report.lagMs.end());
+        const qreal minMs = report.lagMs.isEmpty() ? 0 : report.lagMs.first();
+        out << QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11")
+               .arg(report.backend)
+               .arg(report.wakeUps)
+               .arg(report.wakeUps > 0 ? qreal(report.samples) / report.wakeUps : 0, 0, 'f', 1)
+               .arg(minMs, 0, 'f', 2)
+               .arg(percentile(report.lagMs, 0.5), 0, 'f', 2)
+               .arg(percentile(report.lagMs, 0.99), 0, 'f', 2)
+               .arg(report.lagMs.isEmpty() ? 0 : report.lagMs.last(), 0, 'f', 2)
+               .arg(percentile(report.lagMs, 0.99) - minMs, 0, 'f', 2)
+               .arg(report.overruns)
+               .arg(report.dropped)
+               .arg(report.realtime ? 1 : 0) << Qt::endl;
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+TARGET = pvcapture
+TEMPLATE = app
+
+include(../tools.pri)
+include(../../alsa.pri)
+
+QT += multimedia
+
+SOURCES += \
+    main.cpp \
+    $$PV_ROOT/src/alsaaudiosource.cpp
+
+HEADERS += \
+    $$PV_ROOT/src/alsaaudiosource.h
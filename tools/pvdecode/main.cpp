@@ -0,0 +1,279 @@
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QThread>
+#include <QUrl>
+#include <algorithm>
+#include <cstring>
+
+#include "corpus.h"
+#include "framequeue.h"
+#include "porcupine.h"
+
+///
+/// Streaming detection over compressed archives (FLAC, Ogg/Opus, ...).
+///
+/// QAudioDecoder decodes and resamples to the engine format on the main
+/// thread and fills recycled blocks of whole engine frames. A detection thread
+/// consumes the blocks, so decoding and inference overlap. The bounded queue
+/// throttles the decoder when detection falls behind. No intermediate WAV is
+/// written. Which containers and codecs are available depends on the
+/// QtMultimedia backend of the platform.
+///
+
+struct FileReport
+{
+    qint64  samples = 0;
+    qint64  wallNs = 0;
+    qint64  inferenceNs = 0;
+    qint64  decoderStallNs = 0;
+    qint64  queueFullNs = 0;
+    int     detections = 0;
+    QString errMsg;
+};
+
+static QAudioFormat engineFormat(qint32 sampleRate)
+{
+    QAudioFormat format;
+    format.setSampleRate(sampleRate);
+    format.setChannelCount(1);
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setCodec("audio/pcm");
+#else
+    format.setSampleFormat(QAudioFormat::Int16);
+#endif
+    return format;
+}
+
+static FileReport runFile(const QString& path, Porcupine* engine, int framesPerBlock, int blocks, QTextStream& out)
+{
+    FileReport report;
+    const qint32 frameLength = engine->frameLength();
+    const QAudioFormat format = engineFormat(engine->sampleRate());
+    FrameQueue queue(frameLength, framesPerBlock, blocks);
+    QElapsedTimer wallClock;
+    wallClock.start();
+    // Written by the detection thread only, report.errMsg by the decoder side only
+    QString detectErrMsg;
+
+    QThread* detector = QThread::create([&]()
+    {
+        QElapsedTimer inferenceClock;
+        qint64 frames = 0;
+        QVector<qint16>* block;
+        int keywordIndex = -1;
+
+        auto detect = [&](const char* data, int len)
+        {
+            inferenceClock.start();
+            const bool success = engine->process(keywordIndex, data, len, &detectErrMsg);
+            report.inferenceNs += inferenceClock.nsecsElapsed();
+            frames += engine->framesProcessed();
+
+            if (success && keywordIndex >= 0)
+            {
+                ++report.detections;
+                out << QString("%1\t%2\t%3").arg(path).arg(keywordIndex)
+                       .arg(frames * frameLength / qreal(engine->sampleRate()), 0, 'f', 3) << Qt::endl;
+            }
+
+            return success;
+        };
+
+        while ((block = queue.pop()) != nullptr)
+        {
+            const bool success = detect(reinterpret_cast<const char*>(block->constData()), block->size() * 2);
+            queue.release(block);
+
+            if (!success)
+                break;
+        }
+
+        // Frames left behind after a detection in the last block
+        while (detectErrMsg.isEmpty() && detect(nullptr, 0) && engine->framesProcessed() > 0)
+        {
+        }
+    });
+
+    QAudioDecoder decoder;
+    QEventLoop loop;
+    QVector<qint16>* current = nullptr;
+    decoder.setAudioFormat(format);
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    decoder.setSourceFilename(path);
+#else
+    decoder.setSource(QUrl::fromLocalFile(path));
+#endif
+
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&]()
+    {
+        const QAudioBuffer buffer = decoder.read();
+
+        if (buffer.format() != format)
+        {
+            report.errMsg = "Decoder did not deliver the requested format";
+            decoder.stop();
+            loop.quit();
+            return;
+        }
+
+        const qint16* samples = buffer.constData<qint16>();
+        int count = int(buffer.sampleCount());
+        report.samples += count;
+
+        while (count > 0)
+        {
+            if (current == nullptr)
+                current = queue.acquire();
+
+            const int filled = current->size();
+            const int n = qMin(count, queue.blockSamples() - filled);
+            current->resize(filled + n);
+            std::memcpy(current->data() + filled, samples, size_t(n) * sizeof(qint16));
+            samples += n;
+            count -= n;
+
+            if (current->size() == queue.blockSamples())
+            {
+                queue.push(current);
+                current = nullptr;
+            }
+        }
+    });
+    QObject::connect(&decoder, &QAudioDecoder::finished, &loop, &QEventLoop::quit);
+    QObject::connect(&decoder, QOverload<QAudioDecoder::Error>::of(&QAudioDecoder::error), &loop, [&]()
+    {
+        report.errMsg = decoder.errorString();
+        loop.quit();
+    });
+
+    detector->start();
+    decoder.start();
+    loop.exec();
+
+    if (current != nullptr)
+        queue.push(current);
+
+    queue.close();
+    detector->wait();
+    delete detector;
+
+    if (report.errMsg.isEmpty())
+        report.errMsg = detectErrMsg;
+
+    report.wallNs = wallClock.nsecsElapsed();
+    report.decoderStallNs = queue.consumerWaitNs();
+    report.queueFullNs = queue.producerWaitNs();
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvdecode");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Decodes compressed audio files and runs Porcupine on the "
+                                     "decoded stream, pipelined on two threads.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, default next to the executable.", "file"},
+        {"sensitivity", "Sensitivity of all keywords, default 0.5.", "value", "0.5"},
+        {"block-frames", "Engine frames per queued block, default 32.", "n", "32"},
+        {"blocks", "Number of queued blocks, default 8.", "n", "8"},
+    });
+    parser.addPositionalArgument("inputs", "Audio files or directories to process.", "inputs...");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QString accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    QVector<QString> keywordFiles;
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(keywordFiles.begin(), keywordFiles.end());
+
+    QStringList inputs;
+
+    for (const auto& input : parser.positionalArguments())
+    {
+        if (QFileInfo(input).isDir())
+        {
+            QDirIterator inputIt(input, {"*.flac", "*.opus", "*.ogg", "*.oga", "*.wav", "*.mp3"},
+                                 QDir::Files, QDirIterator::Subdirectories);
+
+            while (inputIt.hasNext())
+                inputs.append(inputIt.next());
+        }
+        else
+        {
+            inputs.append(input);
+        }
+    }
+
+    if (inputs.isEmpty())
+        parser.showHelp(1);
+
+    const int framesPerBlock = qMax(1, parser.value("block-frames").toInt());
+    const int blocks = qMax(2, parser.value("blocks").toInt());
+    const qreal sensitivity = parser.value("sensitivity").toDouble();
+    err << "file\taudio_s\twall_s\trtf\tinference_s\tdecoder_stall_s\tqueue_full_s\tdetections" << Qt::endl;
+
+    for (const auto& input : inputs)
+    {
+        // A fresh engine per file, so no state carries over between files
+        QString errMsg;
+        QScopedPointer<Porcupine> engine(Porcupine::create(accessKey,
+                                                           keywordFiles,
+                                                           parser.value("model"),
+                                                           QVector<qreal>(keywordFiles.size(), sensitivity),
+                                                           &errMsg,
+                                                           parser.value("library")));
+
+        if (engine.isNull())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        engine->enable(true);
+        const FileReport report = runFile(input, engine.data(), framesPerBlock, blocks, out);
+
+        if (!report.errMsg.isEmpty())
+        {
+            err << input << ": " << report.errMsg << Qt::endl;
+            continue;
+        }
+
+        const qreal audioSec = report.samples / qreal(engine->sampleRate());
+        const qreal wallSec = report.wallNs / 1e9;
+        err << QString("%1\t%2\t%3\t%4\t%5\t%6\t%7\t%8")
+               .arg(input)
+               .arg(audioSec, 0, 'f', 2)
+               .arg(wallSec, 0, 'f', 3)
+               .arg(audioSec > 0 ? wallSec / audioSec : 0, 0, 'f', 4)
+               .arg(report.inferenceNs / 1e9, 0, 'f', 3)
+               .arg(report.decoderStallNs / 1e9, 0, 'f', 3)
+               .arg(report.queueFullNs / 1e9, 0, 'f', 3)
+               .arg(report.detections) << Qt::endl;
+    }
+
+    return 0;
+}
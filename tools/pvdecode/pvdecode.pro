@@ -0,0 +1,13 @@
+TARGET = pvdecode
+TEMPLATE = app
+
+include(../tools.pri)
+
+QT += multimedia
+
+SOURCES += \
+    main.cpp \
+    ../common/framequeue.cpp
+
+HEADERS += \
+    ../common/framequeue.h
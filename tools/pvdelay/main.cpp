@@ -0,0 +1,433 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+
+#include "corpus.h"
+#include "porcupine.h"
+#include "stats.h"
+
+///
+/// Detection delay and accuracy regression benchmark over a labeled corpus.
+///
+/// The corpus is replayed through Porcupine::process() in packets of a given
+/// duration, like QmlPorcupine::pvProcess() receives them from the device:
+/// packets are not frame aligned and a detection leaves the rest of its packet
+/// buffered in the engine. The delay of a detection is measured in stream time,
+/// from the end of the labeled keyword to the end of the packet it was reported
+/// for, the moment the application learns about it. So the delay covers
+/// packetization and the engine's own look-ahead and does not depend on the
+/// machine. The compute time of process() per packet, which grows when several
+/// engines share the cores, is reported apart and not compared.
+///
+/// Every configuration of packet size and number of concurrent threads runs
+/// the whole corpus, by default with 1 and 4 threads on any machine, so a
+/// baseline has the same keys everywhere. With --baseline the results are
+/// compared with a stored baseline and the exit code is 2 if the delay or the
+/// accuracy regressed beyond the allowed margins. An unreadable baseline or
+/// one missing a configuration or value fails with exit code 1.
+/// --write-baseline stores the current results.
+///
+
+struct DelayConfig
+{
+    QString             accessKey;
+    QString             modelPath;
+    QString             libraryPath;
+    QVector<QString>    keywordFiles;
+    QStringList         keywordNames;
+    qreal               sensitivity = 0.5;
+    qint64              toleranceSamples = 0;
+    qint32              frameLength = 0;
+    qint32              sampleRate = 0;
+};
+
+struct ShardResult
+{
+    QVector<qreal>  delaysMs;
+    QVector<qreal>  processUs;
+    qint64          hits = 0;
+    qint64          falseAlarms = 0;
+    QString         errMsg;
+};
+
+struct RunReport
+{
+    int     packetMs = 0;
+    int     threads = 0;
+    qint64  labels = 0;
+    qint64  hits = 0;
+    qint64  falseAlarms = 0;
+    qreal   missRate = 0;
+    qreal   faPerHour = 0;
+    qreal   p50Ms = 0;
+    qreal   p90Ms = 0;
+    qreal   p99Ms = 0;
+    qreal   maxMs = 0;
+    qreal   processP99Us = 0;
+    QString errMsg;
+
+    QString key() const
+    {
+        return QString("%1ms/%2t").arg(packetMs).arg(threads);
+    }
+};
+
+static ShardResult runShard(const DelayConfig& config, const Corpus& corpus, int packetMs, int shard, int shards)
+{
+    ShardResult result;
+    QScopedPointer<Porcupine> engine(Porcupine::create(config.accessKey,
+                                                       config.keywordFiles,
+                                                       config.modelPath,
+                                                       QVector<qreal>(config.keywordFiles.size(), config.sensitivity),
+                                                       &result.errMsg,
+                                                       config.libraryPath));
+
+    if (engine.isNull())
+        return result;
+
+    const int packetSamples = qMax(1, config.sampleRate * packetMs / 1000);
+    // One second of silence between files lets the engine settle
+    const QVector<qint16> silence(config.sampleRate, 0);
+    const QVector<CorpusFile>& files = corpus.files();
+    QElapsedTimer processClock;
+
+    for (int f = shard; f < files.size(); f += shards)
+    {
+        const CorpusFile& file = files.at(f);
+        QVector<bool> used(file.labels.size(), false);
+        // Each file starts with an empty engine buffer
+        engine->enable(false);
+        engine->enable(true);
+
+        for (qint64 first = 0; first < file.pcm.size(); first += packetSamples)
+        {
+            const int count = int(qMin(qint64(packetSamples), file.pcm.size() - first));
+            int keywordIndex = -1;
+            processClock.start();
+
+            if (!engine->process(keywordIndex, reinterpret_cast<const char*>(file.pcm.constData() + first), 2 * count, &result.errMsg))
+                return result;
+
+            result.processUs.append(processClock.nsecsElapsed() / 1e3);
+
+            if (keywordIndex < 0)
+                continue;
+
+            // Reported when the packet arrived, i.e. at its last sample
+            const qint64 position = first + count;
+            const QString& keyword = config.keywordNames.at(keywordIndex);
+            int hit = -1;
+
+            for (int l = 0; l < file.labels.size() && hit < 0; ++l)
+            {
+                const CorpusLabel& label = file.labels.at(l);
+
+                if (!used.at(l) && label.keyword == keyword
+                    && position >= label.start && position <= label.end + config.toleranceSamples + packetSamples)
+                    hit = l;
+            }
+
+            if (hit < 0)
+            {
+                ++result.falseAlarms;
+                continue;
+            }
+
+            used[hit] = true;
+            ++result.hits;
+            result.delaysMs.append((position - file.labels.at(hit).end) * 1000.0 / config.sampleRate);
+        }
+
+        for (int i = 0; i + packetSamples <= silence.size(); i += packetSamples)
+        {
+            int keywordIndex = -1;
+            engine->process(keywordIndex, reinterpret_cast<const char*>(silence.constData() + i), 2 * packetSamples);
+        }
+    }
+
+    return result;
+}
+
+static RunReport runConfiguration(const DelayConfig& config, const Corpus& corpus, int packetMs, int threads, qint64 labels)
+{
+    RunReport report;
+    report.packetMs = packetMs;
+    report.threads = threads;
+    report.labels = labels;
+    // A pool of its own keeps exactly this many engines running concurrently
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QVector<QFuture<ShardResult>> futures;
+
+    for (int shard = 0; shard < threads; ++shard)
+    {
+        futures.append(QtConcurrent::run(&pool, [&config, &corpus, packetMs, shard, threads]()
+        {
+            return runShard(config, corpus, packetMs, shard, threads);
+        }));
+    }
+
+    QVector<ShardResult> results;
+
+    for (auto& future : futures)
+        results.append(future.result());
+
+    QVector<qreal> delays;
+    QVector<qreal> processUs;
+
+    for (const auto& result : results)
+    {
+        if (!result.errMsg.isEmpty())
+        {
+            report.errMsg = result.errMsg;
+            return report;
+        }
+
+        delays += result.delaysMs;
+        processUs += result.processUs;
+        report.hits += result.hits;
+        report.falseAlarms += result.falseAlarms;
+    }
+
+    std::sort(delays.begin(), delays.end());
+    std::sort(processUs.begin(), processUs.end());
+    const qreal hours = corpus.totalSamples() / qreal(config.sampleRate) / 3600;
+    report.missRate = labels > 0 ? 1.0 - qreal(report.hits) / labels : 0;
+    report.faPerHour = hours > 0 ? report.falseAlarms / hours : 0;
+    report.p50Ms = percentile(delays, 0.5);
+    report.p90Ms = percentile(delays, 0.9);
+    report.p99Ms = percentile(delays, 0.99);
+    report.maxMs = delays.isEmpty() ? 0 : delays.last();
+    report.processP99Us = percentile(processUs, 0.99);
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvdelay");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the delay from the end of a labeled keyword to its detection, "
+                                     "misses and false alarms per hour, and checks them against a baseline.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, default next to the executable.", "file"},
+        {"corpus", "Corpus directory with *.wav and *.labels files.", "dir"},
+        {"sensitivity", "Sensitivity of all keywords, default 0.5.", "value", "0.5"},
+        {"tolerance", "Seconds after the labeled end a detection still counts, default 1.", "seconds", "1"},
+        {"packet-ms", "Comma separated packet durations in ms, default 10,20,32,64,100.", "list", "10,20,32,64,100"},
+        {"threads", "Comma separated numbers of concurrent engines, default 1,4.", "list", "1,4"},
+        {"baseline", "Baseline JSON to check the results against.", "file"},
+        {"write-baseline", "Stores the results as baseline JSON.", "file"},
+        {"max-delay-ms", "Allowed increase of p50 and p90 delay in ms, default 10.", "ms", "10"},
+        {"max-miss", "Allowed increase of the miss rate, default 0.01.", "value", "0.01"},
+        {"max-fa", "Allowed increase of false alarms per hour, default 0.5.", "value", "0.5"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    DelayConfig config;
+    config.accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    config.modelPath = parser.value("model");
+    config.libraryPath = parser.value("library");
+    config.sensitivity = qBound(0.0, parser.value("sensitivity").toDouble(), 1.0);
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        config.keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(config.keywordFiles.begin(), config.keywordFiles.end());
+
+    for (const auto& file : config.keywordFiles)
+        config.keywordNames.append(corpusKeywordName(file));
+
+    QString errMsg;
+    QScopedPointer<Porcupine> probe(Porcupine::create(config.accessKey, config.keywordFiles, config.modelPath,
+                                                      QVector<qreal>(), &errMsg, config.libraryPath));
+
+    if (probe.isNull())
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    config.frameLength = probe->frameLength();
+    config.sampleRate = probe->sampleRate();
+    config.toleranceSamples = qint64(parser.value("tolerance").toDouble() * config.sampleRate);
+    probe.reset();
+
+    Corpus corpus;
+
+    if (!corpus.load(parser.value("corpus"), config.sampleRate, &errMsg))
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    qint64 labels = 0;
+
+    for (const auto& file : corpus.files())
+    {
+        for (const auto& label : file.labels)
+            labels += config.keywordNames.contains(label.keyword) ? 1 : 0;
+    }
+
+    QVector<int> packetSizes;
+    QVector<int> threadCounts;
+
+    for (const auto& value : parser.value("packet-ms").split(',', Qt::SkipEmptyParts))
+        packetSizes.append(qBound(1, value.toInt(), 1000));
+
+    // Fixed by default, not the core count, so baselines compare across machines
+    for (const auto& value : parser.value("threads").split(',', Qt::SkipEmptyParts))
+        threadCounts.append(qMax(1, value.toInt()));
+
+    QVector<RunReport> reports;
+    out << "packet_ms,threads,labels,hits,miss_rate,false_alarms,fa_per_hour,delay_p50_ms,delay_p90_ms,delay_p99_ms,delay_max_ms,"
+           "process_p99_us" << Qt::endl;
+
+    for (int packetMs : packetSizes)
+    {
+        for (int threads : threadCounts)
+        {
+            const RunReport report = runConfiguration(config, corpus, packetMs, threads, labels);
+
+            if (!report.errMsg.isEmpty())
+            {
+                err << report.errMsg << Qt::endl;
+                return 1;
+            }
+
+            out << QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11,%12")
+                   .arg(report.packetMs)
+                   .arg(report.threads)
+                   .arg(report.labels)
+                   .arg(report.hits)
+                   .arg(report.missRate, 0, 'f', 4)
+                   .arg(report.falseAlarms)
+                   .arg(report.faPerHour, 0, 'f', 3)
+                   .arg(report.p50Ms, 0, 'f', 1)
+                   .arg(report.p90Ms, 0, 'f', 1)
+                   .arg(report.p99Ms, 0, 'f', 1)
+                   .arg(report.maxMs, 0, 'f', 1)
+                   .arg(report.processP99Us, 0, 'f', 1) << Qt::endl;
+            reports.append(report);
+        }
+    }
+
+    if (parser.isSet("write-baseline"))
+    {
+        QJsonObject baseline;
+
+        for (const auto& report : reports)
+        {
+            baseline.insert(report.key(), QJsonObject{
+                {"missRate", report.missRate},
+                {"faPerHour", report.faPerHour},
+                {"p50Ms", report.p50Ms},
+                {"p90Ms", report.p90Ms},
+                {"p99Ms", report.p99Ms},
+            });
+        }
+
+        QFile file(parser.value("write-baseline"));
+
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(QJsonDocument(baseline).toJson()) < 0)
+        {
+            err << QString("Cannot write baseline \"%1\": %2").arg(file.fileName(), file.errorString()) << Qt::endl;
+            return 1;
+        }
+    }
+
+    if (!parser.isSet("baseline"))
+        return 0;
+
+    QFile file(parser.value("baseline"));
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        err << QString("Cannot read baseline \"%1\": %2").arg(file.fileName(), file.errorString()) << Qt::endl;
+        return 1;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+
+    if (parseError.error != QJsonParseError::NoError || !document.isObject())
+    {
+        err << QString("Invalid baseline \"%1\": %2").arg(file.fileName(),
+               parseError.error != QJsonParseError::NoError ? parseError.errorString() : QString("not an object"))
+            << Qt::endl;
+        return 1;
+    }
+
+    const QJsonObject baseline = document.object();
+    const qreal maxDelay = parser.value("max-delay-ms").toDouble();
+    const qreal maxMiss = parser.value("max-miss").toDouble();
+    const qreal maxFa = parser.value("max-fa").toDouble();
+    int regressions = 0;
+    int missing = 0;
+
+    for (const auto& report : reports)
+    {
+        if (!baseline.value(report.key()).isObject())
+        {
+            err << QString("%1: no baseline").arg(report.key()) << Qt::endl;
+            ++missing;
+            continue;
+        }
+
+        const QJsonObject base = baseline.value(report.key()).toObject();
+        const auto check = [&](const char* name, qreal value, qreal margin)
+        {
+            if (!base.value(name).isDouble())
+            {
+                err << QString("%1: no baseline %2").arg(report.key(), name) << Qt::endl;
+                ++missing;
+                return;
+            }
+
+            const qreal reference = base.value(name).toDouble();
+
+            if (value > reference + margin)
+            {
+                err << QString("%1: %2 regressed from %3 to %4").arg(report.key(), name).arg(reference).arg(value) << Qt::endl;
+                ++regressions;
+            }
+        };
+
+        check("p50Ms", report.p50Ms, maxDelay);
+        check("p90Ms", report.p90Ms, maxDelay);
+        check("missRate", report.missRate, maxMiss);
+        check("faPerHour", report.faPerHour, maxFa);
+    }
+
+    err << (regressions > 0 ? QString("%1 regressions").arg(regressions) : QString("no regressions")) << Qt::endl;
+
+    // An incomplete baseline would pass silently for what it does not cover
+    if (missing > 0)
+    {
+        err << QString("Baseline \"%1\" misses %2 values, rewrite it with --write-baseline").arg(file.fileName()).arg(missing)
+            << Qt::endl;
+        return 1;
+    }
+
+    return regressions > 0 ? 2 : 0;
+}
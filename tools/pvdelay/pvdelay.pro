@@ -0,0 +1,13 @@
+TARGET = pvdelay
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    main.cpp
+
+# make benchmark PVDELAY_ARGS="--model ... --keywords ... --corpus ... --baseline ..."
+# fails with the exit code of pvdelay when delay or accuracy regressed.
+benchmark.commands = $$OUT_PWD/$$TARGET $(PVDELAY_ARGS)
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
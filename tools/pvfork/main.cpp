@@ -0,0 +1,507 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+#include <random>
+
+#ifdef Q_OS_UNIX
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "corpus.h"
+#include "porcupine.h"
+#include "porcupinememory.h"
+
+///
+/// Multi-process serving with a shared model, and its memory footprint.
+///
+/// In shared mode the engine is initialized once in the parent, then worker
+/// processes are forked. Every worker keeps processing audio with its copy of
+/// the engine; model and keyword data are only read, so their pages stay
+/// shared copy-on-write and only the per-stream state is duplicated. In
+/// independent mode every forked worker initializes its own engine, like
+/// separately started processes.
+///
+/// Once all workers processed their audio they stop at a barrier, and the
+/// parent samples the PSS of each of them from /proc/<pid>/smaps_rollup.
+/// PSS charges a shared page in parts to all processes mapping it, so the sum
+/// of PSS over the workers and the parent is the memory the mode really takes.
+///
+/// Serve mode forks the workers from one initialized engine as well, but each
+/// of them serves streams: the *.wav files of --streams are dealt out round
+/// robin, a worker replays its files one after another in 20 ms packets and
+/// reports each detection over a pipe. The parent prints the detections of
+/// all workers as they arrive, so serve mode is the shared setup under real
+/// input rather than a memory measurement.
+///
+
+struct ForkConfig
+{
+    QString         accessKey;
+    QString         modelPath;
+    QVector<QString> keywordFiles;
+    QString         libraryPath;
+    int             workers = 4;
+    int             seconds = 10;
+    QStringList     streams;
+};
+
+struct WorkerReport
+{
+    qint64  pid = 0;
+    PorcupineMemory::Usage memory;
+};
+
+static Porcupine* createEngine(const ForkConfig& config, QString* errMsg)
+{
+    Porcupine* engine = Porcupine::create(config.accessKey,
+                                          config.keywordFiles,
+                                          config.modelPath,
+                                          QVector<qreal>(config.keywordFiles.size(), 0.5),
+                                          errMsg,
+                                          config.libraryPath);
+
+    if (engine != nullptr)
+        engine->enable(true);
+
+    return engine;
+}
+
+static bool processAudio(Porcupine* engine, int seconds, int seed)
+{
+    // Low level noise in 20 ms packets, as fast as the engine takes it
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0, 300);
+    QVector<qint16> packet(engine->sampleRate() / 50);
+
+    for (int i = 0; i < 50 * seconds; ++i)
+    {
+        for (auto& sample : packet)
+            sample = qint16(qBound(-32768.0f, noise(rng), 32767.0f));
+
+        int keywordIndex = -1;
+
+        if (!engine->process(keywordIndex, reinterpret_cast<const char*>(packet.constData()), packet.size() * 2))
+            return false;
+    }
+
+    return true;
+}
+
+#ifdef Q_OS_UNIX
+
+//
+// Forks the workers, samples their memory at the barrier and reaps them.
+// With engine == nullptr every worker creates its own engine.
+//
+static QVector<WorkerReport> runWorkers(const ForkConfig& config, Porcupine* engine, QString* errMsg)
+{
+    QVector<WorkerReport> reports;
+    QVector<int> readyFds;
+    QVector<int> releaseFds;
+
+    for (int i = 0; i < config.workers; ++i)
+    {
+        int ready[2];
+        int release[2];
+
+        if (pipe(ready) != 0 || pipe(release) != 0)
+        {
+            *errMsg = "Cannot create pipes for the workers.";
+            break;
+        }
+
+        const pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            // Worker, leaves with _exit so no parent state is destructed twice
+            close(ready[0]);
+            close(release[1]);
+            QString workerErr;
+            Porcupine* worker = engine != nullptr ? engine : createEngine(config, &workerErr);
+            char status = worker != nullptr && processAudio(worker, config.seconds, i + 1) ? 1 : 0;
+
+            if (write(ready[1], &status, 1) == 1)
+                (void) read(release[0], &status, 1);
+
+            _exit(status == 1 ? 0 : 1);
+        }
+
+        close(ready[1]);
+        close(release[0]);
+
+        if (pid < 0)
+        {
+            close(ready[0]);
+            close(release[1]);
+            *errMsg = "Cannot fork a worker.";
+            break;
+        }
+
+        WorkerReport report;
+        report.pid = pid;
+        reports.append(report);
+        readyFds.append(ready[0]);
+        releaseFds.append(release[1]);
+    }
+
+    for (int i = 0; i < reports.size(); ++i)
+    {
+        char status = 0;
+
+        if (read(readyFds.at(i), &status, 1) != 1 || status != 1)
+            *errMsg = QString("Worker %1 failed to initialize or process audio.").arg(reports.at(i).pid);
+    }
+
+    // All workers are alive and waiting, so shared pages are split between all
+    // of them. The parent maps the same pages and is reported last.
+    for (auto& report : reports)
+        report.memory = PorcupineMemory::sample(report.pid);
+
+    WorkerReport parent;
+    parent.pid = getpid();
+    parent.memory = PorcupineMemory::sample();
+
+    for (int i = 0; i < reports.size(); ++i)
+    {
+        const char release = 1;
+        (void) write(releaseFds.at(i), &release, 1);
+        close(releaseFds.at(i));
+        close(readyFds.at(i));
+        waitpid(pid_t(reports.at(i).pid), nullptr, 0);
+    }
+
+    reports.append(parent);
+    return reports;
+}
+
+//
+// Worker side of serve mode, replays the streams of worker index and writes
+// one line per detection to fd. Returns false on a read or engine error.
+//
+static bool serveStreams(const ForkConfig& config, Porcupine* engine, int index, int fd)
+{
+    const qint32 sampleRate = engine->sampleRate();
+    const int packetSamples = sampleRate / 50;
+    QStringList keywords;
+
+    for (const auto& file : config.keywordFiles)
+        keywords.append(corpusKeywordName(file));
+
+    for (int i = index; i < config.streams.size(); i += config.workers)
+    {
+        const QString& path = config.streams.at(i);
+        QVector<qint16> pcm;
+        QString errMsg;
+
+        if (!Corpus::readWav(path, sampleRate, &pcm, &errMsg))
+        {
+            const QByteArray line = QString("#%1\n").arg(errMsg).toUtf8();
+            (void) write(fd, line.constData(), size_t(line.size()));
+            return false;
+        }
+
+        for (int offset = 0; offset < pcm.size(); offset += packetSamples)
+        {
+            const int samples = qMin(packetSamples, pcm.size() - offset);
+            int keywordIndex = -1;
+
+            if (!engine->process(keywordIndex, reinterpret_cast<const char*>(pcm.constData() + offset), samples * 2))
+                return false;
+
+            if (keywordIndex >= 0)
+            {
+                const QByteArray line = QString("%1,%2,%3,%4,%5\n")
+                                        .arg(index)
+                                        .arg(getpid())
+                                        .arg(QFileInfo(path).fileName())
+                                        .arg(qreal(offset + samples) / sampleRate, 0, 'f', 3)
+                                        .arg(keywords.value(keywordIndex)).toUtf8();
+
+                if (write(fd, line.constData(), size_t(line.size())) != line.size())
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// Forks the serving workers from the initialized engine and prints their
+// detections until every worker has finished its streams.
+//
+static bool runServe(const ForkConfig& config, Porcupine* engine, QTextStream& out, QString* errMsg)
+{
+    QVector<pid_t> pids;
+    QVector<pollfd> fds;
+    QVector<QByteArray> pending;
+
+    for (int i = 0; i < config.workers; ++i)
+    {
+        int detections[2];
+
+        if (pipe(detections) != 0)
+        {
+            *errMsg = "Cannot create pipes for the workers.";
+            break;
+        }
+
+        const pid_t pid = fork();
+
+        if (pid == 0)
+        {
+            // Worker, leaves with _exit so no parent state is destructed twice
+            for (const auto& fd : fds)
+                close(fd.fd);
+
+            close(detections[0]);
+            const bool served = serveStreams(config, engine, i, detections[1]);
+            close(detections[1]);
+            _exit(served ? 0 : 1);
+        }
+
+        close(detections[1]);
+
+        if (pid < 0)
+        {
+            close(detections[0]);
+            *errMsg = "Cannot fork a worker.";
+            break;
+        }
+
+        pids.append(pid);
+        fds.append({detections[0], POLLIN, 0});
+        pending.append(QByteArray());
+    }
+
+    int remaining = fds.size();
+
+    while (remaining > 0 && poll(fds.data(), nfds_t(fds.size()), -1) >= 0)
+    {
+        for (int i = 0; i < fds.size(); ++i)
+        {
+            if (fds.at(i).fd < 0 || fds.at(i).revents == 0)
+                continue;
+
+            char buffer[4096];
+            const ssize_t bytesRead = read(fds.at(i).fd, buffer, sizeof(buffer));
+
+            if (bytesRead <= 0)
+            {
+                close(fds.at(i).fd);
+                fds[i].fd = -1;
+                --remaining;
+                continue;
+            }
+
+            pending[i].append(buffer, int(bytesRead));
+            int end;
+
+            while ((end = pending.at(i).indexOf('\n')) >= 0)
+            {
+                const QString line = QString::fromUtf8(pending.at(i).left(end));
+                pending[i].remove(0, end + 1);
+
+                // Worker errors start with '#'
+                if (line.startsWith('#'))
+                    *errMsg = line.mid(1);
+                else
+                    out << line << Qt::endl;
+            }
+        }
+    }
+
+    for (int i = 0; i < pids.size(); ++i)
+    {
+        int status = 0;
+
+        if (waitpid(pids.at(i), &status, 0) != pids.at(i) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            if (errMsg->isEmpty())
+                *errMsg = QString("Worker %1 failed to serve its streams.").arg(pids.at(i));
+        }
+    }
+
+    return errMsg->isEmpty();
+}
+
+#endif
+
+static void printReports(QTextStream& out, const QString& mode, const QVector<WorkerReport>& reports)
+{
+    for (int i = 0; i < reports.size(); ++i)
+    {
+        const PorcupineMemory::Usage& memory = reports.at(i).memory;
+        out << QString("%1,%2,%3,%4,%5,%6,%7")
+               .arg(mode)
+               .arg(i + 1 < reports.size() ? QString::number(i) : QString("parent"))
+               .arg(reports.at(i).pid)
+               .arg(memory.rss / 1024)
+               .arg(memory.pss / 1024)
+               .arg(memory.sharedClean / 1024)
+               .arg(memory.privateDirty / 1024) << Qt::endl;
+    }
+}
+
+static qint64 totalPss(const QVector<WorkerReport>& reports)
+{
+    qint64 total = 0;
+
+    for (const auto& report : reports)
+        total += report.memory.pss;
+
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvfork");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Serves streams from forked worker processes sharing one initialized engine "
+                                     "and compares their PSS with independently initialized workers.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, e.g. the stub of tools/pvstub.", "file"},
+        {"workers", "Number of worker processes, default 4.", "n", "4"},
+        {"seconds", "Audio processed per worker in seconds, default 10.", "s", "10"},
+        {"mode", "shared, independent, both or serve, default both.", "mode", "both"},
+        {"streams", "Serve mode: directory of *.wav streams dealt out to the workers.", "dir"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+#ifdef Q_OS_UNIX
+    ForkConfig config;
+    config.accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    config.modelPath = parser.value("model");
+    config.libraryPath = parser.value("library");
+    config.workers = qMax(1, parser.value("workers").toInt());
+    config.seconds = qMax(1, parser.value("seconds").toInt());
+    const QString mode = parser.value("mode");
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        config.keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(config.keywordFiles.begin(), config.keywordFiles.end());
+    QString errMsg;
+
+    if (mode == "serve")
+    {
+        QDirIterator streamsIt(parser.value("streams"), {"*.wav"}, QDir::Files);
+
+        while (streamsIt.hasNext())
+            config.streams.append(streamsIt.next());
+
+        std::sort(config.streams.begin(), config.streams.end());
+
+        if (config.streams.isEmpty())
+        {
+            err << "Serve mode needs a --streams directory with *.wav files." << Qt::endl;
+            return 1;
+        }
+
+        QScopedPointer<Porcupine> engine(createEngine(config, &errMsg));
+
+        if (engine.isNull())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        out << "worker,pid,stream,time_s,keyword" << Qt::endl;
+
+        if (!runServe(config, engine.data(), out, &errMsg))
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    PorcupineMemory::enable(true);
+
+    if (!PorcupineMemory::sample().isValid())
+    {
+        err << "No memory accounting, /proc/<pid>/smaps_rollup is not available." << Qt::endl;
+        return 1;
+    }
+
+    QVector<WorkerReport> independent;
+    QVector<WorkerReport> shared;
+    out << "mode,worker,pid,rss_kib,pss_kib,shared_clean_kib,private_dirty_kib" << Qt::endl;
+
+    // Independent first, the parent must not have loaded the engine yet
+    if (mode == "independent" || mode == "both")
+    {
+        independent = runWorkers(config, nullptr, &errMsg);
+
+        if (!errMsg.isEmpty())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        printReports(out, "independent", independent);
+    }
+
+    if (mode == "shared" || mode == "both")
+    {
+        QScopedPointer<Porcupine> engine(createEngine(config, &errMsg));
+
+        if (engine.isNull())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        err << QString("engine init: %1").arg(engine->memoryFootprint().format()) << Qt::endl;
+        shared = runWorkers(config, engine.data(), &errMsg);
+
+        if (!errMsg.isEmpty())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        printReports(out, "shared", shared);
+    }
+
+    if (!independent.isEmpty())
+        err << QString("independent: PSS %1 total, %2 per worker")
+               .arg(PorcupineMemory::formatBytes(totalPss(independent)),
+                    PorcupineMemory::formatBytes(totalPss(independent) / config.workers)) << Qt::endl;
+
+    if (!shared.isEmpty())
+        err << QString("shared: PSS %1 total, %2 per worker")
+               .arg(PorcupineMemory::formatBytes(totalPss(shared)),
+                    PorcupineMemory::formatBytes(totalPss(shared) / config.workers)) << Qt::endl;
+
+    if (!independent.isEmpty() && !shared.isEmpty() && totalPss(independent) > 0)
+        err << QString("saving: %1%").arg(100.0 * (totalPss(independent) - totalPss(shared)) / totalPss(independent), 0, 'f', 1)
+            << Qt::endl;
+
+    return 0;
+#else
+    Q_UNUSED(parser)
+    Q_UNUSED(out)
+    err << "pvfork needs fork(), it is not available on this platform." << Qt::endl;
+    return 1;
+#endif
+}
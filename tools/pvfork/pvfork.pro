@@ -0,0 +1,7 @@
+TARGET = pvfork
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    main.cpp
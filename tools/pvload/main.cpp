@@ -0,0 +1,550 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "corpus.h"
+#include "porcupine.h"
+#include "porcupinelog.h"
+#include "porcupineperf.h"
+
+///
+/// Synthetic multi-stream load generator for capacity planning.
+///
+/// Every virtual stream runs on its own thread with its own engine and plays
+/// an audio device: packets arrive at a nominal period with random jitter and
+/// carry exactly the samples captured since the previous arrival, so packet
+/// sizes vary like those of a real device. Each packet goes through
+/// Porcupine::process() as in QmlPorcupine::pvProcess(). The latency of a
+/// packet is the time from its arrival until it has been processed, it includes
+/// late wake-ups when the cores are oversubscribed.
+///
+/// The number of streams is ramped until the p99 latency or the real-time
+/// factor of the slowest stream crosses its limit. With the stub runtime
+/// library of tools/pvstub the per-frame cost is set by PV_STUB_FRAME_US.
+/// With --perf the hardware counters of all engines are summed per step, so
+/// IPC and cache misses per frame show the interference between streams.
+///
+/// With --log-cost the ramp is replaced by a benchmark of the log cost per
+/// detection: 1, 2, 4, ... threads post keyword detection records to
+/// PorcupineLog at a fixed rate, and the time of every post() on the
+/// detecting thread, the dropped records and the time until the writer has
+/// drained the queue are reported. The writer's output is discarded.
+///
+/// With --keyword-cost the frame cost is measured against the number of
+/// active keywords instead: one engine per count, with the first 1, 2, ...
+/// keyword files, processes the source audio as fast as it can.
+///
+
+struct LoadConfig
+{
+    QString         accessKey;
+    QString         modelPath;
+    QVector<QString> keywordFiles;
+    QString         libraryPath;
+    int             packetMs = 20;
+    int             jitterMs = 5;
+    int             durationMs = 10000;
+};
+
+struct StreamResult
+{
+    QVector<qint32> latencyUs;
+    qint64  samples = 0;
+    qint64  processNs = 0;
+    qint64  latePackets = 0;
+    QString errMsg;
+};
+
+struct StepReport
+{
+    int     streams = 0;
+    qint64  packets = 0;
+    qint64  latePackets = 0;
+    qreal   p50Ms = 0;
+    qreal   p99Ms = 0;
+    qreal   maxMs = 0;
+    qreal   rtfMean = 0;
+    qreal   rtfMax = 0;
+    PorcupinePerf::Counters perf;
+    QString errMsg;
+};
+
+static void runStream(Porcupine* engine, const QVector<qint16>& source, const LoadConfig& config, int seed, StreamResult* result)
+{
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> jitter(-config.jitterMs * 1000, config.jitterMs * 1000);
+    std::uniform_int_distribution<int> phase(0, config.packetMs * 1000);
+    const qint32 sampleRate = engine->sampleRate();
+    const auto period = std::chrono::milliseconds(config.packetMs);
+    // Streams start at random phases and source positions, like independent devices
+    const auto start = Clock::now() + std::chrono::microseconds(phase(rng));
+    const auto end = start + std::chrono::milliseconds(config.durationMs);
+    qint64 position = std::uniform_int_distribution<qint64>(0, source.size() - 1)(rng);
+    qint64 delivered = 0;
+    QVector<qint16> packet(sampleRate);
+    auto nominal = start + period;
+    QElapsedTimer processClock;
+    result->latencyUs.reserve(int(config.durationMs / qMax(1, config.packetMs)) + 1);
+
+    while (nominal < end)
+    {
+        const auto arrival = nominal + std::chrono::microseconds(jitter(rng));
+        std::this_thread::sleep_until(arrival);
+        const auto wakeUp = Clock::now();
+
+        if (wakeUp - arrival > period)
+            ++result->latePackets;
+
+        // All samples captured until the arrival, at most one second per packet
+        const qint64 due = std::chrono::duration_cast<std::chrono::microseconds>(arrival - start).count()
+                           * sampleRate / 1000000;
+        const int count = int(qBound(qint64(0), due - delivered, qint64(packet.size())));
+
+        for (int i = 0; i < count; ++i)
+        {
+            packet[i] = source.at(int(position));
+            position = (position + 1) % source.size();
+        }
+
+        delivered += count;
+        processClock.start();
+        int keywordIndex = -1;
+        bool success = engine->process(keywordIndex, reinterpret_cast<const char*>(packet.constData()), count * 2, &result->errMsg);
+
+        // A detection stops processing the packet, drain the rest like a following wake-up would
+        while (success && keywordIndex >= 0 && engine->framesProcessed() > 0)
+            success = engine->process(keywordIndex, nullptr, 0, &result->errMsg);
+
+        result->processNs += processClock.nsecsElapsed();
+        result->samples += count;
+        result->latencyUs.append(qint32(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - arrival).count()));
+
+        if (!success)
+            return;
+
+        nominal += period;
+    }
+}
+
+static StepReport runStep(int streams, const LoadConfig& config, const QVector<qint16>& source)
+{
+    StepReport report;
+    report.streams = streams;
+    QVector<Porcupine*> engines;
+
+    // Engine creation is not part of the measurement
+    for (int i = 0; i < streams; ++i)
+    {
+        Porcupine* engine = Porcupine::create(config.accessKey,
+                                              config.keywordFiles,
+                                              config.modelPath,
+                                              QVector<qreal>(config.keywordFiles.size(), 0.5),
+                                              &report.errMsg,
+                                              config.libraryPath);
+
+        if (engine == nullptr)
+        {
+            qDeleteAll(engines);
+            return report;
+        }
+
+        engine->enable(true);
+        engines.append(engine);
+    }
+
+    QVector<StreamResult> results(streams);
+    QVector<QThread*> threads;
+
+    for (int i = 0; i < streams; ++i)
+    {
+        threads.append(QThread::create(runStream, engines.at(i), std::cref(source), std::cref(config), i + 1, &results[i]));
+        threads.last()->start(QThread::TimeCriticalPriority);
+    }
+
+    for (auto thread : threads)
+        thread->wait();
+
+    qDeleteAll(threads);
+    const qint32 sampleRate = engines.first()->sampleRate();
+
+    for (auto engine : engines)
+    {
+        const PorcupinePerf::Counters perf = engine->perfCounters();
+        report.perf.frames += perf.frames;
+        report.perf.cycles += perf.cycles;
+        report.perf.instructions += perf.instructions;
+        report.perf.llcMisses += perf.llcMisses;
+        report.perf.branchMisses += perf.branchMisses;
+        report.perf.contextSwitches += perf.contextSwitches;
+    }
+    qDeleteAll(engines);
+    QVector<qint32> latencies;
+
+    for (const auto& result : results)
+    {
+        if (!result.errMsg.isEmpty())
+        {
+            report.errMsg = result.errMsg;
+            return report;
+        }
+
+        latencies += result.latencyUs;
+        report.latePackets += result.latePackets;
+        const qreal rtf = result.samples > 0 ? result.processNs / (result.samples * 1e9 / sampleRate) : 0;
+        report.rtfMean += rtf / streams;
+        report.rtfMax = qMax(report.rtfMax, rtf);
+    }
+
+    report.packets = latencies.size();
+
+    if (latencies.isEmpty())
+        return report;
+
+    std::sort(latencies.begin(), latencies.end());
+    report.p50Ms = latencies.at(latencies.size() / 2) / 1e3;
+    report.p99Ms = latencies.at(qMin(latencies.size() - 1, int(latencies.size() * 0.99))) / 1e3;
+    report.maxMs = latencies.last() / 1e3;
+    return report;
+}
+
+struct KeywordCostReport
+{
+    int     keywords = 0;
+    qint64  frames = 0;
+    qreal   usPerFrame = 0;
+    qreal   rtf = 0;
+    QString errMsg;
+};
+
+static KeywordCostReport runKeywordCost(int keywords, const LoadConfig& config, const QVector<qint16>& source)
+{
+    KeywordCostReport report;
+    report.keywords = keywords;
+    const QVector<QString> files = config.keywordFiles.mid(0, keywords);
+    QScopedPointer<Porcupine> engine(Porcupine::create(config.accessKey,
+                                                       files,
+                                                       config.modelPath,
+                                                       QVector<qreal>(files.size(), 0.5),
+                                                       &report.errMsg,
+                                                       config.libraryPath));
+
+    if (engine.isNull())
+        return report;
+
+    engine->enable(true);
+    const int packetBytes = engine->sampleRate() * config.packetMs / 1000 * 2;
+    const char* data = reinterpret_cast<const char*>(source.constData());
+    const int size = source.size() * 2;
+    // The whole source once, at least durationMs of audio
+    const qint64 totalBytes = qMax(qint64(size), qint64(config.durationMs) * engine->sampleRate() / 1000 * 2);
+    QElapsedTimer processClock;
+    qint64 processNs = 0;
+    qint64 offset = 0;
+
+    while (offset < totalBytes)
+    {
+        const int position = int(offset % size);
+        const int count = qMin(packetBytes, size - position);
+        int keywordIndex = -1;
+        processClock.start();
+        bool success = engine->process(keywordIndex, data + position, count, &report.errMsg);
+
+        while (success && keywordIndex >= 0 && engine->framesProcessed() > 0)
+        {
+            report.frames += engine->framesProcessed();
+            success = engine->process(keywordIndex, nullptr, 0, &report.errMsg);
+        }
+
+        processNs += processClock.nsecsElapsed();
+        report.frames += engine->framesProcessed();
+        offset += count;
+
+        if (!success)
+            return report;
+    }
+
+    if (report.frames > 0)
+    {
+        report.usPerFrame = processNs / 1e3 / report.frames;
+        report.rtf = processNs / (report.frames * 1e9 * engine->frameLength() / engine->sampleRate());
+    }
+
+    return report;
+}
+
+struct LogCostReport
+{
+    int     threads = 0;
+    qint64  records = 0;
+    qint64  dropped = 0;
+    qint64  p50Ns = 0;
+    qint64  p99Ns = 0;
+    qint64  maxNs = 0;
+    qreal   drainMs = 0;
+};
+
+static void discardMessage(QtMsgType, const QMessageLogContext&, const QString&)
+{
+}
+
+static void postDetections(int records, int intervalUs, QVector<qint32>* postNs)
+{
+    using Clock = std::chrono::steady_clock;
+    PorcupineLog& log = PorcupineLog::instance();
+    auto next = Clock::now();
+
+    for (int i = 0; i < records; ++i)
+    {
+        // Busy wait, detections arrive between frames of a running engine
+        while (Clock::now() < next)
+            ;
+
+        const auto start = Clock::now();
+        log.post(PorcupineLog::Info, PorcupineLog::KeywordDetected, i % 8);
+        (*postNs)[i] = qint32(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        next += std::chrono::microseconds(intervalUs);
+    }
+}
+
+static LogCostReport runLogCost(int threads, int records, int intervalUs)
+{
+    LogCostReport report;
+    report.threads = threads;
+    PorcupineLog& log = PorcupineLog::instance();
+    const qint64 droppedBefore = log.droppedRecords();
+    QVector<QVector<qint32>> postNs(threads, QVector<qint32>(records));
+    QVector<QThread*> workers;
+
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.append(QThread::create(postDetections, records, intervalUs, &postNs[i]));
+        workers.last()->start(QThread::TimeCriticalPriority);
+    }
+
+    for (auto worker : workers)
+        worker->wait();
+
+    qDeleteAll(workers);
+    QElapsedTimer drainClock;
+    drainClock.start();
+    log.flush();
+    report.drainMs = drainClock.nsecsElapsed() / 1e6;
+    report.dropped = log.droppedRecords() - droppedBefore;
+    QVector<qint32> all;
+
+    for (const auto& samples : postNs)
+        all += samples;
+
+    std::sort(all.begin(), all.end());
+    report.records = all.size();
+    report.p50Ns = all.at(all.size() / 2);
+    report.p99Ns = all.at(qMin(all.size() - 1, int(all.size() * 0.99)));
+    report.maxNs = all.last();
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvload");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Ramps the number of concurrent virtual streams until the latency "
+                                     "or real-time factor limit is crossed and reports the capacity curve.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, e.g. the stub of tools/pvstub.", "file"},
+        {"corpus", "Directory of *.wav files to play, default synthetic noise.", "dir"},
+        {"packet-ms", "Nominal packet period in ms, default 20.", "ms", "20"},
+        {"jitter-ms", "Maximum arrival jitter in ms, default 5.", "ms", "5"},
+        {"duration", "Measurement time per step in seconds, default 10.", "s", "10"},
+        {"from", "First number of streams, default 1.", "n", "1"},
+        {"step", "Streams added per step, default 1.", "n", "1"},
+        {"max", "Largest number of streams, default 8 per core.", "n"},
+        {"p99-ms", "p99 latency limit in ms, default 50.", "ms", "50"},
+        {"max-rtf", "Real-time factor limit of the slowest stream, default 0.8.", "value", "0.8"},
+        {"perf", "Report hardware counters per step (Linux perf_event_open)."},
+        {"keyword-cost", "Measure the frame cost per number of active keywords instead of the stream ramp."},
+        {"log-cost", "Benchmark the log cost per detection instead of the stream ramp."},
+        {"log-records", "Detections posted per thread with --log-cost, default 100000.", "n", "100000"},
+        {"log-interval-us", "Interval between detections per thread in us with --log-cost, default 20.", "us", "20"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (parser.isSet("log-cost"))
+    {
+        const int records = qMax(1, parser.value("log-records").toInt());
+        const int intervalUs = qMax(0, parser.value("log-interval-us").toInt());
+        // The writer thread runs before the measurement, like in the application
+        PorcupineLog::instance();
+        qInstallMessageHandler(discardMessage);
+        out << "threads,records,dropped,post_p50_ns,post_p99_ns,post_max_ns,drain_ms" << Qt::endl;
+
+        for (int threads = 1; threads <= QThread::idealThreadCount(); threads *= 2)
+        {
+            const LogCostReport report = runLogCost(threads, records, intervalUs);
+            out << QString("%1,%2,%3,%4,%5,%6,%7")
+                   .arg(report.threads)
+                   .arg(report.records)
+                   .arg(report.dropped)
+                   .arg(report.p50Ns)
+                   .arg(report.p99Ns)
+                   .arg(report.maxNs)
+                   .arg(report.drainMs, 0, 'f', 2) << Qt::endl;
+        }
+
+        qInstallMessageHandler(nullptr);
+        return 0;
+    }
+    LoadConfig config;
+    config.accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    config.modelPath = parser.value("model");
+    config.libraryPath = parser.value("library");
+    config.packetMs = qMax(1, parser.value("packet-ms").toInt());
+    config.jitterMs = qBound(0, parser.value("jitter-ms").toInt(), config.packetMs - 1);
+    config.durationMs = qMax(1, parser.value("duration").toInt()) * 1000;
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        config.keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(config.keywordFiles.begin(), config.keywordFiles.end());
+
+    // Probe engine for the audio format
+    QString errMsg;
+    QScopedPointer<Porcupine> probe(Porcupine::create(config.accessKey,
+                                                      config.keywordFiles,
+                                                      config.modelPath,
+                                                      QVector<qreal>(),
+                                                      &errMsg,
+                                                      config.libraryPath));
+
+    if (probe.isNull())
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    const qint32 sampleRate = probe->sampleRate();
+    probe.reset();
+    QVector<qint16> source;
+
+    if (parser.isSet("corpus"))
+    {
+        Corpus corpus;
+
+        if (!corpus.load(parser.value("corpus"), sampleRate, &errMsg))
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        for (const auto& file : corpus.files())
+            source += file.pcm;
+    }
+
+    if (source.isEmpty())
+        source = syntheticAudio(sampleRate);
+
+    if (parser.isSet("keyword-cost"))
+    {
+        out << "keywords,frames,us_per_frame,rtf" << Qt::endl;
+
+        for (int keywords = 1; keywords <= config.keywordFiles.size(); ++keywords)
+        {
+            const KeywordCostReport report = runKeywordCost(keywords, config, source);
+
+            if (!report.errMsg.isEmpty())
+            {
+                err << report.errMsg << Qt::endl;
+                return 1;
+            }
+
+            out << QString("%1,%2,%3,%4")
+                   .arg(report.keywords)
+                   .arg(report.frames)
+                   .arg(report.usPerFrame, 0, 'f', 2)
+                   .arg(report.rtf, 0, 'f', 4) << Qt::endl;
+        }
+
+        return 0;
+    }
+
+    const int from = qMax(1, parser.value("from").toInt());
+    const int step = qMax(1, parser.value("step").toInt());
+    const int maxStreams = parser.isSet("max") ? parser.value("max").toInt() : 8 * QThread::idealThreadCount();
+    const qreal p99Limit = parser.value("p99-ms").toDouble();
+    const qreal rtfLimit = parser.value("max-rtf").toDouble();
+    int capacity = 0;
+    QString limit = "max streams";
+
+    bool perf = false;
+
+    if (parser.isSet("perf") && !(perf = PorcupinePerf::enable(true, &errMsg)))
+        err << "Hardware counters not available: " << errMsg << Qt::endl;
+
+    out << "streams,packets,late,p50_ms,p99_ms,max_ms,rtf_mean,rtf_max"
+        << (perf ? ",ipc,cycles_per_frame,llc_misses_per_frame,branch_misses_per_frame,context_switches" : "") << Qt::endl;
+
+    for (int streams = from; streams <= maxStreams; streams += step)
+    {
+        const StepReport report = runStep(streams, config, source);
+
+        if (!report.errMsg.isEmpty())
+        {
+            err << report.errMsg << Qt::endl;
+            limit = "engine error";
+            break;
+        }
+
+        out << QString("%1,%2,%3,%4,%5,%6,%7,%8")
+               .arg(report.streams)
+               .arg(report.packets)
+               .arg(report.latePackets)
+               .arg(report.p50Ms, 0, 'f', 2)
+               .arg(report.p99Ms, 0, 'f', 2)
+               .arg(report.maxMs, 0, 'f', 2)
+               .arg(report.rtfMean, 0, 'f', 4)
+               .arg(report.rtfMax, 0, 'f', 4);
+
+        if (perf)
+        {
+            out << QString(",%1,%2,%3,%4,%5")
+                   .arg(report.perf.ipc(), 0, 'f', 3)
+                   .arg(report.perf.perFrame(report.perf.cycles), 0, 'f', 0)
+                   .arg(report.perf.perFrame(report.perf.llcMisses), 0, 'f', 2)
+                   .arg(report.perf.perFrame(report.perf.branchMisses), 0, 'f', 2)
+                   .arg(report.perf.contextSwitches);
+        }
+
+        out << Qt::endl;
+
+        if (report.p99Ms > p99Limit || report.rtfMax > rtfLimit)
+        {
+            limit = report.p99Ms > p99Limit ? "p99 latency" : "real-time factor";
+            break;
+        }
+
+        capacity = streams;
+    }
+
+    err << QString("capacity: %1 streams (limited by %2)").arg(capacity).arg(limit) << Qt::endl;
+    return 0;
+}
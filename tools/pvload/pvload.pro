@@ -0,0 +1,7 @@
+TARGET = pvload
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,222 @@
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QThread>
+
+#include "audiopipeline.h"
+#include "audiostages.h"
+#include "check.h"
+
+///
+/// Checks of the frame pool and the audio pipeline, no engine is involved.
+///
+/// - FramePool: references from acquire(), retain() and release(), and the
+///   exhaustion of the pool.
+/// - GainStage: saturation of large gains instead of an integer overflow.
+/// - Threaded pipeline: stop() processes the queued frames before the stage
+///   threads end, and a following start() continues the stream, so every
+///   frame reaches the sink once and in order.
+///
+/// Exits with code 1 if a check failed.
+///
+
+namespace
+{
+
+///
+/// Source of a given number of frames, each filled with its frame number.
+///
+class CountingSource : public AudioSource
+{
+
+public:
+    void add(int frames)
+    {
+        m_remaining += frames;
+    }
+
+    AudioFrame next(FramePool* pool) override
+    {
+        if (m_remaining == 0)
+            return AudioFrame();
+
+        AudioFrame frame = pool->acquire();
+
+        if (!frame.isValid())
+            return frame;
+
+        for (int i = 0; i < frame.length; ++i)
+            frame.samples[i] = qint16(m_frames);
+
+        frame.position = m_frames * frame.length;
+        ++m_frames;
+        --m_remaining;
+        return frame;
+    }
+
+private:
+    int     m_remaining = 0;
+    qint64  m_frames = 0;
+};
+
+///
+/// Converter taking its time, so frames queue up behind it.
+///
+class SlowStage : public AudioStage
+{
+
+public:
+    SlowStage()
+        : AudioStage("slow")
+    {
+    }
+
+    bool process(AudioFrame& frame) override
+    {
+        Q_UNUSED(frame)
+        QThread::usleep(500);
+        return true;
+    }
+};
+
+///
+/// Sink recording the frame number of every frame.
+///
+class RecordingStage : public AudioStage
+{
+
+public:
+    RecordingStage()
+        : AudioStage("record")
+    {
+        frames.reserve(1024);
+    }
+
+    bool process(AudioFrame& frame) override
+    {
+        frames.append(frame.samples[0]);
+        return true;
+    }
+
+    QVector<qint16> frames;
+};
+
+void checkFramePool(QTextStream& out)
+{
+    FramePool pool(8, 4);
+    AudioFrame frames[4];
+    bool distinct = true;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        frames[i] = pool.acquire();
+        distinct &= frames[i].isValid() && frames[i].length == 8;
+
+        for (int j = 0; j < i; ++j)
+            distinct &= frames[i].slot != frames[j].slot;
+    }
+
+    check(out, distinct, "acquire() hands out every frame of the pool once");
+
+    AudioFrame none = pool.acquire();
+    check(out, !none.isValid() && pool.exhausted() == 1, "acquire() fails on an exhausted pool and counts it");
+
+    const int slot = frames[0].slot;
+    AudioFrame kept = frames[0];
+    pool.retain(kept);
+    pool.release(frames[0]);
+    check(out, !frames[0].isValid(), "release() invalidates the view");
+    check(out, !pool.acquire().isValid(), "a retained frame stays in use after one release()");
+
+    pool.release(kept);
+    AudioFrame reused = pool.acquire();
+    check(out, reused.isValid() && reused.slot == slot, "the frame is free again with the last release()");
+
+    pool.release(reused);
+
+    for (int i = 1; i < 4; ++i)
+        pool.release(frames[i]);
+
+    int free = 0;
+    AudioFrame all[4];
+
+    for (auto& frame : all)
+        free += (frame = pool.acquire()).isValid() ? 1 : 0;
+
+    check(out, free == 4, "all frames are free after releasing them");
+
+    for (auto& frame : all)
+        pool.release(frame);
+}
+
+void checkGain(QTextStream& out)
+{
+    FramePool pool(4, 1);
+    AudioFrame frame = pool.acquire();
+    frame.samples[0] = 32767;
+    frame.samples[1] = -32768;
+    frame.samples[2] = 100;
+    frame.samples[3] = 0;
+
+    // +30 dB, the product of sample and Q12 gain exceeds the int range
+    GainStage gain(30);
+    gain.process(frame);
+    check(out, frame.samples[0] == 32767 && frame.samples[1] == -32768, "GainStage saturates large gains");
+    check(out, qAbs(frame.samples[2] - 3162) <= 1 && frame.samples[3] == 0, "GainStage scales by the gain");
+    pool.release(frame);
+}
+
+void checkThreadedDrain(QTextStream& out)
+{
+    const int framesPerRun = 32;
+    AudioPipeline pipeline(8, 64);
+    CountingSource* source = new CountingSource;
+    RecordingStage* sink = new RecordingStage;
+    pipeline.setSource(source);
+    pipeline.addStage(new GainStage(0));
+    pipeline.addStage(new SlowStage);
+    pipeline.addStage(sink);
+
+    for (int run = 0; run < 2; ++run)
+    {
+        pipeline.start(AudioPipeline::Threaded);
+        source->add(framesPerRun);
+        check(out, pipeline.pump() == framesPerRun, QString("run %1: pump() takes all frames of the source").arg(run));
+        // Most frames are still queued behind the slow stage
+        pipeline.stop();
+        check(out, sink->frames.size() == (run + 1) * framesPerRun,
+              QString("run %1: stop() drains the queued frames into the sink").arg(run));
+    }
+
+    bool ordered = true;
+
+    for (int i = 0; i < sink->frames.size(); ++i)
+        ordered &= sink->frames.at(i) == qint16(i);
+
+    check(out, ordered, "every frame reaches the sink once and in order across stop() and start()");
+    check(out, pipeline.droppedFrames() == 0, "no frame is dropped on the stage queues");
+
+    int free = 0;
+    QVector<AudioFrame> frames(pipeline.pool()->size());
+
+    for (auto& frame : frames)
+        free += (frame = pipeline.pool()->acquire()).isValid() ? 1 : 0;
+
+    check(out, free == pipeline.pool()->size(), "every frame is back in the pool after stop()");
+
+    for (auto& frame : frames)
+        pipeline.pool()->release(frame);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    checkFramePool(out);
+    checkGain(out);
+    checkThreadedDrain(out);
+
+    return checkSummary(out);
+}
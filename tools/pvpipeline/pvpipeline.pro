@@ -0,0 +1,21 @@
+TARGET = pvpipeline
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    $$PV_ROOT/src/audiopipeline.cpp \
+    $$PV_ROOT/src/audiostages.cpp \
+    $$PV_ROOT/src/porcupinefanout.cpp \
+    main.cpp
+
+HEADERS += \
+    $$PV_ROOT/src/audiopipeline.h \
+    $$PV_ROOT/src/audiostages.h \
+    $$PV_ROOT/src/detectionsink.h \
+    $$PV_ROOT/src/porcupinefanout.h
+
+# make check runs the checks of the frame pool and the pipeline, no engine needed
+check.commands = $$OUT_PWD/$$TARGET
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
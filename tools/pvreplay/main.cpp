@@ -0,0 +1,342 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "corpus.h"
+#include "porcupine.h"
+#include "udpaudiosource.h"
+
+///
+/// Packet replay for UDP ingestion.
+///
+/// Audio files are cut into RTP packets (RFC 3550 header, L16 mono samples in
+/// network byte order) and sent in real time to a UDP port. Every packet is
+/// delayed by a random jitter, and with the given probabilities dropped,
+/// duplicated, or held back behind the following packets. The sender works
+/// with a listening QmlPorcupine (udpPort) or any other receiver.
+///
+/// With --loopback the receiving side runs in this process: a UdpAudioSource
+/// on the port feeds an engine, and the jitter buffer counters and detections
+/// are reported when the replay has ended, all on the loopback interface.
+///
+
+struct ReplayConfig
+{
+    QString host = "127.0.0.1";
+    quint16 port = 0;
+    qint32  sampleRate = 16000;
+    int     packetMs = 20;
+    int     jitterMs = 0;
+    qreal   loss = 0;
+    qreal   duplicate = 0;
+    qreal   reorder = 0;
+    quint32 seed = 1;
+};
+
+struct ReplayReport
+{
+    qint64  packets = 0;
+    qint64  dropped = 0;
+    qint64  duplicated = 0;
+    qint64  reordered = 0;
+    QString errMsg;
+};
+
+struct Send
+{
+    qint64  atUs;
+    quint16 sequence;
+    int     first;
+    int     count;
+};
+
+static ReplayReport replay(const ReplayConfig& config, const QVector<qint16>& pcm)
+{
+    using Clock = std::chrono::steady_clock;
+    ReplayReport report;
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<qreal> chance(0, 1);
+    std::uniform_int_distribution<int> jitter(0, config.jitterMs * 1000);
+    const int packetSamples = config.sampleRate * config.packetMs / 1000;
+    const quint32 ssrc = rng();
+    const quint32 firstTimestamp = rng();
+    const quint16 firstSequence = quint16(rng());
+    QVector<Send> schedule;
+
+    // Timeline first, so jitter can move packets past each other
+    for (int first = 0, i = 0; first < pcm.size(); first += packetSamples, ++i)
+    {
+        Send send;
+        send.atUs = qint64(i) * config.packetMs * 1000 + jitter(rng);
+        send.sequence = quint16(firstSequence + i);
+        send.first = first;
+        send.count = qMin(packetSamples, pcm.size() - first);
+        ++report.packets;
+
+        if (chance(rng) < config.loss)
+        {
+            ++report.dropped;
+            continue;
+        }
+
+        if (chance(rng) < config.reorder)
+        {
+            // Held back behind the next one or two packets
+            send.atUs += (1 + int(chance(rng) * 2)) * config.packetMs * 1000;
+            ++report.reordered;
+        }
+
+        schedule.append(send);
+
+        if (chance(rng) < config.duplicate)
+        {
+            send.atUs += jitter(rng);
+            schedule.append(send);
+            ++report.duplicated;
+        }
+    }
+
+    std::stable_sort(schedule.begin(), schedule.end(), [](const Send& a, const Send& b)
+    {
+        return a.atUs < b.atUs;
+    });
+
+    QUdpSocket socket;
+    const QHostAddress host(config.host);
+    QByteArray datagram(12 + 2 * packetSamples, 0);
+    const auto start = Clock::now();
+
+    for (const auto& send : schedule)
+    {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(send.atUs));
+        uchar* packet = reinterpret_cast<uchar*>(datagram.data());
+        packet[0] = 0x80;
+        packet[1] = 96;
+        qToBigEndian<quint16>(send.sequence, packet + 2);
+        qToBigEndian<quint32>(quint32(firstTimestamp + quint32(send.first)), packet + 4);
+        qToBigEndian<quint32>(ssrc, packet + 8);
+
+        for (int i = 0; i < send.count; ++i)
+            qToBigEndian<qint16>(pcm.at(send.first + i), packet + 12 + 2 * i);
+
+        if (socket.writeDatagram(datagram.constData(), 12 + 2 * send.count, host, config.port) < 0)
+        {
+            report.errMsg = QString("Cannot send to %1:%2: %3").arg(config.host).arg(config.port).arg(socket.errorString());
+            break;
+        }
+    }
+
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvreplay");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays audio files as RTP packets over UDP with injected jitter, loss, "
+                                     "duplicates and reordering.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("input", "A *.wav file or a directory of *.wav files.");
+    parser.addOptions({
+        {"host", "Receiver address, default 127.0.0.1.", "address", "127.0.0.1"},
+        {"port", "Receiver UDP port.", "port"},
+        {"packet-ms", "Packet duration in ms, default 20.", "ms", "20"},
+        {"jitter-ms", "Maximum random send delay in ms, default 0.", "ms", "0"},
+        {"loss", "Probability of a dropped packet, default 0.", "p", "0"},
+        {"duplicate", "Probability of a duplicated packet, default 0.", "p", "0"},
+        {"reorder", "Probability of a packet held back behind the next ones, default 0.", "p", "0"},
+        {"seed", "Random seed, default 1.", "n", "1"},
+        {"loopback", "Receive and detect in this process, needs the engine options."},
+        {"repeat-last", "With --loopback conceal lost packets with the last frame instead of silence."},
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, e.g. the stub of tools/pvstub.", "file"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    ReplayConfig config;
+    config.host = parser.value("host");
+    config.port = quint16(parser.value("port").toUInt());
+    config.packetMs = qBound(1, parser.value("packet-ms").toInt(), 100);
+    config.jitterMs = qMax(0, parser.value("jitter-ms").toInt());
+    config.loss = parser.value("loss").toDouble();
+    config.duplicate = parser.value("duplicate").toDouble();
+    config.reorder = parser.value("reorder").toDouble();
+    config.seed = parser.value("seed").toUInt();
+
+    if (parser.positionalArguments().size() != 1 || config.port == 0)
+    {
+        err << "An input and a port are required, see --help." << Qt::endl;
+        return 1;
+    }
+
+    QString errMsg;
+    QScopedPointer<Porcupine> engine;
+
+    if (parser.isSet("loopback"))
+    {
+        QVector<QString> keywordFiles;
+        QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+        while (keyFilesIt.hasNext())
+            keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+        std::sort(keywordFiles.begin(), keywordFiles.end());
+        engine.reset(Porcupine::create(parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY"),
+                                       keywordFiles,
+                                       parser.value("model"),
+                                       QVector<qreal>(),
+                                       &errMsg,
+                                       parser.value("library")));
+
+        if (engine.isNull())
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        config.sampleRate = engine->sampleRate();
+        engine->enable(true);
+    }
+
+    QVector<qint16> pcm;
+    const QString input = parser.positionalArguments().first();
+
+    if (QFileInfo(input).isDir())
+    {
+        Corpus corpus;
+
+        if (!corpus.load(input, config.sampleRate, &errMsg))
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        for (const auto& file : corpus.files())
+            pcm += file.pcm;
+    }
+    else if (!Corpus::readWav(input, config.sampleRate, &pcm, &errMsg))
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    ReplayReport report;
+
+    if (engine.isNull())
+    {
+        report = replay(config, pcm);
+    }
+    else
+    {
+        UdpAudioSource source(engine->sampleRate(), engine->frameLength());
+        source.setConcealment(parser.isSet("repeat-last") ? JitterBuffer::RepeatLast : JitterBuffer::Silence);
+
+        if (!source.listen(config.port, QHostAddress::LocalHost, &errMsg))
+        {
+            err << errMsg << Qt::endl;
+            return 1;
+        }
+
+        QByteArray frames(8 * engine->bytesFrameLength(), 0);
+        qint64 samples = 0;
+
+        QObject::connect(&source, &QIODevice::readyRead, [&]()
+        {
+            qint64 bytes;
+
+            while ((bytes = source.read(frames.data(), frames.size())) > 0)
+            {
+                int keywordIndex = -1;
+                bool success = engine->process(keywordIndex, frames.constData(), int(bytes), &errMsg);
+
+                while (success)
+                {
+                    samples += qint64(engine->framesProcessed()) * engine->frameLength();
+
+                    if (keywordIndex < 0)
+                        break;
+
+                    out << QString("detection,%1,%2").arg(keywordIndex).arg(qreal(samples) / engine->sampleRate(), 0, 'f', 2) << Qt::endl;
+                    // A detection stops processing the packet, the rest is buffered in the engine
+                    success = engine->process(keywordIndex, nullptr, 0, &errMsg);
+                }
+
+                if (!success)
+                {
+                    QCoreApplication::exit(1);
+                    return;
+                }
+            }
+        });
+
+        QThread* sender = QThread::create([&]()
+        {
+            report = replay(config, pcm);
+        });
+
+        // Let the jitter buffer drain after the last packet
+        QObject::connect(sender, &QThread::finished, [&]()
+        {
+            QTimer::singleShot(500, &app, &QCoreApplication::quit);
+        });
+
+        sender->start();
+        const int exitCode = app.exec();
+        sender->wait();
+        delete sender;
+
+        if (exitCode != 0)
+        {
+            err << errMsg << Qt::endl;
+            return exitCode;
+        }
+
+        const UdpAudioSource::Counters counters = source.counters();
+        err << QString("received %1, late %2, lost %3, reordered %4, duplicates %5, concealed %6 ms, delay %7 ms, "
+                       "jitter %8 ms, malformed %9")
+               .arg(counters.jitter.received)
+               .arg(counters.jitter.late)
+               .arg(counters.jitter.lost)
+               .arg(counters.jitter.reordered)
+               .arg(counters.jitter.duplicates)
+               .arg(counters.jitter.concealedSamples * 1000 / engine->sampleRate())
+               .arg(counters.jitter.delayMs)
+               .arg(counters.jitter.jitterMs, 0, 'f', 1)
+               .arg(counters.malformed) << Qt::endl;
+        err << QString("processed %1 s of %2 s").arg(qreal(samples) / engine->sampleRate(), 0, 'f', 2)
+               .arg(qreal(pcm.size()) / engine->sampleRate(), 0, 'f', 2) << Qt::endl;
+    }
+
+    err << QString("sent %1 packets, dropped %2, duplicated %3, reordered %4")
+           .arg(report.packets - report.dropped)
+           .arg(report.dropped)
+           .arg(report.duplicated)
+           .arg(report.reordered) << Qt::endl;
+
+    if (!report.errMsg.isEmpty())
+    {
+        err << report.errMsg << Qt::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+TARGET = pvreplay
+TEMPLATE = app
+
+include(../tools.pri)
+
+QT += network
+
+SOURCES += \
+    main.cpp \
+    $$PV_ROOT/src/jitterbuffer.cpp \
+    $$PV_ROOT/src/udpaudiosource.cpp
+
+HEADERS += \
+    $$PV_ROOT/src/jitterbuffer.h \
+    $$PV_ROOT/src/udpaudiosource.h
@@ -0,0 +1,231 @@
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "detectionbus.h"
+#include "mpscring.h"
+
+///
+/// Checks of the MPSC ring shared by the detection bus, the awaitable
+/// detector and the log, and of the subscriber retirement of the bus.
+///
+/// - MpscRing: exactly limit values fit without a consumer, the sequence
+///   numbers survive many wraparounds, and concurrent producers keep their
+///   own order without losing or duplicating values.
+/// - DetectionBus: take() counts the deliveries, and a notifier may
+///   unsubscribe its own subscription while other threads publish.
+///
+/// Exits with code 1 if a check failed.
+///
+
+namespace
+{
+
+void checkLimit(QTextStream& out)
+{
+    // Below the ring size of 8
+    MpscRing<int> ring(5);
+    int pushed = 0;
+
+    for (int i = 0; i < 8; ++i)
+        pushed += ring.push(i) ? 1 : 0;
+
+    check(out, pushed == 5 && ring.size() == 5, "push() stops at the limit");
+    check(out, ring.dropped() == 3, "push() at the limit counts the dropped values");
+
+    int value = -1;
+    bool ordered = true;
+
+    for (int i = 0; i < 5; ++i)
+        ordered &= ring.pop(&value) && value == i;
+
+    check(out, ordered && !ring.pop(&value) && !ring.pending(), "pop() returns the values in order, then nothing");
+}
+
+void checkWraparound(QTextStream& out)
+{
+    MpscRing<int> ring(4);
+    bool ordered = true;
+    int next = 0;
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        // Alternately fills the ring and takes all but one
+        ordered &= ring.push(i);
+
+        if (ring.size() == 4)
+        {
+            int value = -1;
+
+            while (ring.size() > 1)
+                ordered &= ring.pop(&value) && value == next++;
+        }
+    }
+
+    int value = -1;
+
+    while (ring.pop(&value))
+        ordered &= value == next++;
+
+    check(out, ordered && next == 10000 && ring.dropped() == 0, "the ring keeps its order over many wraparounds");
+}
+
+void checkProducers(QTextStream& out)
+{
+    const int producers = 4;
+    const quint64 perProducer = 200000;
+    MpscRing<quint64> ring(256);
+    std::atomic<int> running(producers);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back(std::thread([&ring, &running, p, perProducer]()
+        {
+            for (quint64 i = 0; i < perProducer; ++i)
+            {
+                ring.push(quint64(p) << 32 | i);
+
+                // Lets the consumer keep up now and then, so not all is dropped
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+
+            running.fetch_sub(1, std::memory_order_release);
+        }));
+    }
+
+    QVector<qint64> last(producers, -1);
+    qint64 received = 0;
+    bool ordered = true;
+    quint64 value = 0;
+
+    for (;;)
+    {
+        if (ring.pop(&value))
+        {
+            const int p = int(value >> 32);
+            const qint64 i = qint64(value & 0xffffffff);
+            // Increasing per producer: neither reordered nor duplicated
+            ordered &= p < producers && i > last[p];
+            last[p] = i;
+            ++received;
+        }
+        else if (running.load(std::memory_order_acquire) == 0 && !ring.pending())
+        {
+            break;
+        }
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    check(out, ordered, "every producer's values arrive in order and once");
+    check(out, received + ring.dropped() == qint64(producers * perProducer),
+          QString("received %1 + dropped %2 == produced %3").arg(received).arg(ring.dropped()).arg(producers * perProducer));
+}
+
+void checkBusDelivery(QTextStream& out)
+{
+    DetectionBus bus;
+    DetectionBus::Subscription* subscription = bus.subscribe("take", 4);
+
+    for (int i = 0; i < 6; ++i)
+        bus.detected(QString(), i, i);
+
+    DetectionBus::Counters counters = subscription->counters();
+    check(out, counters.delivered == 0 && counters.backlog == 4 && counters.dropped == 2,
+          "queued detections are not counted as delivered");
+
+    DetectionBus::Event event;
+    int taken = 0;
+
+    while (subscription->take(&event))
+        ++taken;
+
+    counters = subscription->counters();
+    check(out, taken == 4 && counters.delivered == 4 && counters.backlog == 0, "take() counts the deliveries");
+    bus.unsubscribe(subscription);
+}
+
+struct Retiring
+{
+    DetectionBus*                               bus = nullptr;
+    std::atomic<DetectionBus::Subscription*>    subscription{nullptr};
+    std::atomic<bool>                           retired{false};
+};
+
+void retireOnNotify(void* context)
+{
+    Retiring* retiring = static_cast<Retiring*>(context);
+    DetectionBus::Subscription* subscription;
+
+    // The first detection may arrive before subscribe() returned
+    while ((subscription = retiring->subscription.load(std::memory_order_acquire)) == nullptr)
+        std::this_thread::yield();
+
+    retiring->bus->unsubscribe(subscription);
+    retiring->retired.store(true, std::memory_order_release);
+}
+
+void checkBusRetirement(QTextStream& out)
+{
+    DetectionBus bus;
+    std::atomic<bool> publishing(true);
+    // Another subscriber the publishers keep busy while the slots retire
+    DetectionBus::Subscription* busy = bus.subscribe("busy", 16);
+    std::vector<std::thread> publishers;
+
+    for (int p = 0; p < 3; ++p)
+    {
+        publishers.emplace_back(std::thread([&bus, &publishing, p]()
+        {
+            while (publishing.load(std::memory_order_relaxed))
+                bus.detected(QString(), p, 0);
+        }));
+    }
+
+    bool retired = true;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        Retiring retiring;
+        retiring.bus = &bus;
+        retiring.subscription.store(bus.subscribe("retire", 4, retireOnNotify, &retiring), std::memory_order_release);
+
+        // The notifier of the first detection removes the subscription
+        while (!retiring.retired.load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        retired &= retiring.subscription.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    publishing.store(false, std::memory_order_relaxed);
+
+    for (auto& thread : publishers)
+        thread.join();
+
+    check(out, retired, "a notifier unsubscribes its own subscription while others publish");
+    check(out, bus.counters().size() == 1, "only the busy subscriber is left");
+    bus.unsubscribe(busy);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    checkLimit(out);
+    checkWraparound(out);
+    checkProducers(out);
+    checkBusDelivery(out);
+    checkBusRetirement(out);
+
+    return checkSummary(out);
+}
@@ -0,0 +1,17 @@
+TARGET = pvring
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    $$PV_ROOT/src/detectionbus.cpp \
+    main.cpp
+
+HEADERS += \
+    $$PV_ROOT/src/detectionbus.h \
+    $$PV_ROOT/src/detectionsink.h
+
+# make check runs the checks of the MPSC ring and the detection bus
+check.commands = $$OUT_PWD/$$TARGET
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,214 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "pv_porcupine.h"
+
+///
+/// Stub of the Porcupine runtime library.
+///
+/// Implements the C API resolved by porcupine_fn_init(). Any non-empty
+/// AccessKey and existing files are accepted. Every processed frame busy-waits
+/// for PV_STUB_FRAME_US microseconds (default 150) to emulate inference cost,
+/// and with PV_STUB_DETECT_EVERY set every n-th frame reports keyword 0.
+/// The model and keyword files are read into heap memory like the real
+/// library does, so the memory per instance follows their size, at least
+/// PV_STUB_MODEL_KB (default 0) kilobytes. Every frame reads a slice of it.
+///
+
+namespace
+{
+
+const int32_t FrameLength = 512;
+const int32_t SampleRate = 16000;
+
+long envValue(const char* name, long defaultValue)
+{
+    const char* value = std::getenv(name);
+    return value != nullptr ? std::strtol(value, nullptr, 10) : defaultValue;
+}
+
+long fileSize(const char* path)
+{
+    std::FILE* file = std::fopen(path, "rb");
+
+    if (file == nullptr)
+        return -1;
+
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fclose(file);
+    return size;
+}
+
+// Appends the content of path to weights, returns false if it cannot be read or does not fit
+bool readFile(const char* path, unsigned char* weights, long capacity, long* used)
+{
+    std::FILE* file = std::fopen(path, "rb");
+
+    if (file == nullptr)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    const bool success = size >= 0 && size <= capacity - *used && std::fread(weights + *used, 1, size_t(size), file) == size_t(size);
+    std::fclose(file);
+    *used += success ? size : 0;
+    return success;
+}
+
+}
+
+struct pv_porcupine
+{
+    std::chrono::nanoseconds frameCost;
+    long    detectEvery;
+    long    frames;
+    int32_t keywords;
+    unsigned char* weights;
+    long    weightsSize;
+};
+
+extern "C" {
+
+PV_API int32_t pv_sample_rate(void)
+{
+    return SampleRate;
+}
+
+PV_API const char* pv_status_to_string(pv_status_t status)
+{
+    static const char* const names[] =
+    {
+        "SUCCESS", "OUT_OF_MEMORY", "IO_ERROR", "INVALID_ARGUMENT", "STOP_ITERATION", "KEY_ERROR",
+        "INVALID_STATE", "RUNTIME_ERROR", "ACTIVATION_ERROR", "ACTIVATION_LIMIT_REACHED",
+        "ACTIVATION_THROTTLED", "ACTIVATION_REFUSED"
+    };
+
+    return status >= 0 && status <= PV_STATUS_ACTIVATION_REFUSED ? names[status] : "UNKNOWN";
+}
+
+PV_API pv_status_t pv_get_error_stack(char*** message_stack, int32_t* message_stack_depth)
+{
+    if (message_stack == nullptr || message_stack_depth == nullptr)
+        return PV_STATUS_INVALID_ARGUMENT;
+
+    *message_stack = nullptr;
+    *message_stack_depth = 0;
+    return PV_STATUS_SUCCESS;
+}
+
+PV_API void pv_free_error_stack(char** message_stack)
+{
+    std::free(message_stack);
+}
+
+PV_API pv_status_t pv_porcupine_init(const char* access_key,
+                                     const char* model_path,
+                                     int32_t num_keywords,
+                                     const char* const* keyword_paths,
+                                     const float* sensitivities,
+                                     pv_porcupine_t** object)
+{
+    if (access_key == nullptr || *access_key == '\0' || model_path == nullptr
+        || num_keywords <= 0 || keyword_paths == nullptr || sensitivities == nullptr || object == nullptr)
+        return PV_STATUS_INVALID_ARGUMENT;
+
+    long filesSize = fileSize(model_path);
+
+    for (int32_t i = 0; i < num_keywords && filesSize >= 0; ++i)
+    {
+        const long size = fileSize(keyword_paths[i]);
+        filesSize = size >= 0 ? filesSize + size : -1;
+    }
+
+    if (filesSize < 0)
+        return PV_STATUS_IO_ERROR;
+
+    const long minimumSize = envValue("PV_STUB_MODEL_KB", 0) * 1024;
+    const long weightsSize = filesSize > minimumSize ? filesSize : minimumSize;
+    pv_porcupine_t* porcupine = new (std::nothrow) pv_porcupine_t;
+    unsigned char* weights = static_cast<unsigned char*>(std::calloc(size_t(weightsSize) + 1, 1));
+
+    if (porcupine == nullptr || weights == nullptr)
+    {
+        delete porcupine;
+        std::free(weights);
+        return PV_STATUS_OUT_OF_MEMORY;
+    }
+
+    long used = 0;
+    bool success = readFile(model_path, weights, weightsSize, &used);
+
+    for (int32_t i = 0; i < num_keywords && success; ++i)
+        success = readFile(keyword_paths[i], weights, weightsSize, &used);
+
+    // Written in full, so the pages are resident like loaded model parameters
+    for (long i = used; i < weightsSize; ++i)
+        weights[i] = (unsigned char)(i * 31);
+
+    if (!success)
+    {
+        delete porcupine;
+        std::free(weights);
+        return PV_STATUS_IO_ERROR;
+    }
+
+    porcupine->frameCost = std::chrono::microseconds(envValue("PV_STUB_FRAME_US", 150));
+    porcupine->detectEvery = envValue("PV_STUB_DETECT_EVERY", 0);
+    porcupine->frames = 0;
+    porcupine->keywords = num_keywords;
+    porcupine->weights = weights;
+    porcupine->weightsSize = weightsSize;
+    *object = porcupine;
+    return PV_STATUS_SUCCESS;
+}
+
+PV_API void pv_porcupine_delete(pv_porcupine_t* object)
+{
+    if (object != nullptr)
+        std::free(object->weights);
+
+    delete object;
+}
+
+PV_API pv_status_t pv_porcupine_process(pv_porcupine_t* object, const int16_t* pcm, int32_t* keyword_index)
+{
+    if (object == nullptr || pcm == nullptr || keyword_index == nullptr)
+        return PV_STATUS_INVALID_ARGUMENT;
+
+    // Busy wait, a sleeping stub would not load the cores like inference does
+    const auto until = std::chrono::steady_clock::now() + object->frameCost;
+    volatile int32_t energy = 0;
+    // Parameters are only read, a slice per frame
+    const long slice = 4096;
+    const long offset = object->weightsSize > slice ? (object->frames * slice) % (object->weightsSize - slice) : 0;
+
+    for (long i = 0; i < slice && offset + i < object->weightsSize; i += 64)
+        energy = energy + object->weights[offset + i];
+
+    while (std::chrono::steady_clock::now() < until)
+    {
+        for (int32_t i = 0; i < FrameLength; i += 64)
+            energy = energy + pcm[i];
+    }
+
+    ++object->frames;
+    *keyword_index = object->detectEvery > 0 && object->frames % object->detectEvery == 0 ? 0 : -1;
+    return PV_STATUS_SUCCESS;
+}
+
+PV_API const char* pv_porcupine_version(void)
+{
+    return "stub-1.0";
+}
+
+PV_API int32_t pv_porcupine_frame_length(void)
+{
+    return FrameLength;
+}
+
+}
@@ -0,0 +1,13 @@
+# Stand-in for the Porcupine runtime library with a configurable per-frame
+# cost, for load tests on machines without an AccessKey or real engine.
+
+TARGET = pv_porcupine_stub
+TEMPLATE = lib
+
+CONFIG += c++17 shared
+CONFIG -= qt
+
+INCLUDEPATH += $$PWD/../../extern/porcupine/include
+
+SOURCES += \
+    pvstub.cpp
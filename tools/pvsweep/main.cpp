@@ -0,0 +1,285 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+#include "corpus.h"
+#include "porcupine.h"
+
+///
+/// Sensitivity sweep over a labeled corpus.
+///
+/// Every sweep point runs one engine with all keywords at the same sensitivity.
+/// Porcupine scores each keyword independently, so a single pass per point
+/// yields the curve of every keyword. To use all cores the corpus is split
+/// into shards, each (point, shard) pair is one task. The corpus is decoded
+/// once and shared read-only by all tasks.
+///
+
+struct SweepConfig
+{
+    QString             accessKey;
+    QString             modelPath;
+    QString             libraryPath;
+    QVector<QString>    keywordFiles;
+    QStringList         keywordNames;
+    qint64              toleranceSamples = 0;
+    qint32              frameLength = 0;
+    qint32              sampleRate = 0;
+};
+
+struct SweepTask
+{
+    int     point = 0;
+    qreal   sensitivity = 0;
+    int     shard = 0;
+    int     shards = 1;
+};
+
+struct SweepResult
+{
+    int             point = 0;
+    QVector<qint64> hits;
+    QVector<qint64> falseAlarms;
+    QString         errMsg;
+};
+
+static SweepResult runTask(const SweepConfig& config, const Corpus& corpus, const SweepTask& task)
+{
+    SweepResult result;
+    result.point = task.point;
+    result.hits = QVector<qint64>(config.keywordFiles.size(), 0);
+    result.falseAlarms = QVector<qint64>(config.keywordFiles.size(), 0);
+
+    QScopedPointer<Porcupine> engine(Porcupine::create(config.accessKey,
+                                                       config.keywordFiles,
+                                                       config.modelPath,
+                                                       QVector<qreal>(config.keywordFiles.size(), task.sensitivity),
+                                                       &result.errMsg,
+                                                       config.libraryPath));
+
+    if (engine.isNull())
+        return result;
+
+    engine->enable(true);
+    const int frameBytes = config.frameLength * 2;
+    // One second of silence between files lets the engine settle
+    const QVector<qint16> silence(config.frameLength, 0);
+    const int flushFrames = config.sampleRate / config.frameLength;
+    const QVector<CorpusFile>& files = corpus.files();
+
+    for (int f = task.shard; f < files.size(); f += task.shards)
+    {
+        const CorpusFile& file = files.at(f);
+        QVector<bool> used(file.labels.size(), false);
+        const qint64 frames = file.pcm.size() / config.frameLength;
+
+        for (qint64 frame = 0; frame < frames; ++frame)
+        {
+            int keywordIndex = -1;
+            const char* data = reinterpret_cast<const char*>(file.pcm.constData() + frame * config.frameLength);
+
+            if (!engine->process(keywordIndex, data, frameBytes, &result.errMsg))
+                return result;
+
+            if (keywordIndex < 0)
+                continue;
+
+            const qint64 position = (frame + 1) * config.frameLength;
+            const QString& keyword = config.keywordNames.at(keywordIndex);
+            bool hit = false;
+
+            for (int l = 0; l < file.labels.size() && !hit; ++l)
+            {
+                const CorpusLabel& label = file.labels.at(l);
+
+                if (!used.at(l) && label.keyword == keyword
+                    && position >= label.start && position <= label.end + config.toleranceSamples)
+                {
+                    used[l] = true;
+                    hit = true;
+                }
+            }
+
+            if (hit)
+                ++result.hits[keywordIndex];
+            else
+                ++result.falseAlarms[keywordIndex];
+        }
+
+        for (int i = 0; i < flushFrames; ++i)
+        {
+            int keywordIndex = -1;
+            engine->process(keywordIndex, reinterpret_cast<const char*>(silence.constData()), frameBytes);
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("pvsweep");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Sweeps Porcupine sensitivities over a labeled corpus and "
+                                     "reports miss rate and false alarms per hour per keyword.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        {"access-key", "Picovoice AccessKey, default environment PV_ACCESS_KEY.", "key"},
+        {"model", "Model file (*.pv).", "file"},
+        {"keywords", "Directory of keyword files (*.ppn).", "dir"},
+        {"library", "Porcupine runtime library, default next to the executable.", "file"},
+        {"corpus", "Corpus directory with *.wav and *.labels files.", "dir"},
+        {"from", "Lowest sensitivity, default 0.", "value", "0"},
+        {"to", "Highest sensitivity, default 1.", "value", "1"},
+        {"step", "Sensitivity step, default 0.05.", "value", "0.05"},
+        {"tolerance", "Seconds after the labeled end a detection still counts, default 1.", "seconds", "1"},
+        {"max-fa", "False alarms per hour allowed at the operating point, default 1.", "value", "1"},
+        {"threads", "Worker threads, default all cores.", "n"},
+    });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    SweepConfig config;
+    config.accessKey = parser.isSet("access-key") ? parser.value("access-key") : qEnvironmentVariable("PV_ACCESS_KEY");
+    config.modelPath = parser.value("model");
+    config.libraryPath = parser.value("library");
+
+    QDirIterator keyFilesIt(parser.value("keywords"), {"*.ppn"}, QDir::Files);
+
+    while (keyFilesIt.hasNext())
+        config.keywordFiles.append(QDir::toNativeSeparators(keyFilesIt.next()));
+
+    std::sort(config.keywordFiles.begin(), config.keywordFiles.end());
+
+    for (const auto& file : config.keywordFiles)
+        config.keywordNames.append(corpusKeywordName(file));
+
+    // A probe instance validates the setup and provides the audio format
+    QString errMsg;
+    QScopedPointer<Porcupine> probe(Porcupine::create(config.accessKey, config.keywordFiles, config.modelPath,
+                                                      QVector<qreal>(), &errMsg, config.libraryPath));
+
+    if (probe.isNull())
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    config.frameLength = probe->frameLength();
+    config.sampleRate = probe->sampleRate();
+    config.toleranceSamples = qint64(parser.value("tolerance").toDouble() * config.sampleRate);
+    probe.reset();
+
+    Corpus corpus;
+
+    if (!corpus.load(parser.value("corpus"), config.sampleRate, &errMsg))
+    {
+        err << errMsg << Qt::endl;
+        return 1;
+    }
+
+    const qreal from = parser.value("from").toDouble();
+    const qreal to = parser.value("to").toDouble();
+    const qreal step = qMax(0.001, parser.value("step").toDouble());
+    QVector<qreal> points;
+
+    for (int i = 0; from + i * step <= to + 1e-9; ++i)
+        points.append(qMin(1.0, from + i * step));
+
+    const int threads = parser.isSet("threads") ? qMax(1, parser.value("threads").toInt())
+                                                : QThread::idealThreadCount();
+    QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    const int shards = qBound(1, (threads + points.size() - 1) / points.size(), corpus.files().size());
+    QVector<SweepTask> tasks;
+
+    for (int p = 0; p < points.size(); ++p)
+    {
+        for (int s = 0; s < shards; ++s)
+            tasks.append({p, points.at(p), s, shards});
+    }
+
+    err << QString("Sweeping %1 points over %2 files (%3 h) with %4 tasks on %5 threads")
+           .arg(points.size()).arg(corpus.files().size())
+           .arg(corpus.totalSamples() / qreal(config.sampleRate) / 3600, 0, 'f', 2)
+           .arg(tasks.size()).arg(threads) << Qt::endl;
+
+    const QList<SweepResult> results = QtConcurrent::blockingMapped<QList<SweepResult>>(tasks, [&config, &corpus](const SweepTask& task)
+    {
+        return runTask(config, corpus, task);
+    });
+
+    const int keywords = config.keywordFiles.size();
+    QVector<QVector<qint64>> hits(points.size(), QVector<qint64>(keywords, 0));
+    QVector<QVector<qint64>> falseAlarms(points.size(), QVector<qint64>(keywords, 0));
+
+    for (const auto& result : results)
+    {
+        if (!result.errMsg.isEmpty())
+        {
+            err << result.errMsg << Qt::endl;
+            return 1;
+        }
+
+        for (int k = 0; k < keywords; ++k)
+        {
+            hits[result.point][k] += result.hits.at(k);
+            falseAlarms[result.point][k] += result.falseAlarms.at(k);
+        }
+    }
+
+    QVector<qint64> labels(keywords, 0);
+
+    for (const auto& file : corpus.files())
+    {
+        for (const auto& label : file.labels)
+        {
+            const int k = config.keywordNames.indexOf(label.keyword);
+
+            if (k >= 0)
+                ++labels[k];
+        }
+    }
+
+    const qreal hours = corpus.totalSamples() / qreal(config.sampleRate) / 3600;
+    const qreal maxFa = parser.value("max-fa").toDouble();
+    out << "keyword,sensitivity,labels,hits,miss_rate,false_alarms,fa_per_hour" << Qt::endl;
+
+    for (int k = 0; k < keywords; ++k)
+    {
+        int best = -1;
+        int fallback = 0;
+
+        for (int p = 0; p < points.size(); ++p)
+        {
+            const qreal missRate = labels.at(k) > 0 ? 1.0 - qreal(hits[p][k]) / labels.at(k) : 0;
+            const qreal faPerHour = hours > 0 ? falseAlarms[p][k] / hours : 0;
+            out << config.keywordNames.at(k) << ',' << points.at(p) << ',' << labels.at(k) << ','
+                << hits[p][k] << ',' << missRate << ',' << falseAlarms[p][k] << ',' << faPerHour << Qt::endl;
+
+            // Lowest miss rate within the false alarm budget, the lower sensitivity on ties
+            if (faPerHour <= maxFa && (best < 0 || hits[p][k] > hits[best][k]))
+                best = p;
+
+            if (falseAlarms[p][k] < falseAlarms[fallback][k])
+                fallback = p;
+        }
+
+        const int point = best >= 0 ? best : fallback;
+        err << QString("Recommended sensitivity for \"%1\": %2%3")
+               .arg(config.keywordNames.at(k)).arg(points.at(point))
+               .arg(best >= 0 ? QString() : QString(" (no point within %1 FA/h)").arg(maxFa)) << Qt::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+TARGET = pvsweep
+TEMPLATE = app
+
+include(../tools.pri)
+
+SOURCES += \
+    main.cpp
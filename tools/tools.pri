@@ -0,0 +1,36 @@
+# Common settings of the headless tools, they share the engine wrapper
+# with the application but do not depend on QtQuick or QtMultimedia.
+
+QT -= gui
+QT += core concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+PV_ROOT = $$PWD/..
+
+INCLUDEPATH += $$PV_ROOT/src $$PV_ROOT/extern/porcupine/include $$PWD/common
+
+SOURCES += \
+    $$PV_ROOT/src/porcupine.cpp \
+    $$PV_ROOT/src/porcupinelog.cpp \
+    $$PV_ROOT/src/porcupinememory.cpp \
+    $$PV_ROOT/src/porcupineperf.cpp \
+    $$PV_ROOT/src/porcupinestartup.cpp \
+    $$PV_ROOT/src/porcupinetrace.cpp \
+    $$PWD/common/check.cpp \
+    $$PWD/common/corpus.cpp \
+    $$PWD/common/stats.cpp
+
+HEADERS += \
+    $$PV_ROOT/src/mpscring.h \
+    $$PV_ROOT/src/porcupine.h \
+    $$PV_ROOT/src/porcupine_fn.hpp \
+    $$PV_ROOT/src/porcupinelog.h \
+    $$PV_ROOT/src/porcupinememory.h \
+    $$PV_ROOT/src/porcupineperf.h \
+    $$PV_ROOT/src/porcupinestartup.h \
+    $$PV_ROOT/src/porcupinetrace.h \
+    $$PWD/common/check.h \
+    $$PWD/common/corpus.h \
+    $$PWD/common/stats.h
@@ -59,6 +59,8 @@ Window {
         id: porcupine
         pvAccessKey: ''
         sensitivity: 0.5
+        watchKeywords: true
+        warmUp: true
         onKeyWordDetected: function(keywordIndex) {
             markKeywordItem(keywordIndex);
         }
@@ -132,8 +134,15 @@ Window {
                             horizontalAlignment: Text.AlignHCenter
                             verticalAlignment: Text.AlignVCenter
                             font: listFont
+                            opacity: active ? 1.0 : 0.4
                             text: display
                         }
+                        CheckBox {
+                            anchors.left: parent.left
+                            anchors.verticalCenter: parent.verticalCenter
+                            checked: active
+                            onToggled: porcupine.setKeywordActive(index, checked)
+                        }
                     }
                     ScrollBar.vertical: ScrollBar { policy: ScrollBar.AsNeeded }
                 }
@@ -174,6 +183,17 @@ Window {
             }
         }
 
+        Label {
+            id: captureStats
+            Layout.fillWidth: true
+            font: defaultFont
+            visible: porcupine.engineReady
+            text: "Wake-ups/s: " + porcupine.wakeUpsPerSecond.toFixed(1)
+                  + "   Frames/s: " + porcupine.framesPerSecond.toFixed(1)
+                  + "   Packet: " + porcupine.inputPacketSize
+                  + "   Load: " + (100 * porcupine.processLoad).toFixed(2) + " %"
+        }
+
         RowLayout {
             id: accessKey
             Layout.topMargin: mm(2)